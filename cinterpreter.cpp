@@ -28,6 +28,8 @@
 //QString QString::number(float);
 #include "nineML_classes.h"
 #include "globalHeader.h"
+#include <algorithm>
+
 int precedance(valop in) {
 
     if (in.val == ADD || in.val == SUB) return 0;
@@ -37,28 +39,144 @@ int precedance(valop in) {
     return -1;
 }
 
-bool isOperation(QString in) {
+// character classes used when tokenising
+#define CHAR_OPERATION 1
+#define CHAR_VAR 2
+#define CHAR_TOKEN 4
+#define CHAR_NUM 8
+#define CHAR_CONDITION 16
+
+static int charClass(QChar in) {
 
-    QString operations = "+-*/";
+    ushort c = in.unicode();
 
-    if (operations.contains(in[0])) {
-        return true;
+    // once we are in a var we have a wider range of possible chars
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') return CHAR_VAR | CHAR_TOKEN;
+    if (c >= '0' && c <= '9') return CHAR_NUM | CHAR_TOKEN;
+
+    switch (c) {
+    case '.':
+        return CHAR_NUM;
+    case '#':
+        return CHAR_TOKEN;
+    case '+':
+    case '-':
+    case '*':
+    case '/':
+        return CHAR_OPERATION;
+    case '=':
+    case '>':
+    case '<':
+    case '!':
+        return CHAR_CONDITION;
     }
-    return false;
+
+    return 0;
 
 }
 
-opType getOpVal(QString in) {
+struct functionEntry {
+    const char * name;
+    int length;
+    bool isUnary;
+    // the C library function doFunctionOp calls, or NULL if it doesn't call one
+    const char * libraryName;
+};
+
+// the functions, indexed by the function number used by doFunctionOp
+static const functionEntry functionTable[] = {
+    {"pow", 3, false, "pow"},
+    {"exp", 3, true, "exp"},
+    {"sin", 3, true, "sin"},
+    {"cos", 3, true, "cos"},
+    {"log", 3, true, "log"},
+    {"log10", 5, true, "log10"},
+    {"sinh", 4, true, "sinh"},
+    {"cosh", 4, true, "cosh"},
+    {"tanh", 4, true, "tanh"},
+    {"sqrt", 4, true, "sqrt"},
+    {"atan", 4, true, "atan"},
+    {"asin", 4, true, "asin"},
+    {"acos", 4, true, "acos"},
+    {"asinh", 5, true, "asinh"},
+    {"acosh", 5, true, "acosh"},
+    {"atanh", 5, true, "atanh"},
+    {"atan2", 5, false, "atan2"},
+    {"ceil", 4, true, "ceil"},
+    {"floor", 5, true, "floor"},
+    {"rand", 4, true, NULL},
+    {"mod", 3, false, "fmod"}
+};
+
+#define NUM_FUNCTIONS int(sizeof(functionTable)/sizeof(functionTable[0]))
+
+const char * functionLibraryName(int op) {
+
+    if (op < 0 || op >= NUM_FUNCTIONS) {
+        return NULL;
+    }
+    return functionTable[op].libraryName;
 
-    if (in[0] == '+') return ADD;
-    if (in[0] == '-') return SUB;
-    if (in[0] == '*') return MULT;
-    if (in[0] == '/') return DIV;
+}
+
+bool functionIsUnary(int op) {
+
+    return op >= 0 && op < NUM_FUNCTIONS && functionTable[op].isUnary;
+
+}
+
+// perfect hash of the function names: (3 * second char + 6 * last char + length) % 64 is
+// different for each of them, and this gives the entry in functionTable for each hash value
+static const signed char functionSlots[64] = {
+    -1,  7,  3, -1, -1, -1, -1, -1, -1, -1, -1,  1, -1, 16, 13,  9,
+    -1, 15,  2, -1, -1, -1, -1,  8, -1, -1,  0, -1, -1, -1, 14, 12,
+    -1, -1, -1, -1, -1, -1, -1, -1, 20, -1, -1, -1, -1, -1, -1,  6,
+    -1, 11,  5, -1, 10, 18, -1, -1, -1, -1,  4, 17, -1, -1, -1, 19,
+};
+
+static int findFunction(const QChar * name, int length) {
+
+    if (length < 3 || length > 5) {
+        return -1;
+    }
+
+    int i = functionSlots[(name[1].unicode()*3 + name[length-1].unicode()*6 + length) & 63];
+    if (i == -1 || functionTable[i].length != length) {
+        return -1;
+    }
+    for (int c = 0; c < length; ++c) {
+        if (name[c] != QLatin1Char(functionTable[i].name[c])) {
+            return -1;
+        }
+    }
+
+    return i;
+
+}
+
+bool isOperation(QString in) {
+
+    return in.size() > 0 && (charClass(in[0]) & CHAR_OPERATION);
+
+}
+
+static opType getOpVal(QChar in) {
+
+    if (in == '+') return ADD;
+    if (in == '-') return SUB;
+    if (in == '*') return MULT;
+    if (in == '/') return DIV;
 
     return ADD;
 
 }
 
+opType getOpVal(QString in) {
+
+    return getOpVal(in[0]);
+
+}
+
 condType getCondVal(QString in) {
 
     if (in == "==") return EQ;
@@ -74,122 +192,45 @@ condType getCondVal(QString in) {
 
 bool isVar(QString in) {
 
-    QString letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
-
-    if (letters.contains(in[0])) {
-        return true;
-    }
-    return false;
+    return in.size() > 0 && (charClass(in[0]) & CHAR_VAR);
 
 }
 
 bool isToken(QString in) {
 
-    // once we are in a var we have a wider range of possible chars
-    QString tokenItems = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_1234567890#";
-
-    if (tokenItems.contains(in[0])) {
-        return true;
-    }
-    return false;
+    return in.size() > 0 && (charClass(in[0]) & CHAR_TOKEN);
 
 }
 
 bool isNum(QString in) {
 
-    QString nums = "0123456789.";
-
-    if (nums.contains(in[0])) {
-        return true;
-    }
-    return false;
+    return in.size() > 0 && (charClass(in[0]) & CHAR_NUM);
 
 }
 
 bool isCondition(QString in) {
 
-    QString nums = "=><!";
-
-    if (nums.contains(in[0])) {
-        return true;
-    }
-    return false;
+    return in.size() > 0 && (charClass(in[0]) & CHAR_CONDITION);
 
 }
 
 bool isFunction(QString in) {
 
-    QStringList functions;
-    functions.push_back("pow");
-    functions.push_back("exp");
-    functions.push_back("sin");
-    functions.push_back("cos");
-    functions.push_back("log");
-    functions.push_back("log10");
-    functions.push_back("sinh");
-    functions.push_back("cosh");
-    functions.push_back("tanh");
-    functions.push_back("sqrt");
-    functions.push_back("atan");
-    functions.push_back("asin");
-    functions.push_back("acos");
-    functions.push_back("asinh");
-    functions.push_back("acosh");
-    functions.push_back("atanh");
-    functions.push_back("atan2");
-    functions.push_back("ceil");
-    functions.push_back("floor");
-    functions.push_back("rand");
-    functions.push_back("mod");
-
-    for (int i = 0; i < (int) functions.size(); ++i) {
-        if (in == functions[i]) {
-            return true;
-        }
-    }
-    return false;
+    return findFunction(in.constData(), in.size()) != -1;
 
 }
 
 float getFuncVal(QString in) {
 
-    QStringList functions;
-    functions.push_back("pow");
-    functions.push_back("exp");
-    functions.push_back("sin");
-    functions.push_back("cos");
-    functions.push_back("log");
-    functions.push_back("log10");
-    functions.push_back("sinh");
-    functions.push_back("cosh");
-    functions.push_back("tanh");
-    functions.push_back("sqrt");
-    functions.push_back("atan");
-    functions.push_back("asin");
-    functions.push_back("acos");
-    functions.push_back("asinh");
-    functions.push_back("acosh");
-    functions.push_back("atanh");
-    functions.push_back("atan2");
-    functions.push_back("ceil");
-    functions.push_back("floor");
-    functions.push_back("rand");
-    functions.push_back("mod");
-
-
-    for (int i = 0; i < (int) functions.size(); ++i) {
-        if (in == functions[i]) {
-            return float(i);
-        }
-    }
-    return -1;
+    return float(findFunction(in.constData(), in.size()));
 
 }
 
 bool isFuncUnary(QString in) {
 
-    if (in == "pow" || in == "atan2" || in == "mod" ) {
-        return false;
+    int i = findFunction(in.constData(), in.size());
+    if (i != -1) {
+        return functionTable[i].isUnary;
     }
 
     return true;
@@ -238,6 +279,12 @@ QString doError(int err) {
     if (err == 13) {
         return "Unrecognised function";
     }
+    if (err == 14) {
+        return "Unrecognised character";
+    }
+    if (err == 15) {
+        return "Empty equation";
+    }
 
 
     return "Unrecognised error code";
@@ -289,7 +336,11 @@ float * getVarPtr(QString in, vector <lookup> &varList) {
 
 float doFunction(float val1, float val2, float opf) {
 
-    int op = int(opf);
+    return doFunctionOp(val1, val2, int(opf));
+
+}
+
+float doFunctionOp(float val1, float val2, int op) {
 
     if (op == 0 && val2 == INFINITY) return INFINITY;
     if (op == 16 && val2 == INFINITY) return INFINITY;
@@ -753,7 +804,7 @@ QString doBoolBrackets(int startInd, int endInd, vector <valop> opstackIn, float
 
 }
 */
-float interpretMaths(vector <valop> stack) {
+float interpretMaths(const vector <valop> &stack, randomStream * random) {
 
     // evaluate the stack:
     vector <valop> tempStack;
@@ -798,7 +849,12 @@ float interpretMaths(vector <valop> stack) {
                     val1 = INFINITY;
                 }
 
-                float result = doFunction(val2, val1, stack[i].val);
+                float result;
+                if (random != NULL && int(stack[i].val) == 19) {
+                    result = random->uniform();
+                } else {
+                    result = doFunction(val2, val1, stack[i].val);
+                }
                 /*qDebug() << "function " << "isUnary(" << float(stack[i].isUnary) << ") " <<  stack[i].val << " " << val2 << " " << val1 << "\n";
                 qDebug() << "result = " << result;*/
                 // push back result onto stack
@@ -884,27 +940,119 @@ float interpretMaths(vector <valop> stack) {
     return 0.0;
 }
 
+symbolTable::symbolTable(vector <lookup> &varList) {
+
+    this->vars = &varList;
+    for (uint i = 0; i < varList.size(); ++i) {
+        if (!this->slotOf.contains(varList[i].name)) {
+            this->slotOf.insert(varList[i].name, i);
+        }
+    }
+
+}
+
+float * symbolTable::pointer(const QString &name) const {
+
+    int i = this->slot(name);
+    if (i == -1) {
+        return NULL;
+    }
+    return &((*this->vars)[i].value);
+
+}
+
 QString createStack(QString equation, vector <lookup> &varList, vector <valop> * returnStack) {
 
+    symbolTable symbols(varList);
+    return createStack(equation, symbols, returnStack);
+
+}
+
+QString createStack(QString equation, const symbolTable &symbols, vector <valop> * returnStack) {
+
+    mathsExpression expression(equation);
+    return expression.bind(symbols, returnStack);
+
+}
+
+mathsExpression::mathsExpression(QString equation) {
+
+    this->source = equation;
+    this->err = this->parse(equation);
+
+}
+
+/*!
+ * \brief mathsExpression::bind
+ * \param symbols
+ * \param returnStack
+ * \return the error from parsing or binding, or an empty string on success
+ *
+ * Resolve the variable names in the parsed stack using a symbol table, giving a stack that can be
+ * evaluated or compiled.
+ */
+QString mathsExpression::bind(const symbolTable &symbols, vector <valop> * returnStack) const {
+
+    if (!this->err.isEmpty()) {
+        return this->err;
+    }
+
+    vector < valop > stack = this->rpn;
+    for (uint i = 0; i < stack.size(); ++i) {
+        if (stack[i].op == VAL && stack[i].name != -1) {
+            stack[i].ptr = symbols.pointer(this->names[stack[i].name]);
+            if (stack[i].ptr == NULL) return doError(2);
+        }
+    }
+
+    *returnStack = stack;
+    return "";
+
+}
+
+/*!
+ * \brief mathsExpression::parse
+ * \param equation
+ * \return the first error found, or an empty string
+ *
+ * Tokenise the equation and put it in reverse Polish order. Unknown functions and characters are
+ * errors but tokenising carries on past them, so all the names used are still collected.
+ */
+QString mathsExpression::parse(QString equation) {
+
     vector < valop > opstack;
+    QString firstError;
 
     // strip all whitespace
     equation.replace(" ", "");
 
+    // nothing left to parse - editors validate as the user types, so this is common
+    if (equation.isEmpty()) {
+        return doError(15);
+    }
+
+    // tokenise in a single pass over the characters - names and numbers are looked at in place
+    const QChar * chars = equation.constData();
+    int length = equation.size();
+    int pos = 0;
+
     bool ended = false;
 
     while (!ended) {
 
-        if (equation.size() == 0) {
+        if (pos == length) {
             ended = true;
         }
 
         valop newValOp;
         newValOp.op = COMMA;
         newValOp.val = -1;
+        newValOp.name = -1;
+
+        int type = pos < length ? charClass(chars[pos]) : 0;
 
-        if (isOperation(equation)) {
-            newValOp.val = float(getOpVal(equation));
+        if (type & CHAR_OPERATION) {
+            newValOp.val = float(getOpVal(chars[pos]));
             if (opstack.size() != 0) {
                 if (opstack.back().op != VAL && opstack.back().op != RBRACKET) {
                     newValOp.isUnary = true;
@@ -915,112 +1063,130 @@ QString createStack(QString equation, vector <lookup> &varList, vector <valop> *
                 newValOp.isUnary = true;
             }
             newValOp.op = OP;
-            equation.remove(0,1);
+            ++pos;
         }
-        else if (isVar(equation)) {
-
-            QString name = QString(equation[0]);
-            equation.remove(0,1);
-            // while we are still in the token
-            if (equation.size() > 0) {
-                while (isToken(equation)) {
-                    // get full name
-                    name += equation[0];
-                    equation.remove(0,1);
-                    if (equation.size() == 0) break;
-                }
+        else if (type & CHAR_VAR) {
+
+            // get full name
+            int start = pos++;
+            while (pos < length && (charClass(chars[pos]) & CHAR_TOKEN)) {
+                ++pos;
             }
 
-            // fetch the value associated with the name, unless a function
-            if (equation.size() > 0) {
-                if (equation[0] == '(') {
-                    newValOp.val = getFuncVal(name);
-                    if (newValOp.val == -1) {qDebug() << "wtf"; return doError(13);}
-                    newValOp.isUnary = isFuncUnary(name);
-                    newValOp.op = FUNC;
-                    equation.remove(0,1);
+            QString name = QString(chars + start, pos - start);
+
+            // a function, or a variable which is looked up when the expression is bound
+            if (pos < length && chars[pos] == '(') {
+                if (!this->functions.contains(name)) {
+                    this->functions.push_back(name);
+                }
+                int func = findFunction(chars + start, pos - start);
+                if (func == -1) {
+                    if (firstError.isEmpty()) firstError = doError(13);
+                    newValOp.isUnary = true;
+                } else {
+                    newValOp.val = float(func);
+                    newValOp.isUnary = functionTable[func].isUnary;
+                }
+                newValOp.op = FUNC;
+                ++pos;
+            } else {
+                newValOp.val = INFINITY;
+                newValOp.ptr = NULL;
+                newValOp.name = this->names.indexOf(name);
+                if (newValOp.name == -1) {
+                    newValOp.name = this->names.size();
+                    this->names.push_back(name);
                 }
-            }
-            if (newValOp.op != FUNC) {
-                newValOp.val = INFINITY;//getVarVal(name, varList);
-                newValOp.ptr = getVarPtr(name, varList);
-                if (newValOp.ptr == NULL) return doError(2);
                 newValOp.op = VAL;
             }
 
         }
-        else if (isNum(equation)) {
-
-            QString fullNum = QString(equation[0]);
-            equation.remove(0,1);
+        else if (type & CHAR_NUM) {
 
-            if (equation.size() > 0) {
-                while (isNum(equation)) {
-                    fullNum += equation[0];
-                    equation.remove(0,1);
-                    if (equation.size() == 0) break;
+            int start = pos++;
+            while (pos < length && (charClass(chars[pos]) & CHAR_NUM)) {
+                ++pos;
+            }
+            // exponent
+            if (pos + 1 < length && (chars[pos] == 'e' || chars[pos] == 'E')) {
+                int exponent = pos + 1;
+                if ((chars[exponent] == '+' || chars[exponent] == '-') && exponent + 1 < length) {
+                    ++exponent;
+                }
+                if (chars[exponent].isDigit()) {
+                    pos = exponent;
+                    while (pos < length && chars[pos].isDigit()) {
+                        ++pos;
+                    }
                 }
             }
 
             newValOp.ptr = NULL;
-            newValOp.val = fullNum.toFloat();
+            newValOp.val = QString::fromRawData(chars + start, pos - start).toFloat();
             newValOp.op = VAL;
 
         }
-        else if (isCondition(equation)) {
-
-            QString tempCond = QString(equation[0]);
-            equation.remove(0,1);
+        else if (type & CHAR_CONDITION) {
 
-            if (equation.size() > 0) {
-                if (isCondition(equation)) {
-                    tempCond += equation[0];
-                    equation.remove(0,1);
-                }
+            int start = pos++;
+            if (pos < length && (charClass(chars[pos]) & CHAR_CONDITION)) {
+                ++pos;
             }
 
             newValOp.op = COND;
-            newValOp.val = float(getCondVal(tempCond));
-            if (newValOp.val == ERR) return doError(3);
+            newValOp.val = float(getCondVal(QString::fromRawData(chars + start, pos - start)));
+            if (newValOp.val == ERR && firstError.isEmpty()) firstError = doError(3);
+        }
+        else if (pos == length) {
+            // an empty equation - nothing to read
         }
-        else if (equation[0] == '(') {
+        else if (chars[pos] == '(') {
             newValOp.op = LBRACKET;
             newValOp.val = 1;
-            equation.remove(0,1);
+            ++pos;
         }
-        else if (equation[0] == ')') {
+        else if (chars[pos] == ')') {
             newValOp.op = RBRACKET;
             newValOp.val = 2;
-            equation.remove(0,1);
+            ++pos;
         }
-        else if (equation[0] == '&') {
-            if (equation.size() < 3) {
-                return doError(4);
+        else if (chars[pos] == '&') {
+            if (length - pos < 3) {
+                return firstError.isEmpty() ? doError(4) : firstError;
             }
             newValOp.op = BOOL_OP;
-            equation.remove(0,1);
-            if (equation[0] != '&') {
-                return doError(5);
+            ++pos;
+            if (chars[pos] != '&') {
+                return firstError.isEmpty() ? doError(5) : firstError;
             }
             newValOp.val = 1;
-            equation.remove(0,1);
+            ++pos;
         }
-        else if (equation[0] == '|') {
-            if (equation.size() < 3) {
-                return doError(4);
+        else if (chars[pos] == '|') {
+            if (length - pos < 3) {
+                return firstError.isEmpty() ? doError(4) : firstError;
             }
             newValOp.op = BOOL_OP;
-            equation.remove(0,1);
-            if (equation[0] != '|') {
-                return doError(5);
+            ++pos;
+            if (chars[pos] != '|') {
+                return firstError.isEmpty() ? doError(5) : firstError;
             }
             newValOp.val = 2;
-            equation.remove(0,1);
+            ++pos;
         }
-        else if (equation[0] == ',') {
+        else if (chars[pos] == ',') {
             newValOp.op = COMMA;
             newValOp.val = 1;
-            equation.remove(0,1);
+            ++pos;
+        }
+        else {
+            if (firstError.isEmpty()) firstError = doError(14);
+            ++pos;
+            if (pos == length) {
+                ended = true;
+            }
+            continue;
         }
 
 
@@ -1032,7 +1198,7 @@ QString createStack(QString equation, vector <lookup> &varList, vector <valop> *
         //cerr << float(equation.size()) << " " << equation.toStdString() << "\n";
 
         // finish
-        if (equation.size() == 0) {
+        if (pos == length) {
             ended = true;
         }
 
@@ -1040,6 +1206,10 @@ QString createStack(QString equation, vector <lookup> &varList, vector <valop> *
 
 
 
+    if (!firstError.isEmpty()) {
+        return firstError;
+    }
+
     // ok, we have an opstack of symbols - now refactor it for speed:
 
     /*
@@ -1077,7 +1247,7 @@ QString createStack(QString equation, vector <lookup> &varList, vector <valop> *
             tempStack.push_back(opstack[0]);
         }
         else if (opstack[0].op == COMMA) {
-            while (tempStack.back().op != FUNC && tempStack.size() > 0) {
+            while (tempStack.size() > 0 && tempStack.back().op != FUNC) {
                 calcStack.push_back(tempStack.back());
                 tempStack.pop_back();
             }
@@ -1098,15 +1268,16 @@ QString createStack(QString equation, vector <lookup> &varList, vector <valop> *
             tempStack.push_back(opstack[0]);
         }
         else if (opstack[0].op == RBRACKET) {
-            if (tempStack.size() == 0) return "Error - mismatched parentheses";
-            while (tempStack.back().op != LBRACKET && tempStack.back().op != FUNC) {
+            while (tempStack.size() > 0 && tempStack.back().op != LBRACKET && tempStack.back().op != FUNC) {
                 calcStack.push_back(tempStack.back());
                 tempStack.pop_back();
             }
+            if (tempStack.size() == 0) return doError(1);
+            // a bracket closes either itself or the function it opened
             if (tempStack.back().op == LBRACKET) {
                 tempStack.pop_back();
             }
-            if (tempStack.back().op == FUNC) {
+            else {
                 calcStack.push_back(tempStack.back());
                 tempStack.pop_back();
             }
@@ -1116,7 +1287,7 @@ QString createStack(QString equation, vector <lookup> &varList, vector <valop> *
     }
     // flush stack
     while (tempStack.size() > 0) {
-        if (tempStack.back().op == LBRACKET || tempStack.back().op == RBRACKET) return "Error - mismatched backets";
+        if (tempStack.back().op == LBRACKET || tempStack.back().op == RBRACKET || tempStack.back().op == FUNC) return doError(1);
         calcStack.push_back(tempStack.back());
         tempStack.pop_back();
     }
@@ -1124,10 +1295,428 @@ QString createStack(QString equation, vector <lookup> &varList, vector <valop> *
     //cerr << "FINAL RPN STACK: \n";
     //printStack(calcStack);
 
-    // send back
+    // keep
 
-    *returnStack = calcStack;
+    this->rpn = calcStack;
         // success!
     return "";
 }
 
+
+
+bytecodeProgram::bytecodeProgram() {
+
+    this->randoms = 0;
+    this->compiled = false;
+
+}
+
+void bytecodeProgram::append(bytecodeInstr instr) {
+
+    // fold constant operands into the instruction that uses them. Each instruction pushes at most
+    // one value, so if the last instructions pushed constants they are the operands on top
+    int n = (int) this->code.size();
+    switch (instr.op) {
+    case BC_ADD:
+    case BC_SUB:
+    case BC_MULT:
+    case BC_DIV:
+    case BC_FUNC2:
+        if (n > 1 && this->code[n-1].op == BC_CONST && this->code[n-2].op == BC_CONST) {
+            float val1 = this->code[n-2].val;
+            float val2 = this->code[n-1].val;
+            float result = 0;
+            if (instr.op == BC_ADD) result = val1+val2;
+            if (instr.op == BC_SUB) result = val1-val2;
+            if (instr.op == BC_MULT) result = val1*val2;
+            if (instr.op == BC_DIV) result = val1/val2;
+            if (instr.op == BC_FUNC2) result = doFunctionOp(val1, val2, instr.func);
+            this->code.pop_back();
+            this->code.back().val = result;
+            return;
+        }
+        break;
+    case BC_ZERO_OP:
+    case BC_FUNC1:
+        // rand() discards its operand but is never constant
+        if (n > 0 && this->code[n-1].op == BC_CONST && !(instr.op == BC_FUNC1 && instr.func == 19)) {
+            float val = this->code[n-1].val;
+            float result = 0;
+            if (instr.op == BC_FUNC1) {
+                result = doFunctionOp(val, INFINITY, instr.func);
+            } else {
+                if (instr.func == ADD) result = 0+val;
+                if (instr.func == SUB) result = 0-val;
+                if (instr.func == MULT) result = 0*val;
+                if (instr.func == DIV) result = 0/val;
+            }
+            this->code.back().val = result;
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+
+    this->code.push_back(instr);
+
+}
+
+void bytecodeProgram::compile(const vector <valop> &stack) {
+
+    this->code.clear();
+    this->fallback = stack;
+    this->vars.clear();
+    this->randoms = 0;
+    this->compiled = false;
+
+    // the depth of the stack is known at every point, which lets us check the operands are
+    // always there and that the fixed size evaluation stack is big enough
+    int depth = 0;
+
+    for (uint i = 0; i < stack.size(); ++i) {
+
+        bytecodeInstr instr;
+        instr.func = 0;
+        instr.val = 0;
+        instr.ptr = NULL;
+        instr.arg = 0;
+
+        switch (stack[i].op) {
+        case VAL:
+            if (stack[i].ptr != NULL) {
+                instr.op = BC_VAR;
+                instr.ptr = stack[i].ptr;
+                instr.arg = (int) (find(this->vars.begin(), this->vars.end(), instr.ptr) - this->vars.begin());
+                if (instr.arg == (int) this->vars.size()) {
+                    this->vars.push_back(instr.ptr);
+                }
+            } else {
+                instr.op = BC_CONST;
+                instr.val = stack[i].val;
+            }
+            this->append(instr);
+            ++depth;
+            break;
+        case FUNC:
+            instr.func = int(stack[i].val);
+            if (instr.func == 19) {
+                instr.arg = this->randoms++;
+            }
+            if (stack[i].isUnary) {
+                if (depth > 0) {
+                    instr.op = BC_FUNC1;
+                } else if (instr.func == 19) {
+                    instr.op = BC_RAND;
+                    ++depth;
+                } else {
+                    // no operand - the interpreter passes INFINITY
+                    instr.op = BC_CONST;
+                    instr.val = doFunctionOp(INFINITY, INFINITY, instr.func);
+                    ++depth;
+                }
+            } else {
+                // binary functions without both operands are left to the interpreter
+                if (depth < 2) return;
+                instr.op = BC_FUNC2;
+                --depth;
+            }
+            this->append(instr);
+            break;
+        case OP:
+            if (depth == 0) return;
+            if (stack[i].isUnary || depth == 1) {
+                // the interpreter applies these with a left operand of zero
+                instr.op = BC_ZERO_OP;
+                instr.func = int(stack[i].val);
+            } else {
+                switch (int(stack[i].val)) {
+                case ADD:
+                    instr.op = BC_ADD;
+                    break;
+                case SUB:
+                    instr.op = BC_SUB;
+                    break;
+                case MULT:
+                    instr.op = BC_MULT;
+                    break;
+                case DIV:
+                    instr.op = BC_DIV;
+                    break;
+                default:
+                    return;
+                }
+                --depth;
+            }
+            this->append(instr);
+            break;
+        default:
+            // not evaluated by the interpreter either
+            break;
+        }
+
+        if (depth > BYTECODE_MAX_STACK) return;
+    }
+
+    this->fallback.clear();
+    this->compiled = true;
+
+}
+
+float bytecodeProgram::evaluate(randomStream * random) const {
+
+    if (!this->compiled) {
+        return interpretMaths(this->fallback, random);
+    }
+
+    float stack[BYTECODE_MAX_STACK];
+    int top = -1;
+
+    const bytecodeInstr * instr = this->code.empty() ? NULL : &this->code[0];
+    const bytecodeInstr * end = instr + this->code.size();
+
+    for (; instr != end; ++instr) {
+
+        switch (instr->op) {
+        case BC_CONST:
+            stack[++top] = instr->val;
+            break;
+        case BC_VAR:
+            stack[++top] = *instr->ptr;
+            break;
+        case BC_ADD:
+            --top;
+            stack[top] = stack[top] + stack[top+1];
+            break;
+        case BC_SUB:
+            --top;
+            stack[top] = stack[top] - stack[top+1];
+            break;
+        case BC_MULT:
+            --top;
+            stack[top] = stack[top] * stack[top+1];
+            break;
+        case BC_DIV:
+            --top;
+            stack[top] = stack[top] / stack[top+1];
+            break;
+        case BC_ZERO_OP:
+            switch (instr->func) {
+            case ADD:
+                stack[top] = 0 + stack[top];
+                break;
+            case SUB:
+                stack[top] = 0 - stack[top];
+                break;
+            case MULT:
+                stack[top] = 0 * stack[top];
+                break;
+            case DIV:
+                stack[top] = 0 / stack[top];
+                break;
+            }
+            break;
+        case BC_FUNC1:
+            if (random != NULL && instr->func == 19) {
+                stack[top] = random->uniform();
+            } else {
+                stack[top] = doFunctionOp(stack[top], INFINITY, instr->func);
+            }
+            break;
+        case BC_FUNC2:
+            --top;
+            stack[top] = doFunctionOp(stack[top], stack[top+1], instr->func);
+            break;
+        case BC_RAND:
+            if (random != NULL) {
+                stack[++top] = random->uniform();
+            } else {
+                stack[++top] = float(rand())/RAND_MAX;
+            }
+            break;
+        }
+    }
+
+    if (top >= 0) {
+        return stack[top];
+    }
+
+    return 0.0;
+}
+
+// doFunctionOp over a batch - the function is picked once for the batch rather than for each
+// value, leaving a plain loop over the values for each function. b is NULL for functions called
+// with one argument
+static void doFunctionBatch(int func, float * a, const float * b, int count) {
+
+    bool twoArgs = (func == 0 || func == 16 || func == 20);
+
+    if (b == NULL) {
+        if (twoArgs) {
+            // missing the second argument
+            for (int k = 0; k < count; ++k) a[k] = INFINITY;
+            return;
+        }
+        switch (func) {
+        case 1:
+            for (int k = 0; k < count; ++k) a[k] = exp(a[k]);
+            break;
+        case 2:
+            for (int k = 0; k < count; ++k) a[k] = sin(a[k]);
+            break;
+        case 3:
+            for (int k = 0; k < count; ++k) a[k] = cos(a[k]);
+            break;
+        case 4:
+            for (int k = 0; k < count; ++k) a[k] = log(a[k]);
+            break;
+        case 5:
+            for (int k = 0; k < count; ++k) a[k] = log10(a[k]);
+            break;
+        case 6:
+            for (int k = 0; k < count; ++k) a[k] = sinh(a[k]);
+            break;
+        case 7:
+            for (int k = 0; k < count; ++k) a[k] = cosh(a[k]);
+            break;
+        case 8:
+            for (int k = 0; k < count; ++k) a[k] = tanh(a[k]);
+            break;
+        case 9:
+            for (int k = 0; k < count; ++k) a[k] = sqrt(a[k]);
+            break;
+        case 10:
+            for (int k = 0; k < count; ++k) a[k] = atan(a[k]);
+            break;
+        case 11:
+            for (int k = 0; k < count; ++k) a[k] = asin(a[k]);
+            break;
+        case 12:
+            for (int k = 0; k < count; ++k) a[k] = acos(a[k]);
+            break;
+        case 13:
+            for (int k = 0; k < count; ++k) a[k] = asinh(a[k]);
+            break;
+        case 14:
+            for (int k = 0; k < count; ++k) a[k] = acosh(a[k]);
+            break;
+        case 15:
+            for (int k = 0; k < count; ++k) a[k] = atanh(a[k]);
+            break;
+        case 17:
+            for (int k = 0; k < count; ++k) a[k] = ceil(a[k]);
+            break;
+        case 18:
+            for (int k = 0; k < count; ++k) a[k] = floor(a[k]);
+            break;
+        default:
+            for (int k = 0; k < count; ++k) a[k] = doFunctionOp(a[k], INFINITY, func);
+            break;
+        }
+        return;
+    }
+
+    switch (func) {
+    case 0:
+        for (int k = 0; k < count; ++k) a[k] = b[k] == INFINITY ? INFINITY : pow(a[k], b[k]);
+        break;
+    case 16:
+        for (int k = 0; k < count; ++k) a[k] = b[k] == INFINITY ? INFINITY : atan2(a[k], b[k]);
+        break;
+    case 20:
+        for (int k = 0; k < count; ++k) a[k] = b[k] == INFINITY ? INFINITY : fmod(a[k], b[k]);
+        break;
+    default:
+        // a second argument to a single argument function - an error, so not worth a fast path
+        for (int k = 0; k < count; ++k) a[k] = doFunctionOp(a[k], b[k], func);
+        break;
+    }
+
+}
+
+void bytecodeProgram::evaluateBatch(const float * const * inputs, const float * const * rands, int count, float * out, float * stack) const {
+
+    // inputs has an array of count values for each entry in variables(), and rands has one for
+    // each use of rand() in order. stack needs room for BYTECODE_MAX_STACK * count values
+    int top = -1;
+    float * a = NULL;
+    float * b = NULL;
+
+    for (uint i = 0; i < this->code.size(); ++i) {
+
+        const bytecodeInstr &instr = this->code[i];
+
+        switch (instr.op) {
+        case BC_CONST:
+            a = stack + (++top) * count;
+            for (int k = 0; k < count; ++k) a[k] = instr.val;
+            break;
+        case BC_VAR:
+            a = stack + (++top) * count;
+            for (int k = 0; k < count; ++k) a[k] = inputs[instr.arg][k];
+            break;
+        case BC_ADD:
+            a = stack + (--top) * count;
+            b = a + count;
+            for (int k = 0; k < count; ++k) a[k] = a[k] + b[k];
+            break;
+        case BC_SUB:
+            a = stack + (--top) * count;
+            b = a + count;
+            for (int k = 0; k < count; ++k) a[k] = a[k] - b[k];
+            break;
+        case BC_MULT:
+            a = stack + (--top) * count;
+            b = a + count;
+            for (int k = 0; k < count; ++k) a[k] = a[k] * b[k];
+            break;
+        case BC_DIV:
+            a = stack + (--top) * count;
+            b = a + count;
+            for (int k = 0; k < count; ++k) a[k] = a[k] / b[k];
+            break;
+        case BC_ZERO_OP:
+            a = stack + top * count;
+            switch (instr.func) {
+            case ADD:
+                for (int k = 0; k < count; ++k) a[k] = 0 + a[k];
+                break;
+            case SUB:
+                for (int k = 0; k < count; ++k) a[k] = 0 - a[k];
+                break;
+            case MULT:
+                for (int k = 0; k < count; ++k) a[k] = 0 * a[k];
+                break;
+            case DIV:
+                for (int k = 0; k < count; ++k) a[k] = 0 / a[k];
+                break;
+            }
+            break;
+        case BC_FUNC1:
+            a = stack + top * count;
+            if (instr.func == 19) {
+                for (int k = 0; k < count; ++k) a[k] = rands[instr.arg][k];
+            } else {
+                doFunctionBatch(instr.func, a, NULL, count);
+            }
+            break;
+        case BC_FUNC2:
+            a = stack + (--top) * count;
+            b = a + count;
+            doFunctionBatch(instr.func, a, b, count);
+            break;
+        case BC_RAND:
+            a = stack + (++top) * count;
+            for (int k = 0; k < count; ++k) a[k] = rands[instr.arg][k];
+            break;
+        }
+    }
+
+    if (top >= 0) {
+        a = stack + top * count;
+        for (int k = 0; k < count; ++k) out[k] = a[k];
+    } else {
+        for (int k = 0; k < count; ++k) out[k] = 0.0;
+    }
+
+}
@@ -69,11 +69,143 @@ public:
     float value;
 };
 
+/*!
+ * \brief The symbolTable class
+ * Resolves variable names to their slot in a variable list once, so names don't need to be
+ * searched for each time they are used. The first variable with a name wins, as with getVarPtr,
+ * and the variable list must not be resized while the table is in use.
+ */
+class symbolTable {
+
+public:
+    symbolTable(vector <lookup> &varList);
+    int slot(const QString &name) const {return slotOf.value(name, -1);}
+    float * pointer(const QString &name) const;
+    int size() const {return (int) vars->size();}
+
+private:
+    vector <lookup> * vars;
+    QHash <QString, int> slotOf;
+};
+
 struct valop {
     float val;
     operationSet op;
     float * ptr;
     bool isUnary;
+    int name; // index of the variable name in a mathsExpression, or -1
+};
+
+/*!
+ * \brief The mathsExpression class
+ * An equation parsed once into reverse Polish order, with its variables left as names. It can be
+ * bound to any variable list without parsing again, and the names it uses can be checked when
+ * validating. MathInLine keeps one for its equation.
+ */
+class mathsExpression {
+
+public:
+    mathsExpression() {}
+    explicit mathsExpression(QString equation);
+    const QString &equation() const {return source;}
+    const QString &error() const {return err;}
+    const QStringList &variableNames() const {return names;}
+    const QStringList &functionNames() const {return functions;}
+    QString bind(const symbolTable &symbols, vector <valop> * returnStack) const;
+
+private:
+    QString parse(QString equation);
+    QString source;
+    QString err;
+    vector <valop> rpn;
+    QStringList names;
+    QStringList functions;
+};
+
+/*!
+ * \brief The randomStream class
+ * A small random number generator (SplitMix64) used for rand() in maths, in place of the C
+ * library's global rand(). Streams can be split into independent streams by index, so work can
+ * be divided up (for example one stream per neuron) and give the same numbers however it is run.
+ */
+class randomStream {
+
+public:
+    randomStream(quint64 seed = 0) {state = seed;}
+    randomStream split(quint64 index) const {return randomStream(mix(state ^ mix(index + Q_UINT64_C(0x9E3779B97F4A7C15))));}
+    // uniform in [0,1], as rand()/RAND_MAX
+    float uniform() {state += Q_UINT64_C(0x9E3779B97F4A7C15); return float(mix(state) >> 40) / 16777215.0f;}
+
+private:
+    static quint64 mix(quint64 z) {
+        z = (z ^ (z >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+        z = (z ^ (z >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+        return z ^ (z >> 31);
+    }
+    quint64 state;
+};
+
+// maximum depth of the evaluation stack for compiled maths - deeper stacks are interpreted
+#define BYTECODE_MAX_STACK 64
+
+enum bytecodeOp {
+    BC_CONST,
+    BC_VAR,
+    BC_ADD,
+    BC_SUB,
+    BC_MULT,
+    BC_DIV,
+    BC_ZERO_OP,
+    BC_FUNC1,
+    BC_FUNC2,
+    BC_RAND
+};
+
+struct bytecodeInstr {
+    bytecodeOp op;
+    int func;
+    float val;
+    float * ptr;
+    int arg; // index of the variable or random number for batch evaluation
+};
+
+// number of values each instruction works on at once when evaluating in batches
+#define BYTECODE_BATCH_SIZE 1024
+
+/*!
+ * \brief The bytecodeProgram class
+ * A stack from createStack compiled into a flat list of instructions. Variables are resolved
+ * to pointers and constant sub-expressions are folded when compiling, and evaluation uses a
+ * fixed size stack so nothing is allocated per evaluation. Stacks that can't be compiled (such as
+ * malformed maths that relies on the interpreter's handling of missing operands) are kept and
+ * interpreted instead, so the results are always the same as interpretMaths.
+ *
+ * If a randomStream is given rand() is taken from it, otherwise from the C library's rand().
+ *
+ * Compiled programs can also be evaluated over a batch of values at once, with each variable
+ * and each use of rand() supplied as an array. Each instruction then runs as a tight loop over
+ * the batch which the compiler can vectorise.
+ */
+class bytecodeProgram {
+
+public:
+    bytecodeProgram();
+    void compile(const vector <valop> &stack);
+    float evaluate(randomStream * random = NULL) const;
+    bool isCompiled() const {return compiled;}
+    int size() const {return (int) code.size();}
+    const vector <bytecodeInstr> &instructions() const {return code;}
+    const vector <float *> &variables() const {return vars;}
+    int numRandoms() const {return randoms;}
+    void evaluateBatch(const float * const * inputs, const float * const * rands, int count, float * out, float * stack) const;
+
+private:
+    void append(bytecodeInstr instr);
+    vector <bytecodeInstr> code;
+    vector <valop> fallback;
+    vector <float *> vars;
+    int randoms;
+    bool compiled;
 };
 
 
@@ -91,6 +223,14 @@ float * getVarPtr(QString in, vector <lookup> &varList);
 
 float doFunction(float val1, float val2, float opf);
 
+float doFunctionOp(float val1, float val2, int op);
+
+// the C library function used for function number op by doFunctionOp (NULL for rand), and
+// whether it takes one argument - for code generated from the maths
+const char * functionLibraryName(int op);
+
+bool functionIsUnary(int op);
+
 bool isVar(QString in);
 
 bool isToken(QString in);
@@ -117,8 +257,10 @@ QString doBoolean(int startInd, int endInd, vector <valop> opstackIn, float * ou
 
 QString doBoolBrackets(int startInd, int endInd, vector <valop> opstackIn, float * outVal);
 */
-float interpretMaths(vector <valop>);
+float interpretMaths(const vector <valop> &, randomStream * random = NULL);
 
 QString createStack(QString equation, vector <lookup> &varList, vector <valop> * returnStack);
 
+QString createStack(QString equation, const symbolTable &symbols, vector <valop> * returnStack);
+
 #endif // CINTERPRETER_H
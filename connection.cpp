@@ -23,12 +23,14 @@
 ****************************************************************************/
 
 #include <Python.h>
+#include <algorithm>
 
 #include "connection.h"
 #include "cinterpreter.h"
 #include "generate_dialog.h"
 #include "viewVZlayoutedithandler.h"
 #include "filteroutundoredoevents.h"
+#include "connectionsink.h"
 
 connection::connection()
 {
@@ -587,52 +589,16 @@ void csv_connection::write_node_xml(QXmlStreamWriter &xmlOut)
         xmlOut.writeAttribute("explicit_delay_flag", QString::number(float(getNumCols()==3)));
         xmlOut.writeAttribute("packed_data", "true");
 
-        // re-write the data
-        if (getNumCols()==3) {
-            QVector <conn> conns;
-            this->getAllData(conns);
-
-            // write out
-            QFile export_file(saveFullFileName);
-
-            if (!export_file.open( QIODevice::WriteOnly)) {
-                QMessageBox msgBox;
-                msgBox.setText("Error creating exported binary connection file '" + saveFullFileName
-                               + "' (Check disk space; permissions)");
-                msgBox.exec();
-                return;
-            }
-
-            QDataStream access(&export_file);
-            for (int i = 0; i < conns.size(); ++i) {
-                access.writeRawData((char*) &conns[i].src, sizeof(int));
-                access.writeRawData((char*) &conns[i].dst, sizeof(int));
-                access.writeRawData((char*) &conns[i].metric, sizeof(float));
-            }
-        }
-        if (getNumCols()==2) {
-            QVector <conn> conns;
-            this->getAllData(conns);
-
-            // write out
-            QFile export_file(saveFullFileName);
-
-            if (!export_file.open( QIODevice::WriteOnly)) {
-                QMessageBox msgBox;
-                msgBox.setText("Error creating exported binary connection file '" + saveFullFileName
-                               + "' (Check disk space; permissions)");
-                msgBox.exec();
-                return;
-            }
-
-            QDataStream access(&export_file);
-            for (int i = 0; i < conns.size(); ++i) {
-                access.writeRawData((char*) &conns[i].src, sizeof(int));
-                access.writeRawData((char*) &conns[i].dst, sizeof(int));
-            }
+        // re-write the data, a chunk at a time
+        packedBinarySink exportSink(saveFullFileName);
+        if (!this->streamAllData(&exportSink)) {
+            QMessageBox msgBox;
+            msgBox.setText("Error creating exported binary connection file '" + saveFullFileName
+                           + "' (Check disk space; permissions)");
+            msgBox.exec();
+            return;
         }
 
-
     } else {
 
         // loop through connections writing them out in XML format.
@@ -1137,6 +1103,114 @@ void csv_connection::getAllData(QVector < conn > &conns)
     }
 }
 
+/*!
+ * \brief csv_connection::streamAllData
+ * \param sink
+ * \return false if the sink could not be written
+ *
+ * Pass the stored connections on to a sink a chunk at a time, rather than loading them all
+ */
+bool csv_connection::streamAllData(connectionSink * sink)
+{
+    if (!sink->begin(this->getNumCols())) {
+        return false;
+    }
+
+    // rewind file
+    file.seek(0);
+
+    QDataStream access(&file);
+
+    connectionChunkWriter writer(sink);
+
+    for (int i = 0; i < getNumRows(); ++i) {
+
+        conn newConn;
+        newConn.metric = NO_DELAY;
+
+        qint32 src;
+        qint32 dst;
+
+        access >> src;
+        access >> dst;
+
+        if (getNumCols() > 2) {
+            float temp_delay;
+            access >> temp_delay;
+            newConn.metric = temp_delay;
+        }
+
+        newConn.src = src;
+        newConn.dst = dst;
+
+        writer.add(newConn);
+    }
+    writer.flush();
+
+    return sink->end();
+}
+
+/*!
+ * \brief csv_connection::appendData
+ * \param chunk
+ * \param count
+ *
+ * Add connections to the end of the storage file. The caller is responsible for setting the
+ * number of columns beforehand and the number of rows afterwards.
+ */
+void csv_connection::appendData(const conn * chunk, int count)
+{
+    file.seek(file.size());
+
+    QDataStream access(&file);
+
+    for (int i = 0; i < count; ++i) {
+        access << (qint32) chunk[i].src;
+        access << (qint32) chunk[i].dst;
+        if (this->getNumCols() == 3) {
+            access << chunk[i].metric;
+        }
+    }
+
+    file.flush();
+}
+
+/*!
+ * \brief csv_connection::takeData
+ * \param other
+ *
+ * Replace the stored connections with those stored by other, by moving its storage file into
+ * place. other is left without storage, and should be deleted.
+ */
+void csv_connection::takeData(csv_connection * other)
+{
+    QString path = this->file.fileName();
+    QString otherPath = other->file.fileName();
+
+    this->file.close();
+    other->file.close();
+    QFile::remove(path);
+
+    if (!QFile::rename(otherPath, path)) {
+        if (!QFile::copy(otherPath, path)) {
+            qDebug() << "Could not move generated connections to" << path;
+        }
+        QFile::remove(otherPath);
+    }
+
+    // open the storage file
+    this->file.setFileName(path);
+    if (!this->file.open(QIODevice::ReadWrite)) {
+        QMessageBox msgBox;
+        msgBox.setText("Could not open output file for conversion");
+        msgBox.exec();
+    }
+
+    this->values = other->values;
+    this->numRows = other->numRows;
+    this->changes.clear();
+}
+
 float csv_connection::getData(int rowV, int col)
 {
     int colVal = getNumCols();
@@ -1347,11 +1421,12 @@ kernel_connection::kernel_connection()
     selfConnections = false;
     this->kernel_scale = 1.0;
     this->kernel_size = 3;
-    for (int i = 0; i < 11; ++i) {
-        for (int j = 0; j < 11; ++j) {
-            kernel[i][j] = 0.0;
-        }
-    }
+    this->kernel.fill(0.0, kernel_size*kernel_size);
+    this->kernel_type = KernelTable;
+    this->kernel_amplitude = 1.0;
+    this->kernel_sigma_x = 1.0;
+    this->kernel_sigma_y = 1.0;
+    this->kernel_cutoff = 3.0;
     rotation = 0;
     hasChanged = true;
 }
@@ -1387,6 +1462,14 @@ void kernel_connection::setKernelSize(int size)
 {
     if (kernel_size != size) {
         hasChanged = true;
+        // keep the existing values where they fit
+        QVector <float> newKernel(size*size, 0.0);
+        for (int i = 0; i < qMin(size, kernel_size); ++i) {
+            for (int j = 0; j < qMin(size, kernel_size); ++j) {
+                newKernel[i*size+j] = kernel[i*kernel_size+j];
+            }
+        }
+        kernel = newKernel;
         kernel_size = size;
     }
 }
@@ -1401,12 +1484,122 @@ void kernel_connection::setKernelScale(float scale)
 
 void kernel_connection::setKernel(int i, int j, float value)
 {
-    if (kernel[i][j] != value) {
+    if (i < 0 || j < 0 || i >= kernel_size || j >= kernel_size) {
+        return;
+    }
+    if (kernel[i*kernel_size+j] != value) {
+        hasChanged = true;
+        kernel[i*kernel_size+j] = value;
+    }
+}
+
+float kernel_connection::getKernel(int i, int j)
+{
+    if (i < 0 || j < 0 || i >= kernel_size || j >= kernel_size) {
+        return 0;
+    }
+    return kernel[i*kernel_size+j];
+}
+
+void kernel_connection::setKernelType(int type)
+{
+    if (kernel_type != (kernelType) type) {
         hasChanged = true;
-        kernel[i][j] = value;
+        kernel_type = (kernelType) type;
     }
 }
 
+void kernel_connection::setKernelAmplitude(float value)
+{
+    if (kernel_amplitude != value) {
+        hasChanged = true;
+        kernel_amplitude = value;
+    }
+}
+
+void kernel_connection::setKernelSigmaX(float value)
+{
+    if (kernel_sigma_x != value) {
+        hasChanged = true;
+        kernel_sigma_x = value;
+    }
+}
+
+void kernel_connection::setKernelSigmaY(float value)
+{
+    if (kernel_sigma_y != value) {
+        hasChanged = true;
+        kernel_sigma_y = value;
+    }
+}
+
+void kernel_connection::setKernelCutoff(float value)
+{
+    if (kernel_cutoff != value) {
+        hasChanged = true;
+        kernel_cutoff = value;
+    }
+}
+
+float kernel_connection::getProbability(float x, float y)
+{
+    float p = 0;
+
+    // if we are outside the kernel
+    if (!this->inKernel(x, y)) {
+        return 0;
+    }
+
+    switch (kernel_type) {
+    case KernelTable:
+    {
+        // find the right kernel box
+        float half = floor(kernel_size/2.0);
+        int boxX = floor(x / kernel_scale + 0.5) + half;
+        int boxY = floor(y / kernel_scale + 0.5) + half;
+        p = getKernel(boxX, boxY);
+        break;
+    }
+    case KernelSeparable:
+        p = kernel_amplitude * exp(-(x*x)/(2*kernel_sigma_x*kernel_sigma_x)) * exp(-(y*y)/(2*kernel_sigma_y*kernel_sigma_y));
+        break;
+    case KernelRadial:
+        p = kernel_amplitude * exp(-(x*x + y*y)/(2*kernel_sigma_x*kernel_sigma_x));
+        break;
+    }
+
+    return p;
+}
+
+bool kernel_connection::inKernel(float x, float y)
+{
+    switch (kernel_type) {
+    case KernelTable:
+    {
+        float half = floor(kernel_size/2.0);
+        return fabs(x) <= half * kernel_scale && fabs(y) <= half * kernel_scale;
+    }
+    case KernelSeparable:
+        return fabs(x) <= kernel_cutoff * kernel_sigma_x && fabs(y) <= kernel_cutoff * kernel_sigma_y;
+    case KernelRadial:
+        return x*x + y*y <= pow(kernel_cutoff * kernel_sigma_x, 2);
+    }
+    return false;
+}
+
+float kernel_connection::getExtent()
+{
+    switch (kernel_type) {
+    case KernelTable:
+        return floor(kernel_size/2.0) * kernel_scale * sqrt(2.0);
+    case KernelSeparable:
+        return kernel_cutoff * sqrt(kernel_sigma_x*kernel_sigma_x + kernel_sigma_y*kernel_sigma_y);
+    case KernelRadial:
+        return kernel_cutoff * kernel_sigma_x;
+    }
+    return 0;
+}
+
 void kernel_connection::write_node_xml(QXmlStreamWriter &xmlOut)
 {
     QSettings settings;
@@ -1415,13 +1608,23 @@ void kernel_connection::write_node_xml(QXmlStreamWriter &xmlOut)
         xmlOut.writeStartElement("KernelConnection");
         // extra stuff
         xmlOut.writeStartElement("Kernel");
-            xmlOut.writeAttribute("scale", QString::number(this->kernel_scale));
-            xmlOut.writeAttribute("size", QString::number(float(this->kernel_size)));
-            for (int i = 0; i < this->kernel_size; ++i) {
-                xmlOut.writeEmptyElement("KernelRow");
-                for (int j = 0; j < this->kernel_size; ++j)
-                    xmlOut.writeAttribute("col" + QString::number(float(j)), QString::number(this->kernel[i][j]));
+        // SpineML only has tables, so analytic kernels are written as one sampled at the centre
+        // of each box - their parameters are kept in the metadata
+        int size = this->kernel_size;
+        float scale = this->kernel_scale;
+        if (this->kernel_type != KernelTable) {
+            this->tableForExport(size, scale);
+        }
+        float half = floor(size/2.0);
+        xmlOut.writeAttribute("scale", QString::number(scale));
+        xmlOut.writeAttribute("size", QString::number(float(size)));
+        for (int i = 0; i < size; ++i) {
+            xmlOut.writeEmptyElement("KernelRow");
+            for (int j = 0; j < size; ++j) {
+                float value = this->kernel_type == KernelTable ? this->getKernel(i,j) : this->getProbability((i - half) * scale, (j - half) * scale);
+                xmlOut.writeAttribute("col" + QString::number(float(j)), QString::number(value));
             }
+        }
         xmlOut.writeEndElement(); // Kernel
         this->writeDelay(xmlOut);
         xmlOut.writeEndElement(); // KernelConnection
@@ -1480,23 +1683,19 @@ void kernel_connection::write_node_xml(QXmlStreamWriter &xmlOut)
             xmlOut.writeAttribute("num_connections", QString::number(float(connections.size())));
             xmlOut.writeAttribute("explicit_delay_flag", QString::number(float(0)));
 
-            // re-write the data
-
-            // write out
-            QFile export_file(saveFileName);
-            if (!export_file.open( QIODevice::WriteOnly)) {
+            // write out, a chunk at a time
+            packedBinarySink exportSink(saveFileName);
+            exportSink.begin(2);
+            for (int i = 0; i < connections.size(); i += CONNECTION_SINK_CHUNK) {
+                exportSink.write(connections.constData() + i, qMin(CONNECTION_SINK_CHUNK, connections.size() - i));
+            }
+            if (!exportSink.end()) {
                 QMessageBox msgBox;
                 msgBox.setText("Error creating binary connection file '" + saveFileName
                                + "' (Check disk space; permissions)");
                 msgBox.exec();
                 return;
             }
-
-            QDataStream access(&export_file);
-            for (int i = 0; i < connections.size(); ++i) {
-                access.writeRawData((char*) &connections[i].src, sizeof(int));
-                access.writeRawData((char*) &connections[i].dst, sizeof(int));
-            }
         }
 
         this->writeDelay(xmlOut);
@@ -1505,17 +1704,93 @@ void kernel_connection::write_node_xml(QXmlStreamWriter &xmlOut)
     }
 }
 
+/*!
+ * \brief kernel_connection::tableForExport
+ * \param size the number of boxes across a table covering the analytic kernel out to its cutoff
+ * \param scale the size of each box, KERNEL_EXPORT_BOXES_PER_SIGMA to the narrowest sigma where
+ * that fits in KERNEL_MAX_SIZE
+ */
+void kernel_connection::tableForExport(int &size, float &scale)
+{
+    float sigma = qMin(this->kernel_sigma_x, this->kernel_type == KernelSeparable ? this->kernel_sigma_y : this->kernel_sigma_x);
+    if (!(sigma > 0) || !(this->kernel_cutoff > 0)) {
+        size = 1;
+        scale = 1.0;
+        return;
+    }
+    scale = sigma / KERNEL_EXPORT_BOXES_PER_SIGMA;
+    float reach = this->kernel_cutoff * qMax(this->kernel_sigma_x, this->kernel_type == KernelSeparable ? this->kernel_sigma_y : this->kernel_sigma_x);
+    // long thin kernels get coarser boxes rather than a larger table
+    float half = ceil(reach / scale);
+    if (!(half <= (KERNEL_MAX_SIZE - 1) / 2)) {
+        half = (KERNEL_MAX_SIZE - 1) / 2;
+        scale = reach / half;
+    }
+    size = 2 * int(half) + 1;
+}
+
+/*!
+ * \brief kernel_connection::write_metadata_xml
+ * Analytic kernels are written to the network as a table, so keep what they were made from here
+ */
+void kernel_connection::write_metadata_xml(QDomDocument &meta, QDomNode &e)
+{
+    if (this->kernel_type == KernelTable) {
+        return;
+    }
+
+    QDomElement analytic = meta.createElement( "AnalyticKernel" );
+    e.appendChild(analytic);
+
+    analytic.setAttribute("type", this->kernel_type == KernelSeparable ? "separable" : "radial");
+    analytic.setAttribute("amplitude", QString::number(this->kernel_amplitude));
+    analytic.setAttribute("sigma_x", QString::number(this->kernel_sigma_x));
+    analytic.setAttribute("sigma_y", QString::number(this->kernel_sigma_y));
+    analytic.setAttribute("cutoff", QString::number(this->kernel_cutoff));
+}
+
+void kernel_connection::read_metadata_xml(QDomNode &e)
+{
+    QDomElement analytic = e.firstChildElement("AnalyticKernel");
+    if (analytic.isNull()) {
+        return;
+    }
+
+    this->kernel_type = analytic.attribute("type") == "separable" ? KernelSeparable : KernelRadial;
+    this->kernel_amplitude = analytic.attribute("amplitude", "1").toFloat();
+    this->kernel_sigma_x = analytic.attribute("sigma_x", "1").toFloat();
+    this->kernel_sigma_y = analytic.attribute("sigma_y", "1").toFloat();
+    this->kernel_cutoff = analytic.attribute("cutoff", "3").toFloat();
+}
+
 void kernel_connection::import_parameters_from_xml(QDomNode &e)
 {
     QDomNodeList kernelNode = e.toElement().elementsByTagName("Kernel");
     if (kernelNode.size() == 1) {
         QDomNode n = kernelNode.item(0);
-        this->kernel_scale = n.toElement().attribute("scale").toFloat();
-        this->kernel_size = n.toElement().attribute("size").toInt();
-        QDomNodeList rows = n.toElement().elementsByTagName("KernelRow");
-        for (int i = 0; i < rows.size(); ++i) {
-            for (int j = 0; j < this->kernel_size; ++j)
-                kernel[i][j] = rows.item(i).toElement().attribute("col" + QString::number(float(j))).toFloat();
+        // older projects wrote analytic kernels into the network
+        QString type = n.toElement().attribute("type", "table");
+        if (type == "separable" || type == "radial") {
+            this->kernel_type = (type == "separable") ? KernelSeparable : KernelRadial;
+            this->kernel_amplitude = n.toElement().attribute("amplitude", "1").toFloat();
+            if (this->kernel_type == KernelSeparable) {
+                this->kernel_sigma_x = n.toElement().attribute("sigma_x", "1").toFloat();
+                this->kernel_sigma_y = n.toElement().attribute("sigma_y", "1").toFloat();
+            } else {
+                this->kernel_sigma_x = n.toElement().attribute("sigma", "1").toFloat();
+                this->kernel_sigma_y = this->kernel_sigma_x;
+            }
+            this->kernel_cutoff = n.toElement().attribute("cutoff", "3").toFloat();
+        } else {
+            this->kernel_type = KernelTable;
+            this->kernel_scale = n.toElement().attribute("scale").toFloat();
+            this->kernel_size = n.toElement().attribute("size").toInt();
+            this->kernel.fill(0.0, this->kernel_size*this->kernel_size);
+            QDomNodeList rows = n.toElement().elementsByTagName("KernelRow");
+            for (int i = 0; i < rows.size() && i < this->kernel_size; ++i) {
+                for (int j = 0; j < this->kernel_size; ++j)
+                    kernel[i*this->kernel_size+j] = rows.item(i).toElement().attribute("col" + QString::number(float(j))).toFloat();
+            }
         }
     }
 
@@ -1571,11 +1846,49 @@ void kernel_connection::generate_connections()
     float total_ops = src->layoutType->locations.size();
     int scale_val = round(100000000.0/(src->layoutType->locations.size()*dst->layoutType->locations.size()));
 
+    // hand the connections over a chunk at a time, rather than taking the lock for each one
+    connectionVectorSink sink(conns, mutex);
+    connectionChunkWriter writer(&sink);
+
     int oldprogress = 0;
 
+    // bucket the destinations into a grid the size of the kernel's reach, so each source only has
+    // to look at the destinations in the surrounding cells rather than all of them. A kernel with
+    // no reach (1x1) only covers neurons in the same place, which share a cell of any size
+    float extent = this->getExtent();
+    float cellSize = extent > 0 ? extent : 1.0;
+    int reach = extent > 0 ? 1 : 0;
+    QHash < quint64, QVector <int> > grid;
+    for (int j = 0; j < (int) dst->layoutType->locations.size(); ++j) {
+        qint32 cellX = floor(dst->layoutType->locations[j].x / cellSize);
+        qint32 cellY = floor(dst->layoutType->locations[j].y / cellSize);
+        grid[(quint64(quint32(cellX)) << 32) | quint32(cellY)].push_back(j);
+    }
+
+    float cosRot = cos(rotation);
+    float sinRot = sin(rotation);
+
+    QVector <int> candidates;
+
     for (int i = 0; i < src->layoutType->locations.size(); ++i) {
-        //#pragma omp parallel for
-        for (int j = 0; j < (int) dst->layoutType->locations.size(); ++j) {
+
+        // gather the destinations that could be in reach, in order
+        candidates.clear();
+        qint32 cellX = floor(src->layoutType->locations[i].x / cellSize);
+        qint32 cellY = floor(src->layoutType->locations[i].y / cellSize);
+        for (int cx = cellX - reach; cx <= cellX + reach; ++cx) {
+            for (int cy = cellY - reach; cy <= cellY + reach; ++cy) {
+                QHash < quint64, QVector <int> >::const_iterator cell = grid.constFind((quint64(quint32(cx)) << 32) | quint32(cy));
+                if (cell != grid.constEnd()) {
+                    candidates += cell.value();
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        for (int c = 0; c < candidates.size(); ++c) {
+
+            int j = candidates[c];
 
             // CALCULATE (kernels ignore z component for now!)
             float xRaw = dst->layoutType->locations[j].x - src->layoutType->locations[i].x;
@@ -1585,30 +1898,26 @@ void kernel_connection::generate_connections()
             float x;
             float y;
             if (rotation != 0) {
-                x = cos(rotation)*xRaw - sin(rotation)*yRaw;
-                y = sin(rotation)*xRaw + cos(rotation)*yRaw;
+                x = cosRot*xRaw - sinRot*yRaw;
+                y = sinRot*xRaw + cosRot*yRaw;
             } else {
                 x = xRaw;
                 y = yRaw;
             }
 
-            // if we are outside the kernel
-            if (fabs(x) > floor(kernel_size/2.0) * kernel_scale || \
-                    fabs(y) > floor(kernel_size/2.0) * kernel_scale)
+            // a number is drawn for every pair the kernel covers, as it always was, so the
+            // connectivity of existing projections doesn't change
+            if (!this->inKernel(x, y)) {
                 continue;
-
-            // otherwise find the right kernel box
-            int boxX = floor(x / kernel_scale + 0.5) + floor(kernel_size/2.0);
-            int boxY = floor(y / kernel_scale + 0.5) + floor(kernel_size/2.0);
+            }
 
             // add connection based on kernel
-            if (float(rand())/float(RAND_MAX) < kernel[boxX][boxY]) {
-                mutex->lock();
+            if (float(rand())/float(RAND_MAX) < this->getProbability(x, y)) {
                 conn newConn;
                 newConn.src = i;
                 newConn.dst = j;
-                conns->push_back(newConn);
-                mutex->unlock();
+                newConn.metric = NO_DELAY;
+                writer.add(newConn);
             }
         }
         if (round(float(i)/total_ops * 100.0) > oldprogress) {
@@ -1616,6 +1925,7 @@ void kernel_connection::generate_connections()
             oldprogress = round(float(i)/total_ops * 100.0)+scale_val;
         }
     }
+    writer.flush();
     this->moveToThread(QApplication::instance()->thread());
     emit connectionsDone();
 }
@@ -1638,10 +1948,19 @@ pythonscript_connection::pythonscript_connection(QSharedPointer <population> src
     this->src = src;
     this->dst = dst;
     this->connection_target = conn_targ;
+    this->conns = NULL;
+    this->cancelRequested = false;
+    this->pyThreadId = 0;
+    this->adoptCacheKey = false;
+    this->generatedList = NULL;
 }
 
 pythonscript_connection::~pythonscript_connection()
 {
+    if (this->generatedList) {
+        this->generatedList->clearData();
+        delete this->generatedList;
+    }
 }
 
 int pythonscript_connection::getIndex()
@@ -2053,7 +2372,7 @@ void pythonscript_connection::configureFromScript(QString script)
     this->lastGeneratedParValues.fill(0);
 }
 
-void pythonscript_connection::regenerateConnections()
+void pythonscript_connection::refreshScriptText()
 {
     // refetch the script text
     QSettings settings;
@@ -2069,6 +2388,37 @@ void pythonscript_connection::regenerateConnections()
         this->scriptText = script;
     }
     settings.endGroup();
+}
+
+void pythonscript_connection::applyWeights()
+{
+    // move the weights across
+    ParameterData * par = this->getPropPointer();
+    if (par && this->hasWeight) {
+        par->currType = ExplicitList;
+        par->value = this->weights;
+        par->indices.clear();
+        for (int i = 0; i < this->weights.size(); ++i) {
+            par->indices.push_back(i);
+        }
+    }
+}
+
+bool pythonscript_connection::layoutsChanged()
+{
+    // connectivity loaded from a project saved before the key was kept is taken as current
+    if (this->adoptCacheKey) {
+        this->adoptCacheKey = false;
+        if (!this->hasChanged) {
+            this->lastGeneratedCacheKey = this->getCacheKey();
+        }
+    }
+    return this->getCacheKey() != this->lastGeneratedCacheKey;
+}
+
+void pythonscript_connection::regenerateConnections()
+{
+    this->refreshScriptText();
 
     // test if required
     if (!this->changed()) {
@@ -2130,6 +2480,11 @@ void pythonscript_connection::write_metadata_xml(QDomDocument &meta, QDomNode &e
     if (!this->weightProp.isEmpty()) {
         config.setAttribute("weightProperty", this->weightProp);
     }
+
+    // what the saved connectivity was generated from, so it isn't regenerated on load
+    if (!this->lastGeneratedCacheKey.isEmpty()) {
+        config.setAttribute("generatedFrom", this->lastGeneratedCacheKey);
+    }
 }
 
 void pythonscript_connection::read_metadata_xml(QDomNode &e)
@@ -2165,10 +2520,12 @@ void pythonscript_connection::read_metadata_xml(QDomNode &e)
         if (node.toElement().tagName() == "Config") {
             // get the name of the weight property associated with the script
             this->weightProp = node.toElement().attribute("weightProperty", "");
+            this->lastGeneratedCacheKey = node.toElement().attribute("generatedFrom", "");
         }
 
         node = node.nextSibling();
     }
+    this->adoptCacheKey = this->lastGeneratedCacheKey.isEmpty();
 
     // now try to match the script to a script in the library - if you can't then add the script
     QSettings settings;
@@ -2350,56 +2707,232 @@ QVector <float> listToVector(PyObject * list)
     return vect;
 }
 
-struct outputUnPackaged
+/*!
+ * \brief getConnectivityCacheDir
+ * The directory in the library that holds previously generated connectivity
+ */
+static QDir getConnectivityCacheDir()
 {
-    QVector <conn> connections;
-    QVector <double> weights;
-};
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+    QDir lib_dir = QDir(QDesktopServices::storageLocation(QDesktopServices::DataLocation));
+#else
+    QDir lib_dir = QDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+#endif
+    QDir cache_dir = QDir(lib_dir.absoluteFilePath("connectivity_cache"));
+    if (!cache_dir.exists()) {
+        if (!cache_dir.mkpath(cache_dir.absolutePath())) {
+            qDebug() << "error creating connectivity cache";
+        }
+    }
+    return cache_dir;
+}
+
+bool pythonscript_connection::cacheEnabled()
+{
+    QSettings settings;
+    return settings.value("fileOptions/cacheConnectivity", true).toBool();
+}
+
+void pythonscript_connection::clearCache()
+{
+    QDir cache_dir = getConnectivityCacheDir();
+    QStringList entries = cache_dir.entryList(QDir::Files);
+    for (int i = 0; i < entries.size(); ++i) {
+        if (!cache_dir.remove(entries[i])) {
+            qDebug() << "Could not remove connectivity cache entry" << entries[i];
+        }
+    }
+}
 
 /*!
- * \brief listToVector
- * \param list
- * \return
- * A simple function to take the output of a connection function and unpack it
+ * \brief streamOutput
+ * \param output the object returned by the script
+ * \param sink where the connections, and any weights, are sent
+ * \param numConns
+ * \param numWeights the number of connections that came with a weight
+ * \param numCols
+ * \param cancelled
+ * \return false if iterating the output raised a Python exception, which is left set
+ *
+ * Pass the connections returned by a script on to a sink a chunk at a time. The script may return
+ * a list, or any other iterable such as a generator so that very large projections never have to
+ * exist as a single list. Must be called with the GIL held - it is released while the sink
+ * writes, so other scripts can run while the connections are stored.
  */
-outputUnPackaged extractOutput(PyObject * output, bool hasDelay, bool hasWeight)
-{
-    // create the structure to hold the unpacked output
-    outputUnPackaged outUnPacked;
-    if (PyList_Size(output) < 1) {
-        outUnPacked.weights.push_back(-234.56);
-        return outUnPacked;
-    }
-    outUnPacked.connections.resize(PyList_Size(output));
-    if (outUnPacked.connections.size()>0) {
-        outUnPacked.connections[0].metric = NO_DELAY;
-    }
-    outUnPacked.weights.resize(PyList_Size(output));
-    for (int i = 0; i < PyList_Size(output); ++i) {
-        // get the element
-        PyObject * element = PyList_GetItem(output,i);
-        // check it is a tuple
-        if (PyTuple_Check(element)) {
-            // if the tuple has enough items for a src index and dst index
-            if (PyTuple_Size(element) > 1) {
-                outUnPacked.connections[i].src = PyInt_AsLong(PyTuple_GetItem(element,0));
-                outUnPacked.connections[i].dst = PyInt_AsLong(PyTuple_GetItem(element,1));
-            }
-            // if we have a delay as well
-            if (PyTuple_Size(element) > 2 && hasDelay) {
-                outUnPacked.connections[i].metric = PyFloat_AsDouble(PyTuple_GetItem(element,2));
-            }
-            // if we have a weight as well
-            if (PyTuple_Size(element) > 3 && hasWeight) {
-                outUnPacked.weights[i] = PyFloat_AsDouble(PyTuple_GetItem(element,3));
-            } else {
-                outUnPacked.weights.clear();
+static bool streamOutput(PyObject * output, bool hasDelay, bool hasWeight, connectionSink * sink, int &numConns, int &numWeights, int &numCols, volatile bool * cancelled)
+{
+    numConns = 0;
+    numWeights = 0;
+    numCols = hasDelay ? 3 : 2;
+
+    PyObject * iter = PyObject_GetIter(output);
+    if (!iter) {
+        return false;
+    }
+
+    connectionChunkWriter writer(sink);
+    bool begun = false;
+
+    PyObject * element;
+    while ((element = PyIter_Next(iter))) {
+        // only tuples of (src, dst, [delay, [weight]]) are connections
+        if (!PyTuple_Check(element) || PyTuple_Size(element) < 2) {
+            Py_DECREF(element);
+            continue;
+        }
+
+        conn newConn;
+        newConn.src = PyInt_AsLong(PyTuple_GetItem(element,0));
+        newConn.dst = PyInt_AsLong(PyTuple_GetItem(element,1));
+        newConn.metric = NO_DELAY;
+        // if we have a delay as well
+        if (PyTuple_Size(element) > 2 && hasDelay) {
+            newConn.metric = PyFloat_AsDouble(PyTuple_GetItem(element,2));
+        }
+        // if we have a weight as well
+        bool weighted = PyTuple_Size(element) > 3 && hasWeight;
+        double weight = weighted ? PyFloat_AsDouble(PyTuple_GetItem(element,3)) : 0.0;
+        Py_DECREF(element);
+
+        // the first connection decides if there are delays
+        if (!begun) {
+            numCols = (newConn.metric != NO_DELAY) ? 3 : 2;
+            Py_BEGIN_ALLOW_THREADS
+            sink->begin(numCols);
+            Py_END_ALLOW_THREADS
+            begun = true;
+        }
+
+        if (writer.isFull()) {
+            Py_BEGIN_ALLOW_THREADS
+            writer.flush();
+            Py_END_ALLOW_THREADS
+            if (*cancelled) {
+                Py_DECREF(iter);
+                PyErr_SetNone(PyExc_KeyboardInterrupt);
+                return false;
             }
         }
+
+        if (weighted) {
+            writer.add(newConn, weight);
+        } else {
+            writer.add(newConn);
+        }
+    }
+    Py_DECREF(iter);
+
+    if (PyErr_Occurred()) {
+        return false;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    if (!begun) {
+        sink->begin(numCols);
+    }
+    writer.flush();
+    Py_END_ALLOW_THREADS
+
+    numConns = writer.count();
+    numWeights = writer.weightCount();
+
+    return true;
+}
+
+/*!
+ * \brief getPythonError
+ * \return
+ * Fetch and clear the current Python exception as a message for the user
+ */
+static QString getPythonError()
+{
+    QString errors = "Python Error: ";
+    PyObject * errtype, * errval, * errtrace;
+    PyErr_Fetch(&(errtype), &(errval), &(errtrace));
+
+    if (errval) {
+        PyObject * errstr = PyObject_Str(errval);
+        if (errstr) {
+            errors += PyString_AsString(errstr);
+        }
+        Py_XDECREF(errstr);
+    }
+    if (errtrace) {
+        PyTracebackObject * errtraceObj = (PyTracebackObject *) errtrace;
+        while (errtraceObj->tb_next) {
+            errtraceObj = errtraceObj->tb_next;
+        }
+        errors += QString("Error found on line:") + QString::number(errtraceObj->tb_lineno);
     }
-    return outUnPacked;
+    Py_XDECREF(errtype);
+    Py_XDECREF(errval);
+    Py_XDECREF(errtrace);
+    return errors;
 }
 
+/*!
+ * \brief The pythonGILGuard class
+ * Holds the GIL for as long as it is in scope. The GUI thread releases the GIL once Python is
+ * initialised, so scripts can be run from the generator queue's worker thread as well as the GUI
+ * thread. While held, the id of the interpreter thread is published so that the script can be
+ * interrupted.
+ */
+class pythonGILGuard
+{
+public:
+    pythonGILGuard(long * threadId) {
+        this->state = PyGILState_Ensure();
+        this->threadId = threadId;
+        *this->threadId = PyThreadState_Get()->thread_id;
+    }
+    ~pythonGILGuard() {
+        // clear the id first so a late cancel cannot hit the next script run on this thread
+        *this->threadId = 0;
+        PyGILState_Release(this->state);
+    }
+
+private:
+    PyGILState_STATE state;
+    long * threadId;
+};
+
+/*!
+ * \brief pyReportProgress
+ * \param self
+ * \param args
+ * \return
+ * Made available to connection scripts as reportProgress(percent), so long scripts can drive the
+ * progress bar. Also gives the script a point at which a cancel request is honoured even if it is
+ * busy in C code.
+ */
+static PyObject * pyReportProgress(PyObject * self, PyObject * args)
+{
+    double percent;
+    if (!PyArg_ParseTuple(args, "d", &percent)) {
+        return NULL;
+    }
+
+    pythonscript_connection * conn = (pythonscript_connection *) PyCapsule_GetPointer(self, NULL);
+    if (conn == NULL) {
+        return NULL;
+    }
+
+    if (conn->generationCancelled()) {
+        PyErr_SetNone(PyExc_KeyboardInterrupt);
+        return NULL;
+    }
+
+    // the script part of the generation runs between 10% and 90%
+    if (percent < 0) percent = 0;
+    if (percent > 100) percent = 100;
+    emit conn->progress(10 + (int) round(percent * 0.8));
+
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef reportProgressDef = {"reportProgress", pyReportProgress, METH_VARARGS,
+                                        "Report the percentage of the connectivity generated so far"};
+
 /*!
  * \brief createPyFunc
  * \param pymod
@@ -2449,145 +2982,404 @@ PyObject * createPyFunc(PyObject * pymod, QString text, QString &errs)
 /*!
  * \brief pythonscript_connection::generate_connections
  * function called to generate the connection into an explicit list -
- * used to draw the connections in the 3D view or export for simulation
+ * used to draw the connections in the 3D view or export for simulation.
+ * May be run on the pythonGeneratorQueue worker thread.
  */
 void pythonscript_connection::generate_connections()
 {
-    conns->clear();
+    if (!this->prepareGeneration()) {
+        return;
+    }
+    this->generateFromLayouts();
+    this->finishGeneration();
+}
 
+/*!
+ * \brief pythonscript_connection::prepareGeneration
+ * Regenerate the src and dst locations and take a snapshot of them for generateFromLayouts
+ */
+bool pythonscript_connection::prepareGeneration()
+{
     this->pythonErrors.clear();
 
-    // regenerate src and dst locations
     QString errorLog;
     src->layoutType->generateLayout(src->numNeurons,&src->layoutType->locations,errorLog);
     if (!errorLog.isEmpty()) {
-        qDebug() << "no src locs";
-        return;
+        this->pythonErrors = "Could not generate the layout of " + src->getName() + ": " + errorLog;
+        return false;
     }
     dst->layoutType->generateLayout(dst->numNeurons,&dst->layoutType->locations,errorLog);
     if (!errorLog.isEmpty()) {
-        qDebug() << "no dst locs";
-        return;
+        this->pythonErrors = "Could not generate the layout of " + dst->getName() + ": " + errorLog;
+        return false;
     }
 
-    // a tuple to hold the arguments to the Python Script - size of the scripts pars + the src and dst locations
-    PyObject * argsPy = PyTuple_New(this->parNames.size()+2/* 2 for the src and dst locations*/);
+    this->snapshotLayouts();
+    return true;
+}
 
-    // convert the locations into Python Objects:
-    PyObject * srcPy = vectorLocToList(&src->layoutType->locations);
-    PyObject * dstPy = vectorLocToList(&dst->layoutType->locations);
+void pythonscript_connection::snapshotLayouts()
+{
+    this->srcLocations = src->layoutType->locations;
+    this->dstLocations = dst->layoutType->locations;
+    this->generationCacheKey = this->getCacheKey();
 
-    // add them to the tuple
-    PyTuple_SetItem(argsPy,0,srcPy);
-    PyTuple_SetItem(argsPy,1,dstPy);
+    // the explicit list may be read here while the worker generates, so it works on its own
+    if (this->generatedList) {
+        this->generatedList->clearData();
+        delete this->generatedList;
+        this->generatedList = NULL;
+    }
+    if (this->connection_target != NULL) {
+        this->generatedList = new csv_connection();
+    }
+}
 
-    // convert the parameters into Python Objects and add them to the tuple
-    for (int i = 0; i < this->parNames.size(); ++i) {
-        PyTuple_SetItem(argsPy,i+2,PyFloat_FromDouble(parValues[i]));
+void pythonscript_connection::finishGeneration()
+{
+    if (this->generatedList) {
+        if (this->pythonErrors.isEmpty()) {
+            this->connection_target->takeData(this->generatedList);
+        } else {
+            this->generatedList->clearData();
+        }
+        delete this->generatedList;
+        this->generatedList = NULL;
     }
 
-    // check the tuple is sound
-    if (!argsPy) {
-        qDebug() << "Bad args tuple";
-        Py_XDECREF(argsPy);
-        Py_XDECREF(srcPy);
-        Py_XDECREF(dstPy);
-        return;
+    if (this->connection_target == NULL && this->conns && this->conns != &this->connections) {
+        (*this->conns) = this->connections;
     }
+}
 
-    //Create a new module object
-    PyObject *pymod = PyModule_New("mymod");
+/*!
+ * \brief pythonscript_connection::generateFromLayouts
+ * Run the script against the snapshot of the src and dst locations taken by snapshotLayouts.
+ * Only touches the connection's own members, so it can be run on another thread while the
+ * layouts are changed.
+ */
+void pythonscript_connection::generateFromLayouts()
+{
+    this->pythonErrors.clear();
 
-    // add the function to Python, and get a PyObject for it
-    PyObject * pyFunc = createPyFunc(pymod, this->scriptText, this->pythonErrors);
+    if (this->cancelRequested) {
+        this->pythonErrors = "Connection generation cancelled";
+        return;
+    }
 
-    // check that function creation worked
-    if (!pyFunc) {
-        if (pythonErrors.isEmpty()) {
-            pythonErrors = "Python Error: Script function is not named connectionFunc.";
-        }
-        Py_XDECREF(argsPy);
-        Py_XDECREF(srcPy);
-        Py_XDECREF(dstPy);
-        Py_XDECREF(pyFunc);
-        Py_XDECREF(pymod);
+    emit progress(5);
+
+    // if we have generated this exact projection before then reuse the stored result
+    QString cacheKey = this->generationCacheKey;
+    bool useCache = cacheEnabled();
+    if (useCache && this->loadFromCache(cacheKey)) {
+        emit progress(100);
+        this->scriptValidates = true;
+        this->lastGeneratedCacheKey = cacheKey;
+        this->setUnchanged(true);
         return;
     }
 
-    //Call my function
-    PyObject * output = PyObject_CallObject(pyFunc, argsPy);
-    Py_XDECREF(argsPy);
-    Py_XDECREF(srcPy);
-    Py_XDECREF(dstPy);
+    // the connections and weights go straight from the script's output to the storage and the
+    // cache - the cache entry is written under a temporary name, and only renamed into place once
+    // it is complete
+    connectionVectorSink vectorSink(&this->connections);
+    csvStorageSink storageSink(this->generatedList);
+    weightVectorSink weightSink(&this->weights);
+    packedBinarySink cacheSink(getConnectivityCacheDir().absoluteFilePath(cacheKey + ".bin.part"));
+    connectionTeeSink storeSink(this->generatedList != NULL ? (connectionSink *) &storageSink : (connectionSink *) &vectorSink, &weightSink);
+    connectionTeeSink teeSink(&storeSink, &cacheSink);
+    connectionSink * sink = useCache ? (connectionSink *) &teeSink : (connectionSink *) &storeSink;
 
-    Py_XDECREF(pyFunc);
-    Py_XDECREF(pymod);
+    int numConns = 0;
+    int numWeights = 0;
+    int numCols = 2;
 
-    if (!output) {
-        this->pythonErrors = "Python Error: ";
-        PyObject * errtype, * errval, * errtrace;
-        PyErr_Fetch(&(errtype), &(errval), &(errtrace));
+    if (this->generatedList == NULL) {
+        this->connections.clear();
+    }
+    this->weights.clear();
 
-        if (errval) {
-            pythonErrors += PyString_AsString(errval);
+    {
+        // everything in this scope touches the interpreter
+        pythonGILGuard gil(&this->pyThreadId);
+
+        // a cancel may have arrived before we had an interpreter thread to interrupt
+        if (this->cancelRequested) {
+            this->pythonErrors = "Connection generation cancelled";
+            return;
         }
-        if (errtrace) {
-            PyTracebackObject * errtraceObj = (PyTracebackObject *) errtrace;
-            while (errtraceObj->tb_next) {
-                errtraceObj = errtraceObj->tb_next;
-            }
-            pythonErrors += QString("Error found on line:") + QString::number(errtraceObj->tb_lineno);
+
+        // a tuple to hold the arguments to the Python Script - size of the scripts pars + the src and dst locations
+        PyObject * argsPy = PyTuple_New(this->parNames.size()+2/* 2 for the src and dst locations*/);
+
+        // convert the locations into Python Objects:
+        PyObject * srcPy = vectorLocToList(&this->srcLocations);
+        PyObject * dstPy = vectorLocToList(&this->dstLocations);
+
+        // add them to the tuple
+        PyTuple_SetItem(argsPy,0,srcPy);
+        PyTuple_SetItem(argsPy,1,dstPy);
+
+        // convert the parameters into Python Objects and add them to the tuple
+        for (int i = 0; i < this->parNames.size(); ++i) {
+            PyTuple_SetItem(argsPy,i+2,PyFloat_FromDouble(parValues[i]));
         }
-        return;
-    }
 
-    // unpack the output into C++ forms
-    outputUnPackaged unpacked = extractOutput(output, this->hasDelay, this->hasWeight);
+        // check the tuple is sound
+        if (!argsPy) {
+            qDebug() << "Bad args tuple";
+            Py_XDECREF(argsPy);
+            Py_XDECREF(srcPy);
+            Py_XDECREF(dstPy);
+            return;
+        }
 
-    // transfer the unpacked output to the local storage location for connections
-    if (this->connection_target != NULL) {
+        //Create a new module object
+        PyObject *pymod = PyModule_New("mymod");
 
-        // remove existing connections
-        this->connection_target->clearData();
+        // give the script a way to report progress
+        PyObject * selfPy = PyCapsule_New((void *) this, NULL, NULL);
+        PyModule_AddObject(pymod, "reportProgress", PyCFunction_New(&reportProgressDef, selfPy));
+        Py_XDECREF(selfPy);
 
-        // if no connections are returned
-        if (unpacked.connections.size() > 0) {
-            // otherwise...
-            if (this->hasDelay) {
-                // if we have delays, resize
-                this->connection_target->setNumCols(3);
-            } else {
-                //  no delays
-                this->connection_target->setNumCols(2);
+        emit progress(10);
+
+        // add the function to Python, and get a PyObject for it
+        PyObject * pyFunc = createPyFunc(pymod, this->scriptText, this->pythonErrors);
+
+        // check that function creation worked
+        if (!pyFunc) {
+            if (this->cancelRequested) {
+                pythonErrors = "Connection generation cancelled";
+            } else if (pythonErrors.isEmpty()) {
+                pythonErrors = "Python Error: Script function is not named connectionFunc.";
+            }
+            // the tuple owns the location lists
+            Py_XDECREF(argsPy);
+            Py_XDECREF(pyFunc);
+            Py_XDECREF(pymod);
+            return;
+        }
+
+        //Call my function
+        PyObject * output = PyObject_CallObject(pyFunc, argsPy);
+        Py_XDECREF(argsPy);
+
+        Py_XDECREF(pyFunc);
+        Py_XDECREF(pymod);
+
+        if (!output) {
+            if (this->cancelRequested || PyErr_ExceptionMatches(PyExc_KeyboardInterrupt)) {
+                PyErr_Clear();
+                this->pythonErrors = "Connection generation cancelled";
+                return;
             }
+            this->pythonErrors = getPythonError();
+            return;
         }
 
-        for (int i = 0; i < unpacked.connections.size(); ++i) {
+        emit progress(90);
 
-            // transfer connection
-            this->connection_target->setData(i, 0, unpacked.connections[i].src);
-            this->connection_target->setData(i, 1, unpacked.connections[i].dst);
-            if (unpacked.connections[0].metric != NO_DELAY) {
-                this->connection_target->setData(i, 2, unpacked.connections[i].metric);
+        // stream the output into C++ forms
+        bool streamed = streamOutput(output, this->hasDelay, this->hasWeight, sink, numConns, numWeights, numCols, &this->cancelRequested);
+        Py_DECREF(output);
+
+        if (!streamed) {
+            sink->end();
+            cacheSink.remove();
+            if (this->cancelRequested || PyErr_ExceptionMatches(PyExc_KeyboardInterrupt)) {
+                PyErr_Clear();
+                this->pythonErrors = "Connection generation cancelled";
+            } else {
+                this->pythonErrors = getPythonError();
             }
-            this->connection_target->setNumRows(i);
+            return;
         }
+    }
 
-        this->connection_target->setNumRows(unpacked.connections.size());
+    // weights are only used if every connection had one
+    if (numWeights != numConns) {
+        this->weights.clear();
+    }
+    if (numConns == 0) {
+        this->weights.push_back(-234.56);
+    }
 
+    if (!useCache) {
+        sink->end();
+    } else if (sink->end()) {
+        this->saveCacheInfo(cacheKey, numConns, numCols, this->weights);
     } else {
-        this->connections = unpacked.connections;
-        (*this->conns) = unpacked.connections;
+        qDebug() << "Could not write connectivity cache entry" << cacheKey;
+        cacheSink.remove();
     }
 
-    // transfer the unpacked output to the local storage location for weights
-    this->weights = unpacked.weights;
+    emit progress(100);
 
     // if we get to the end then that's good enough
     this->scriptValidates = true;
+    this->lastGeneratedCacheKey = cacheKey;
     this->setUnchanged(true);
 }
 
+QString pythonscript_connection::getCacheKey()
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+
+    stream << this->scriptText;
+    stream << this->parNames << this->parValues;
+    stream << this->weightProp;
+    stream << (qint32) this->src->numNeurons << (qint32) this->dst->numNeurons;
+    hash.addData(data);
+
+    this->src->layoutType->addToHash(hash);
+    this->dst->layoutType->addToHash(hash);
+
+    return QString(hash.result().toHex());
+}
+
+/*!
+ * \brief pythonscript_connection::loadFromCache
+ * \param key
+ * \return true if connectivity for the key was found and loaded
+ *
+ * The cache holds two files per key: a .bin file of packed connections (int src, int dst
+ * and optionally a float delay, as in the exported binary files) and a .info file with the
+ * number of connections, the number of columns and the weights
+ */
+bool pythonscript_connection::loadFromCache(QString key)
+{
+    QDir cache_dir = getConnectivityCacheDir();
+
+    QFile infoFile(cache_dir.absoluteFilePath(key + ".info"));
+    QFile binFile(cache_dir.absoluteFilePath(key + ".bin"));
+
+    if (!infoFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    if (!binFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream info(&infoFile);
+    qint32 numConns;
+    qint32 numCols;
+    QVector <double> cachedWeights;
+    info >> numConns >> numCols >> cachedWeights;
+
+    // reject truncated or corrupt entries
+    qint64 rowSize = 2*sizeof(int) + (numCols == 3 ? sizeof(float) : 0);
+    if (info.status() != QDataStream::Ok || numConns < 0 || binFile.size() != rowSize*numConns) {
+        qDebug() << "Discarding bad connectivity cache entry" << key;
+        infoFile.remove();
+        binFile.remove();
+        return false;
+    }
+
+    if (this->generatedList != NULL) {
+
+        this->generatedList->clearData();
+        this->generatedList->setNumCols(numCols);
+        this->generatedList->setNumRows(numConns);
+        this->generatedList->import_packed_binary(binFile);
+
+    } else {
+
+        this->connections.clear();
+        this->connections.reserve(numConns);
+        for (int i = 0; i < numConns; ++i) {
+            conn newConn;
+            int srcVal, dstVal;
+            float delayVal = NO_DELAY;
+            binFile.read((char *) &srcVal,sizeof(int));
+            binFile.read((char *) &dstVal,sizeof(int));
+            if (numCols == 3) {
+                binFile.read((char *) &delayVal,sizeof(float));
+            }
+            newConn.src = srcVal;
+            newConn.dst = dstVal;
+            newConn.metric = delayVal;
+            this->connections.push_back(newConn);
+        }
+    }
+
+    this->weights = cachedWeights;
+
+    return true;
+}
+
+/*!
+ * \brief pythonscript_connection::saveCacheInfo
+ * Complete a cache entry once its .bin.part file has been written. Both files are written under
+ * temporary names and renamed into place, the .info last, so a crash or a second instance of the
+ * program never sees a partly written entry
+ */
+void pythonscript_connection::saveCacheInfo(QString key, int numConns, int numCols, QVector <double> &weightsToSave)
+{
+    QDir cache_dir = getConnectivityCacheDir();
+
+    QString binName = cache_dir.absoluteFilePath(key + ".bin");
+    QString infoName = cache_dir.absoluteFilePath(key + ".info");
+
+    QFile infoFile(infoName + ".part");
+    if (!infoFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Could not write connectivity cache entry" << key;
+        QFile::remove(binName + ".part");
+        return;
+    }
+    QDataStream info(&infoFile);
+    info << (qint32) numConns << (qint32) numCols << weightsToSave;
+    infoFile.close();
+
+    // rename won't replace an existing file, and an old .info must not outlive its .bin
+    QFile::remove(infoName);
+    QFile::remove(binName);
+    if (info.status() != QDataStream::Ok || !QFile::rename(binName + ".part", binName) || !QFile::rename(infoName + ".part", infoName)) {
+        qDebug() << "Could not write connectivity cache entry" << key;
+        QFile::remove(binName + ".part");
+        QFile::remove(infoName + ".part");
+        QFile::remove(binName);
+        return;
+    }
+
+    // keep the cache bounded by removing the oldest entries
+    QFileInfoList entries = cache_dir.entryInfoList(QStringList() << "*.bin", QDir::Files, QDir::Time);
+    qint64 totalSize = 0;
+    for (int i = 0; i < entries.size(); ++i) {
+        totalSize += entries[i].size();
+        if (totalSize > MAX_CONNECTIVITY_CACHE_SIZE && entries[i].baseName() != key) {
+            QFile::remove(entries[i].absoluteFilePath());
+            QFile::remove(cache_dir.absoluteFilePath(entries[i].baseName() + ".info"));
+        }
+    }
+}
+
+void pythonscript_connection::interruptGeneration()
+{
+    this->cancelRequested = true;
+
+    // the thread id is only set while a script holds the GIL, so check it with the GIL held
+    PyGILState_STATE state = PyGILState_Ensure();
+    if (this->pyThreadId != 0) {
+        PyThreadState_SetAsyncExc(this->pyThreadId, PyExc_KeyboardInterrupt);
+    }
+    PyGILState_Release(state);
+}
+
+bool pythonscript_connection::generationCancelled()
+{
+    return this->cancelRequested;
+}
+
+void pythonscript_connection::resetCancel()
+{
+    this->cancelRequested = false;
+}
+
 bool pythonscript_connection::isList()
 {
     return this->isAList;
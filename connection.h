@@ -31,7 +31,23 @@
 #include "nineML_classes.h"
 #include "population.h"
 
+class connectionSink;
+
 #define NO_DELAY -1 // used to determine if Python Scripts have delay data
+#define MAX_CONNECTIVITY_CACHE_SIZE 1073741824 // bytes of generated connectivity kept on disk (1GB)
+#define KERNEL_EXPORT_BOXES_PER_SIGMA 4 // resolution of the tables analytic kernels are exported as
+#define KERNEL_MAX_SIZE 99 // largest kernel table that can be picked, or that analytic kernels are exported as
+
+/*!
+ * \brief The kernelType enum
+ * How a kernel_connection gets the connection probability for an offset: from a table of
+ * values, or analytically from a separable or a radially symmetric Gaussian
+ */
+enum kernelType {
+    KernelTable,
+    KernelSeparable,
+    KernelRadial
+};
 
 struct change {
     int row;
@@ -147,6 +163,9 @@ public:
     void import_packed_binary(QFile &fileIn);
     QVector <float> fetchData(int index);
     void getAllData(QVector < conn > &conns);
+    bool streamAllData(connectionSink * sink);
+    void appendData(const conn * chunk, int count);
+    void takeData(csv_connection * other);
     float getData(int, int);
     float getData(QModelIndex &index);
     QString getHeader(int section);
@@ -190,11 +209,41 @@ public:
 
     void write_node_xml(QXmlStreamWriter &xmlOut);
     void import_parameters_from_xml(QDomNode &);
+    void write_metadata_xml(QDomDocument &, QDomNode &);
+    void read_metadata_xml(QDomNode &);
 
-    float kernel[11][11];
+    // table of probabilities, kernel_size x kernel_size stored by row
+    QVector <float> kernel;
     int kernel_size;
     float kernel_scale;
     float rotation;
+
+    // analytic kernels - p = amplitude * exp(-x^2/2sigma_x^2 - y^2/2sigma_y^2), which is zero
+    // beyond cutoff standard deviations. Radial kernels use sigma_x in both directions
+    kernelType kernel_type;
+    float kernel_amplitude;
+    float kernel_sigma_x;
+    float kernel_sigma_y;
+    float kernel_cutoff;
+
+    float getKernel(int i, int j);
+    /*!
+     * \brief getProbability
+     * The probability of a connection for an offset from the source, in the (rotated)
+     * coordinates of the kernel
+     */
+    float getProbability(float x, float y);
+    /*!
+     * \brief inKernel
+     * True if an offset from the source is covered by the kernel, even where it is zero
+     */
+    bool inKernel(float x, float y);
+    /*!
+     * \brief getExtent
+     * The largest distance from the source at which the kernel can be non-zero
+     */
+    float getExtent();
+    void tableForExport(int &size, float &scale);
     QString errorLog;
 
     QSharedPointer <population> src;
@@ -220,6 +269,11 @@ public slots:
     void setKernelSize(int);
     void setKernelScale(float);
     void setKernel(int,int,float);
+    void setKernelType(int);
+    void setKernelAmplitude(float);
+    void setKernelSigmaX(float);
+    void setKernelSigmaY(float);
+    void setKernelCutoff(float);
 
 signals:
     void progress(int);
@@ -275,6 +329,67 @@ public:
     QStringList getPropList();
     QLayout * drawLayout(rootData * data, viewVZLayoutEditHandler * viewVZhandler, rootLayout * rootLay);
 
+    /*!
+     * \brief interruptGeneration
+     * Stop a script that is being run by generate_connections on another thread, by raising a
+     * KeyboardInterrupt in the interpreter. Safe to call from any thread.
+     */
+    void interruptGeneration();
+    bool generationCancelled();
+    void resetCancel();
+
+    /*!
+     * \brief cacheEnabled
+     * Whether generated connectivity is reused from, and saved to, the connectivity cache
+     * (the "fileOptions/cacheConnectivity" setting)
+     */
+    static bool cacheEnabled();
+    /*!
+     * \brief clearCache
+     * Remove every entry in the connectivity cache
+     */
+    static void clearCache();
+
+    /*!
+     * \brief prepareGeneration
+     * Regenerate the src and dst layouts and snapshot them - on the GUI thread, before the
+     * generation is queued
+     * \return false if a layout couldn't be generated, with the reason in pythonErrors
+     */
+    bool prepareGeneration();
+    /*!
+     * \brief snapshotLayouts
+     * Copy the current src and dst locations, and the cache key they give, for generateFromLayouts
+     */
+    void snapshotLayouts();
+    /*!
+     * \brief generateFromLayouts
+     * Generate the connections from the snapshot of the src and dst locations
+     */
+    void generateFromLayouts();
+    /*!
+     * \brief finishGeneration
+     * Hand the generated connections over to the caller's list - on the GUI thread, once
+     * generateFromLayouts has returned
+     */
+    void finishGeneration();
+    /*!
+     * \brief refreshScriptText
+     * Fetch the current version of the script from the settings
+     */
+    void refreshScriptText();
+    /*!
+     * \brief applyWeights
+     * Copy the generated weights into the weight property as an explicit list
+     */
+    void applyWeights();
+    /*!
+     * \brief layoutsChanged
+     * True if anything the connectivity depends on, including the src and dst layouts,
+     * differs from when it was last generated
+     */
+    bool layoutsChanged();
+
     // the explicit connection list to copy the generated weights to
     csv_connection * connection_target;
 
@@ -286,6 +401,29 @@ private:
     int srcSize;
     int dstSize;
 
+    // cancellation state for background generation
+    volatile bool cancelRequested;
+    long pyThreadId;
+
+    // what generateFromLayouts works from, so it doesn't read the populations
+    QVector <loc> srcLocations;
+    QVector <loc> dstLocations;
+    QString generationCacheKey;
+    // generateFromLayouts stores connections for connection_target here, finishGeneration moves them across
+    csv_connection * generatedList;
+
+    /*!
+     * \brief getCacheKey
+     * A hash of everything the generated connectivity depends on: the script, its parameters,
+     * the weight property and the src and dst layouts and sizes
+     */
+    QString getCacheKey();
+    QString lastGeneratedCacheKey;
+    // set for projects saved without lastGeneratedCacheKey
+    bool adoptCacheKey;
+    bool loadFromCache(QString key);
+    void saveCacheInfo(QString key, int numConns, int numCols, QVector <double> &weightsToSave);
+
 
 public slots:
     void generate_connections();
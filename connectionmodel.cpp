@@ -157,3 +157,50 @@ csv_connectionModel::csv_connectionModel(QObject *parent) :
      return true;
 
  }
+
+kernel_connectionModel::kernel_connectionModel(kernel_connection * currConn, QObject *parent) :
+    QAbstractTableModel(parent)
+{
+    this->currentConnection = currConn;
+}
+
+int kernel_connectionModel::rowCount(const QModelIndex & /*parent*/) const
+{
+    return this->currentConnection->kernel_size;
+}
+
+int kernel_connectionModel::columnCount(const QModelIndex & /*parent*/) const
+{
+    return this->currentConnection->kernel_size;
+}
+
+QVariant kernel_connectionModel::data(const QModelIndex &index, int role) const
+{
+    if (role == Qt::DisplayRole || role == Qt::EditRole) {
+        return this->currentConnection->getKernel(index.row(), index.column());
+    }
+    return QVariant();
+}
+
+bool kernel_connectionModel::setData(const QModelIndex & index, const QVariant & value, int role)
+{
+    if (role != Qt::EditRole) {
+        return false;
+    }
+
+    // the values are probabilities
+    bool ok;
+    float probability = value.toFloat(&ok);
+    if (!ok) {
+        return false;
+    }
+    this->currentConnection->setKernel(index.row(), index.column(), qBound(0.0f, probability, 1.0f));
+
+    emit dataChanged(index, index);
+    return true;
+}
+
+Qt::ItemFlags kernel_connectionModel::flags(const QModelIndex & /*index*/) const
+{
+    return Qt::ItemIsSelectable | Qt::ItemIsEditable | Qt::ItemIsEnabled;
+}
@@ -57,4 +57,23 @@ public slots:
     
 };
 
+/*!
+ * \brief The kernel_connectionModel class
+ * The table of a kernel connection, so it can be edited in a view at any size
+ */
+class kernel_connectionModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    explicit kernel_connectionModel(kernel_connection * currConn, QObject *parent = 0);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const ;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    bool setData(const QModelIndex & index, const QVariant & value, int role);
+    Qt::ItemFlags flags(const QModelIndex & /*index*/) const;
+
+private:
+    kernel_connection * currentConnection;
+};
+
 #endif // CONNECTIONMODEL_H
@@ -0,0 +1,244 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "connectionsink.h"
+#include "connection.h"
+
+connectionVectorSink::connectionVectorSink(QVector < conn > * target, QMutex * mutex)
+{
+    this->target = target;
+    this->mutex = mutex;
+}
+
+bool connectionVectorSink::begin(int)
+{
+    return true;
+}
+
+void connectionVectorSink::write(const conn * chunk, int count)
+{
+    if (this->mutex) {
+        this->mutex->lock();
+    }
+    for (int i = 0; i < count; ++i) {
+        this->target->push_back(chunk[i]);
+    }
+    if (this->mutex) {
+        this->mutex->unlock();
+    }
+}
+
+bool connectionVectorSink::end()
+{
+    return true;
+}
+
+weightVectorSink::weightVectorSink(QVector <double> * target)
+{
+    this->target = target;
+}
+
+bool weightVectorSink::begin(int)
+{
+    return true;
+}
+
+void weightVectorSink::writeWeights(const double * chunk, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        this->target->push_back(chunk[i]);
+    }
+}
+
+bool weightVectorSink::end()
+{
+    return true;
+}
+
+packedBinarySink::packedBinarySink(QString fileName)
+{
+    this->file.setFileName(fileName);
+    this->numCols = 2;
+    this->failed = false;
+}
+
+bool packedBinarySink::begin(int numCols)
+{
+    this->numCols = numCols;
+    if (!this->file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        this->failed = true;
+        return false;
+    }
+    return true;
+}
+
+void packedBinarySink::write(const conn * chunk, int count)
+{
+    if (this->failed) {
+        return;
+    }
+
+    // pack the chunk so it goes out in a single write
+    int rowSize = 2*sizeof(int) + (this->numCols == 3 ? sizeof(float) : 0);
+    QByteArray packed;
+    packed.resize(rowSize*count);
+    char * out = packed.data();
+    for (int i = 0; i < count; ++i) {
+        memcpy(out, &chunk[i].src, sizeof(int));
+        out += sizeof(int);
+        memcpy(out, &chunk[i].dst, sizeof(int));
+        out += sizeof(int);
+        if (this->numCols == 3) {
+            memcpy(out, &chunk[i].metric, sizeof(float));
+            out += sizeof(float);
+        }
+    }
+
+    if (this->file.write(packed) != packed.size()) {
+        this->failed = true;
+    }
+}
+
+bool packedBinarySink::end()
+{
+    if (this->file.isOpen()) {
+        this->file.close();
+    }
+    return !this->failed;
+}
+
+void packedBinarySink::remove()
+{
+    this->file.remove();
+}
+
+csvStorageSink::csvStorageSink(csv_connection * target)
+{
+    this->target = target;
+    this->numRows = 0;
+}
+
+bool csvStorageSink::begin(int numCols)
+{
+    this->target->clearData();
+    this->target->setNumCols(numCols);
+    this->target->setNumRows(0);
+    this->numRows = 0;
+    return true;
+}
+
+void csvStorageSink::write(const conn * chunk, int count)
+{
+    this->target->appendData(chunk, count);
+    this->numRows += count;
+}
+
+bool csvStorageSink::end()
+{
+    this->target->setNumRows(this->numRows);
+    return true;
+}
+
+connectionTeeSink::connectionTeeSink(connectionSink * first, connectionSink * second)
+{
+    this->first = first;
+    this->second = second;
+}
+
+bool connectionTeeSink::begin(int numCols)
+{
+    bool firstOk = this->first->begin(numCols);
+    bool secondOk = this->second->begin(numCols);
+    return firstOk && secondOk;
+}
+
+void connectionTeeSink::write(const conn * chunk, int count)
+{
+    this->first->write(chunk, count);
+    this->second->write(chunk, count);
+}
+
+void connectionTeeSink::writeWeights(const double * chunk, int count)
+{
+    this->first->writeWeights(chunk, count);
+    this->second->writeWeights(chunk, count);
+}
+
+bool connectionTeeSink::end()
+{
+    bool firstOk = this->first->end();
+    bool secondOk = this->second->end();
+    return firstOk && secondOk;
+}
+
+connectionChunkWriter::connectionChunkWriter(connectionSink * sink)
+{
+    this->sink = sink;
+    this->chunk.reserve(CONNECTION_SINK_CHUNK);
+    this->total = 0;
+    this->weightTotal = 0;
+}
+
+void connectionChunkWriter::add(const conn &newConn)
+{
+    if (this->isFull()) {
+        this->flush();
+    }
+    this->chunk.push_back(newConn);
+    ++this->total;
+}
+
+void connectionChunkWriter::add(const conn &newConn, double weight)
+{
+    this->add(newConn);
+    this->weightChunk.push_back(weight);
+    ++this->weightTotal;
+}
+
+bool connectionChunkWriter::isFull()
+{
+    return this->chunk.size() == CONNECTION_SINK_CHUNK;
+}
+
+void connectionChunkWriter::flush()
+{
+    if (this->chunk.size() > 0) {
+        this->sink->write(this->chunk.constData(), this->chunk.size());
+        this->chunk.resize(0);
+    }
+    if (this->weightChunk.size() > 0) {
+        this->sink->writeWeights(this->weightChunk.constData(), this->weightChunk.size());
+        this->weightChunk.resize(0);
+    }
+}
+
+int connectionChunkWriter::count()
+{
+    return this->total;
+}
+
+int connectionChunkWriter::weightCount()
+{
+    return this->weightTotal;
+}
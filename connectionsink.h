@@ -0,0 +1,176 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef CONNECTIONSINK_H
+#define CONNECTIONSINK_H
+
+#include "globalHeader.h"
+
+// number of connections gathered before they are passed on to a sink
+#define CONNECTION_SINK_CHUNK 65536
+
+/*!
+ * \brief The connectionSink class
+ * Somewhere that generated connections can be written to as they are produced, a chunk at a
+ * time, so that generators never need to hold the whole connection list in memory.
+ */
+class connectionSink
+{
+public:
+    virtual ~connectionSink() {}
+    /*!
+     * \brief begin
+     * \param numCols 2 for (src, dst), 3 for (src, dst, delay)
+     * Called once before any connections are written
+     */
+    virtual bool begin(int numCols) = 0;
+    virtual void write(const conn * chunk, int count) = 0;
+    /*!
+     * \brief writeWeights
+     * The weights that came with the connections, if any, a chunk at a time. Sinks that don't
+     * store weights ignore them
+     */
+    virtual void writeWeights(const double *, int) {}
+    /*!
+     * \brief end
+     * Called once after the last chunk. Returns false if anything failed to write
+     */
+    virtual bool end() = 0;
+};
+
+/*!
+ * \brief The connectionVectorSink class
+ * Collects the connections in a vector, optionally locking a mutex around each chunk so the
+ * vector can be read by another thread while it fills
+ */
+class connectionVectorSink : public connectionSink
+{
+public:
+    connectionVectorSink(QVector < conn > * target, QMutex * mutex = NULL);
+    bool begin(int numCols);
+    void write(const conn * chunk, int count);
+    bool end();
+
+private:
+    QVector < conn > * target;
+    QMutex * mutex;
+};
+
+/*!
+ * \brief The weightVectorSink class
+ * Collects only the weights that come with the connections
+ */
+class weightVectorSink : public connectionSink
+{
+public:
+    weightVectorSink(QVector <double> * target);
+    bool begin(int numCols);
+    void write(const conn *, int) {}
+    void writeWeights(const double * chunk, int count);
+    bool end();
+
+private:
+    QVector <double> * target;
+};
+
+/*!
+ * \brief The packedBinarySink class
+ * Writes the connections to a file in the packed binary format (int src)(int dst)(opt float delay)
+ * used for the exported connection lists
+ */
+class packedBinarySink : public connectionSink
+{
+public:
+    packedBinarySink(QString fileName);
+    bool begin(int numCols);
+    void write(const conn * chunk, int count);
+    bool end();
+    void remove();
+
+private:
+    QFile file;
+    int numCols;
+    bool failed;
+};
+
+/*!
+ * \brief The csvStorageSink class
+ * Replaces the contents of an explicit connection list's storage file
+ */
+class csvStorageSink : public connectionSink
+{
+public:
+    csvStorageSink(csv_connection * target);
+    bool begin(int numCols);
+    void write(const conn * chunk, int count);
+    bool end();
+
+private:
+    csv_connection * target;
+    int numRows;
+};
+
+/*!
+ * \brief The connectionTeeSink class
+ * Passes every chunk on to two sinks
+ */
+class connectionTeeSink : public connectionSink
+{
+public:
+    connectionTeeSink(connectionSink * first, connectionSink * second);
+    bool begin(int numCols);
+    void write(const conn * chunk, int count);
+    void writeWeights(const double * chunk, int count);
+    bool end();
+
+private:
+    connectionSink * first;
+    connectionSink * second;
+};
+
+/*!
+ * \brief The connectionChunkWriter class
+ * Gathers connections, and optionally their weights, one at a time and hands them to a sink in
+ * chunks. A full chunk is passed on by the next add(), or earlier by the caller with flush()
+ */
+class connectionChunkWriter
+{
+public:
+    connectionChunkWriter(connectionSink * sink);
+    void add(const conn &newConn);
+    void add(const conn &newConn, double weight);
+    bool isFull();
+    void flush();
+    int count();
+    int weightCount();
+
+private:
+    connectionSink * sink;
+    QVector < conn > chunk;
+    QVector < double > weightChunk;
+    int total;
+    int weightTotal;
+};
+
+#endif // CONNECTIONSINK_H
@@ -0,0 +1,271 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "connectivityregenerator.h"
+#include "connection.h"
+#include "population.h"
+#include "projections.h"
+#include "genericinput.h"
+#include "nineml_layout_classes.h"
+#include "pythongeneratorqueue.h"
+#include <QThreadPool>
+#include <QEventLoop>
+#include <QProgressDialog>
+
+connectivityLayoutJob::connectivityLayoutJob(population * pop, int index, connectivityRegenerator * owner)
+{
+    this->pop = pop;
+    this->index = index;
+    this->owner = owner;
+}
+
+void connectivityLayoutJob::run()
+{
+    QVector <loc> locations;
+    QString errorLog;
+    if (!this->isCancelled()) {
+        this->pop->layoutType->generateLayout(this->pop->numNeurons, &locations, errorLog, this);
+    }
+    QMetaObject::invokeMethod(this->owner, "layoutFinished", Qt::QueuedConnection, Q_ARG(int, this->index), Q_ARG(QVector <loc>, locations), Q_ARG(QString, errorLog));
+}
+
+bool connectivityLayoutJob::isCancelled()
+{
+    return this->owner->cancelled;
+}
+
+connectivityJob::connectivityJob(pythonscript_connection * conn, connectivityRegenerator * owner)
+{
+    this->conn = conn;
+    this->owner = owner;
+}
+
+void connectivityJob::run()
+{
+    this->conn->generateFromLayouts();
+    QMetaObject::invokeMethod(this->owner, "jobFinished", Qt::QueuedConnection, Q_ARG(pythonscript_connection *, this->conn));
+}
+
+connectivityRegenerator::connectivityRegenerator(QObject *parent) :
+    QObject(parent)
+{
+    this->numRunning = 0;
+    this->numFinished = 0;
+    this->progressBase = 0;
+    this->cancelled = false;
+    qRegisterMetaType<pythonscript_connection *>("pythonscript_connection*");
+    qRegisterMetaType < QVector <loc> > ("QVector<loc>");
+}
+
+void connectivityRegenerator::addNetwork(QVector < QSharedPointer <population> > &network)
+{
+    for (int i = 0; i < network.size(); ++i) {
+        QSharedPointer <population> pop = network[i];
+        this->addInputs(pop->neuronType);
+        for (int j = 0; j < pop->projections.size(); ++j) {
+            QSharedPointer <projection> proj = pop->projections[j];
+            for (int k = 0; k < proj->synapses.size(); ++k) {
+                QSharedPointer <synapse> syn = proj->synapses[k];
+                this->addConnection(syn->connectionType);
+                this->addInputs(syn->weightUpdateType);
+                this->addInputs(syn->postsynapseType);
+            }
+        }
+    }
+}
+
+void connectivityRegenerator::addInputs(QSharedPointer <NineMLComponentData> component)
+{
+    if (component.isNull()) {
+        return;
+    }
+    for (int i = 0; i < component->inputs.size(); ++i) {
+        this->addConnection(component->inputs[i]->connectionType);
+    }
+}
+
+void connectivityRegenerator::addConnection(connection * conn)
+{
+    if (conn == NULL || conn->type != CSV) {
+        return;
+    }
+
+    csv_connection * csvConn = dynamic_cast<csv_connection *> (conn);
+    CHECK_CAST(csvConn)
+    if (!csvConn->generator) {
+        return;
+    }
+
+    pythonscript_connection * pyConn = dynamic_cast<pythonscript_connection *> (csvConn->generator);
+    CHECK_CAST(pyConn)
+
+    // already being generated in the background
+    if (pythonGeneratorQueue::instance()->isPending(pyConn)) {
+        return;
+    }
+
+    pyConn->refreshScriptText();
+
+    if (!this->jobs.contains(pyConn) && (pyConn->changed() || pyConn->layoutsChanged())) {
+        this->jobs.push_back(pyConn);
+    }
+}
+
+int connectivityRegenerator::numStale()
+{
+    return this->jobs.size();
+}
+
+bool connectivityRegenerator::run()
+{
+    if (this->jobs.isEmpty()) {
+        return true;
+    }
+
+    // find the populations whose layouts are needed - each is generated once however many
+    // projections use it
+    this->pops.clear();
+    this->badPops.clear();
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        if (!this->pops.contains(this->jobs[i]->src.data())) {
+            this->pops.push_back(this->jobs[i]->src.data());
+        }
+        if (!this->pops.contains(this->jobs[i]->dst.data())) {
+            this->pops.push_back(this->jobs[i]->dst.data());
+        }
+    }
+
+    QProgressDialog progress("Regenerating connectivity...", "Cancel", 0, this->pops.size() + this->jobs.size());
+    progress.setWindowModality(Qt::ApplicationModal);
+    progress.setMinimumDuration(500);
+    progress.setValue(0);
+    connect(this, SIGNAL(jobsDone(int)), &progress, SLOT(setValue(int)));
+    connect(&progress, SIGNAL(canceled()), this, SLOT(cancel()));
+
+    QEventLoop loop;
+    connect(this, SIGNAL(allDone()), &loop, SLOT(quit()));
+
+    // generate the layouts concurrently - they are put in place as they come back
+    progress.setLabelText("Generating layouts for " + QString::number(this->pops.size()) + " population(s)...");
+    this->numRunning = this->pops.size();
+    this->numFinished = 0;
+    this->progressBase = 0;
+    for (int i = 0; i < this->pops.size(); ++i) {
+        QThreadPool::globalInstance()->start(new connectivityLayoutJob(this->pops[i], i, this));
+    }
+    loop.exec();
+
+    if (this->cancelled) {
+        return false;
+    }
+
+    // now run the scripts
+    progress.setLabelText("Running connectivity scripts for " + QString::number(this->jobs.size()) + " projection(s)...");
+
+    this->numRunning = 0;
+    this->numFinished = 0;
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        if (this->badPops.contains(this->jobs[i]->src.data()) || this->badPops.contains(this->jobs[i]->dst.data())) {
+            continue;
+        }
+        this->jobs[i]->resetCancel();
+        this->jobs[i]->snapshotLayouts();
+        ++this->numRunning;
+        QThreadPool::globalInstance()->start(new connectivityJob(this->jobs[i], this));
+    }
+    this->progressBase = this->pops.size() + this->jobs.size() - this->numRunning;
+    progress.setValue(this->progressBase);
+
+    // the jobs report back through the event loop, so this waits for all of them
+    if (this->numRunning > 0) {
+        loop.exec();
+    }
+
+    // don't leave a cancel pending for the next time these are generated
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        this->jobs[i]->resetCancel();
+    }
+
+    if (this->cancelled) {
+        return false;
+    }
+
+    if (!this->errors.isEmpty()) {
+        QMessageBox msgBox;
+        msgBox.setText("Errors were found while regenerating connectivity");
+        msgBox.setDetailedText(this->errors.join("\n"));
+        msgBox.exec();
+    }
+
+    return true;
+}
+
+void connectivityRegenerator::layoutFinished(int index, QVector <loc> locations, QString errorLog)
+{
+    population * pop = this->pops[index];
+    if (!errorLog.isEmpty()) {
+        if (!this->cancelled) {
+            this->errors.push_back(pop->getName() + ": " + errorLog);
+        }
+        this->badPops.push_back(pop);
+    } else if (!this->cancelled) {
+        pop->layoutType->locations = locations;
+    }
+
+    --this->numRunning;
+    ++this->numFinished;
+    emit jobsDone(this->progressBase + this->numFinished);
+
+    if (this->numRunning == 0) {
+        emit allDone();
+    }
+}
+
+void connectivityRegenerator::jobFinished(pythonscript_connection * conn)
+{
+    if (!conn->pythonErrors.isEmpty()) {
+        if (!this->cancelled) {
+            this->errors.push_back(conn->src->getName() + " to " + conn->dst->getName() + ": " + conn->pythonErrors);
+        }
+    } else {
+        conn->finishGeneration();
+        conn->applyWeights();
+    }
+
+    --this->numRunning;
+    ++this->numFinished;
+    emit jobsDone(this->progressBase + this->numFinished);
+
+    if (this->numRunning == 0) {
+        emit allDone();
+    }
+}
+
+void connectivityRegenerator::cancel()
+{
+    this->cancelled = true;
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        this->jobs[i]->interruptGeneration();
+    }
+}
@@ -0,0 +1,117 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef CONNECTIVITYREGENERATOR_H
+#define CONNECTIVITYREGENERATOR_H
+
+#include "globalHeader.h"
+#include "nineml_layout_classes.h"
+#include <QRunnable>
+
+class connectivityRegenerator;
+
+/*!
+ * \brief The connectivityLayoutJob class
+ * Generates the layout of one population on the thread pool and passes it back to the
+ * regenerator, which puts it in place on the GUI thread.
+ */
+class connectivityLayoutJob : public QRunnable, public layoutProgress
+{
+public:
+    connectivityLayoutJob(population * pop, int index, connectivityRegenerator * owner);
+    void run();
+    bool isCancelled();
+    void partialLayout(const QVector <loc> &) {}
+
+private:
+    population * pop;
+    int index;
+    connectivityRegenerator * owner;
+};
+
+/*!
+ * \brief The connectivityJob class
+ * Runs one connection script on the thread pool, against layouts that have already been
+ * generated, and tells the regenerator when it is done.
+ */
+class connectivityJob : public QRunnable
+{
+public:
+    connectivityJob(pythonscript_connection * conn, connectivityRegenerator * owner);
+    void run();
+
+private:
+    pythonscript_connection * conn;
+    connectivityRegenerator * owner;
+};
+
+/*!
+ * \brief The connectivityRegenerator class
+ * Finds every generated projection in a network whose connectivity is out of date, either
+ * because the script and its parameters have changed or because a layout it depends on has,
+ * and brings them all up to date before the network is written. The layouts of the affected
+ * populations are regenerated once each, then the scripts are run, both as jobs on the global
+ * thread pool behind a progress dialog. The scripts share the GIL, so only the C++ side of
+ * each - storing and caching the connections - overlaps with the others.
+ */
+class connectivityRegenerator : public QObject
+{
+    Q_OBJECT
+public:
+    explicit connectivityRegenerator(QObject *parent = 0);
+
+    void addNetwork(QVector < QSharedPointer <population> > &network);
+    int numStale();
+    /*!
+     * \brief run
+     * \return false if the user cancelled
+     */
+    bool run();
+
+private:
+    void addConnection(connection * conn);
+    void addInputs(QSharedPointer <NineMLComponentData> component);
+
+    friend class connectivityLayoutJob;
+
+    QVector < pythonscript_connection * > jobs;
+    QVector < population * > pops;
+    QVector < population * > badPops;
+    QStringList errors;
+    int numRunning;
+    int numFinished;
+    int progressBase;
+    volatile bool cancelled;
+
+public slots:
+    void layoutFinished(int index, QVector <loc> locations, QString errorLog);
+    void jobFinished(pythonscript_connection *);
+    void cancel();
+
+signals:
+    void allDone();
+    void jobsDone(int);
+};
+
+#endif // CONNECTIVITYREGENERATOR_H
@@ -25,6 +25,7 @@
 #include "editsimulators.h"
 #include "ui_editsimulators.h"
 #include "QSettings"
+#include "connection.h"
 
 editSimulators::editSimulators(QWidget *parent) :
     QDialog(parent),
@@ -89,6 +90,11 @@ editSimulators::editSimulators(QWidget *parent) :
     ui->dev_mode_check->setChecked(devMode);
     connect(ui->dev_mode_check, SIGNAL(toggled(bool)), this, SLOT(setDevMode(bool)));
 
+    // reuse of generated connectivity
+    ui->cache_connectivity->setChecked(pythonscript_connection::cacheEnabled());
+    connect(ui->cache_connectivity, SIGNAL(toggled(bool)), this, SLOT(setCacheConnectivity(bool)));
+    connect(ui->clear_cache, SIGNAL(clicked()), this, SLOT(clearConnectivityCache()));
+
     // populate script list
     this->ui->scriptList->setSelectionMode(QAbstractItemView::SingleSelection);
     settings.beginGroup("pythonscripts");
@@ -284,6 +290,17 @@ void editSimulators::setDevMode(bool toggle)
     settings.setValue("dev_mode_on", toggle);
 }
 
+void editSimulators::setCacheConnectivity(bool toggle)
+{
+    QSettings settings;
+    settings.setValue("fileOptions/cacheConnectivity", toggle);
+}
+
+void editSimulators::clearConnectivityCache()
+{
+    pythonscript_connection::clearCache();
+}
+
 void editSimulators::addEnvVar()
 {
     keys.push_back("newVariable");
@@ -80,6 +80,8 @@ public slots:
     void saveAsBinaryToggled(bool);
     void setGLDetailLevel(int);
     void setDevMode(bool);
+    void setCacheConnectivity(bool);
+    void clearConnectivityCache();
     void close();
     void scriptSelectionChanged(QListWidgetItem *current, QListWidgetItem *previous);
     void addScript();
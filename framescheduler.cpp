@@ -0,0 +1,123 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "framescheduler.h"
+#include <algorithm>
+
+frameScheduler::frameScheduler(QWidget * target) : QObject(target)
+{
+    this->target = target;
+    logging = false;
+    frames = 0;
+    coalesced = 0;
+    setMaxFrameRate(60);
+
+    timer.setSingleShot(true);
+    connect(&timer, SIGNAL(timeout()), this, SLOT(drawPending()));
+}
+
+void frameScheduler::setMaxFrameRate(int fps) {
+
+    if (fps < 1)
+        fps = 1;
+    minInterval = 1000 / fps;
+
+}
+
+bool frameScheduler::beginFrame() {
+
+    if (sinceLastFrame.isValid() && sinceLastFrame.elapsed() < minInterval) {
+        // too soon - draw once at the end of the interval instead
+        if (!timer.isActive())
+            timer.start(minInterval - sinceLastFrame.elapsed());
+        ++coalesced;
+        return false;
+    }
+
+    // this frame covers anything that was waiting
+    timer.stop();
+    sinceLastFrame.start();
+    frameClock.start();
+    return true;
+
+}
+
+void frameScheduler::endFrame() {
+
+    float time = float(frameClock.nsecsElapsed()) / 1000000.0f;
+
+    if (history.size() < FRAME_HISTORY_SIZE)
+        history.push_back(time);
+    else
+        history[frames % FRAME_HISTORY_SIZE] = time;
+    ++frames;
+
+    if (logging && frames % FRAME_HISTORY_SIZE == 0) {
+        qDebug() << "Frames:" << frames << "coalesced:" << coalesced << "mean ms:" << meanFrameTime() \
+                 << "median ms:" << percentile(50) << "95th percentile ms:" << percentile(95);
+    }
+
+}
+
+void frameScheduler::drawPending() {
+    target->update();
+}
+
+QVector <float> frameScheduler::frameTimes() const {
+    return history;
+}
+
+float frameScheduler::percentile(float p) const {
+
+    if (history.size() == 0)
+        return 0;
+
+    QVector <float> sorted = history;
+    std::sort(sorted.begin(), sorted.end());
+    int index = qRound(p / 100.0f * float(sorted.size() - 1));
+    if (index < 0) index = 0;
+    if (index >= sorted.size()) index = sorted.size() - 1;
+    return sorted[index];
+
+}
+
+float frameScheduler::meanFrameTime() const {
+
+    if (history.size() == 0)
+        return 0;
+
+    float total = 0;
+    for (int i = 0; i < history.size(); ++i)
+        total += history[i];
+    return total / float(history.size());
+
+}
+
+void frameScheduler::resetStatistics() {
+
+    history.clear();
+    frames = 0;
+    coalesced = 0;
+
+}
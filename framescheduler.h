@@ -0,0 +1,77 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include "globalHeader.h"
+#include <QElapsedTimer>
+
+// number of recent frames kept for timing statistics
+#define FRAME_HISTORY_SIZE 256
+
+/*!
+ * \brief The frameScheduler class
+ * Limits how often a widget is drawn. A paint that arrives too soon after the last frame is not
+ * drawn straight away, instead one frame is scheduled for the end of the interval - so any number
+ * of redraw requests in between are coalesced into a single frame that shows the latest state.
+ * It also times each frame, and keeps the times of recent frames for profiling.
+ *
+ * The widget calls beginFrame() at the start of painting and only draws if it returns true, then
+ * calls endFrame() when done.
+ */
+class frameScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit frameScheduler(QWidget * target);
+    void setMaxFrameRate(int fps);
+    void setLogging(bool on) {logging = on;}
+    bool beginFrame();
+    void endFrame();
+
+    // statistics of recent frames, in milliseconds
+    int frameCount() const {return frames;}
+    int coalescedCount() const {return coalesced;}
+    QVector <float> frameTimes() const;
+    float percentile(float p) const;
+    float meanFrameTime() const;
+    void resetStatistics();
+
+private slots:
+    void drawPending();
+
+private:
+    QWidget * target;
+    QTimer timer;
+    QElapsedTimer sinceLastFrame;
+    QElapsedTimer frameClock;
+    int minInterval;
+    bool logging;
+    QVector <float> history;
+    int frames;
+    int coalesced;
+};
+
+#endif // FRAMESCHEDULER_H
@@ -27,6 +27,7 @@
 #include "population.h"
 #include "connection.h"
 #include "glconnectionwidget.h"
+#include "pythongeneratorqueue.h"
 
 generate_dialog::generate_dialog(kernel_connection * currConn, QSharedPointer <population> src, QSharedPointer <population> dst, QVector < conn > &conns, QMutex * mutex, QWidget *parent) :
     QDialog(parent),
@@ -43,6 +44,7 @@ generate_dialog::generate_dialog(kernel_connection * currConn, QSharedPointer <p
     currConn->dst = dst;
     currConn->conns = &conns;
     currConn->mutex = mutex;
+    cancelling = false;
 
     workerThread = new QThread(this);
 
@@ -79,29 +81,72 @@ generate_dialog::generate_dialog(pythonscript_connection * currConn, QSharedPoin
     currConn->conns = &conns;
     currConn->mutex = mutex;
 
+    cancelling = false;
 
+    // progress from the script - this arrives from the worker thread
+    connect(currConn, SIGNAL(progress(int)), ui->progressBar, SLOT(setValue(int)));
+    ui->progressBar->setValue(0);
 
-    // get rid of the dialog if we are successful
-    QTimer * timer = new QTimer;
-    timer->setSingleShot(true);
-    connect(timer, SIGNAL(timeout()), this, SLOT(doPython()));
-    timer->start(100);
+    // run the script in the background so the GUI stays responsive
+    pythonGeneratorQueue * queue = pythonGeneratorQueue::instance();
+    connect(queue, SIGNAL(jobStarted(pythonscript_connection*)), this, SLOT(pythonStarted(pythonscript_connection*)));
+    connect(queue, SIGNAL(jobFinished(pythonscript_connection*,bool)), this, SLOT(pythonFinished(pythonscript_connection*,bool)));
 
+    int ahead = queue->numPending();
+    if (ahead > 0) {
+        ui->caption->setText("Waiting for " + QString::number(ahead) + " queued script(s)");
+    } else {
+        ui->caption->setText("Generating connections for script '" + currConn->scriptName + "'");
+    }
 
-    //workerThread = new QThread(this);
+    queue->enqueue(currConn);
 
-    //connect(workerThread, SIGNAL(started()), currConn, SLOT(generate_connections()));
-    //connect(workerThread, SIGNAL(finished()), this, SLOT(moveFromThread()));
-    //connect(currConn, SIGNAL(connectionsDone()), this, SLOT(moveFromThread()));
+}
 
-    //connect(currConn, SIGNAL(progress(int)), ui->progressBar, SLOT(setValue(int)));
-    //if (parent != NULL)
-    //    connect(currConn, SIGNAL(progress(int)), ((glConnectionWidget *)parent), SLOT(redraw()));
+void generate_dialog::pythonStarted(pythonscript_connection * job)
+{
+    if (job != currConn) {
+        return;
+    }
+    ui->caption->setText("Generating connections for script '" + job->scriptName + "'");
+}
+
+void generate_dialog::pythonFinished(pythonscript_connection * job, bool cancelled)
+{
+    // the queue is shared, so ignore other projections finishing
+    if (job != currConn) {
+        return;
+    }
 
-    //currConn->moveToThread(workerThread);
+    if (cancelled || cancelling) {
+        QDialog::reject();
+        return;
+    }
 
-    //workerThread->start();
+    this->doPython();
+}
 
+/*!
+ * \brief generate_dialog::reject
+ * For Python we cannot just close the dialog, as the script still writes into the caller's
+ * connection list - interrupt it and close once the worker reports it has stopped.
+ */
+void generate_dialog::reject()
+{
+    if (currConn->type == Python) {
+        pythonscript_connection * currConnPy = dynamic_cast <pythonscript_connection *> (currConn);
+        CHECK_CAST(currConnPy)
+        if (pythonGeneratorQueue::instance()->isPending(currConnPy)) {
+            if (!cancelling) {
+                cancelling = true;
+                ui->caption->setText("Cancelling...");
+                ui->buttonBox->setEnabled(false);
+                pythonGeneratorQueue::instance()->cancel(currConnPy);
+            }
+            return;
+        }
+    }
+    QDialog::reject();
 }
 
 void generate_dialog::doPython() {
@@ -109,23 +154,12 @@ void generate_dialog::doPython() {
     pythonscript_connection * currConnPy = dynamic_cast <pythonscript_connection *> (currConn);
     CHECK_CAST(currConnPy)
 
-    currConnPy->generate_connections();
-
     if (!currConnPy->errorLog.isEmpty()) {
         ui->errors->setText(currConnPy->errorLog);
     } else if (!currConnPy->pythonErrors.isEmpty()) {
         ui->errors->setText(currConnPy->pythonErrors);
     } else {
-        // move the weights across
-        ParameterData * par = currConnPy->getPropPointer();
-        if (par && currConnPy->hasWeight) {
-            par->currType = ExplicitList;
-            par->value = currConnPy->weights;
-            par->indices.clear();
-            for (int i = 0; i < currConnPy->weights.size(); ++i) {
-                par->indices.push_back(i);
-            }
-        }
+        currConnPy->applyWeights();
         this->accept();
     }
 
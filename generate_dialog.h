@@ -45,10 +45,14 @@ private:
     Ui::generate_dialog *ui;
     connection * currConn;
     QThread *workerThread;
+    bool cancelling;
 
 public slots:
     void moveFromThread();
     void doPython();
+    void pythonStarted(pythonscript_connection *);
+    void pythonFinished(pythonscript_connection *, bool cancelled);
+    void reject();
 };
 
 #endif // GENERATE_DIALOG_H
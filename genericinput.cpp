@@ -683,6 +683,10 @@ void genericInput::read_meta_data(QDomDocument * meta) {
                             // prevent regeneration
                             pyConn->setUnchanged(true);
                         }
+                        // analytic kernels are exported as tables, and described here
+                        if (this->connectionType->type == Kernel) {
+                            this->connectionType->read_metadata_xml(metaData);
+                        }
                     }
 
                 }
@@ -0,0 +1,484 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+// A benchmark for drawing the 3D network view. It builds synthetic populations and projections,
+// draws a number of frames of a glConnectionWidget and reports the frame times, the GL calls made
+// per frame and the memory used. GL defaults to Mesa's software renderer (llvmpipe) so results
+// don't depend on the graphics card, and it can be run without a display under Xvfb:
+//
+//   xvfb-run -a ./glbenchmark --frames 500 --populations 4 --neurons 10000
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include "rootdata.h"
+#include "projections.h"
+#include "cinterpreter.h"
+#include <algorithm>
+#include <string.h>
+#ifdef Q_OS_LINUX
+#include <dlfcn.h>
+#endif
+
+struct benchmarkOptions {
+    int frames;
+    int populations;
+    int neurons;
+    QStringList connectivity;
+    float probability;
+    int listConnections;
+    int width;
+    int height;
+    int detail;
+    bool software;
+};
+
+// GL calls made by the widget, by kind
+struct glCallCounts {
+    quint64 begin;
+    quint64 vertex;
+    quint64 colour;
+    quint64 drawArrays;
+    quint64 matrix;
+    quint64 state;
+};
+
+static glCallCounts glCounts = {0, 0, 0, 0, 0, 0};
+
+#ifdef Q_OS_LINUX
+// the widget is built into this program, so its calls to these GL functions bind to the
+// definitions here - which count them and pass them on to the GL library
+#define REAL_GL(type, name) static type real = (type) dlsym(RTLD_NEXT, name)
+
+extern "C" {
+
+void glBegin(GLenum mode) {
+    typedef void (*glBeginFn)(GLenum);
+    REAL_GL(glBeginFn, "glBegin");
+    ++glCounts.begin;
+    real(mode);
+}
+
+void glVertex3f(GLfloat x, GLfloat y, GLfloat z) {
+    typedef void (*glVertex3fFn)(GLfloat, GLfloat, GLfloat);
+    REAL_GL(glVertex3fFn, "glVertex3f");
+    ++glCounts.vertex;
+    real(x, y, z);
+}
+
+void glColor4f(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+    typedef void (*glColor4fFn)(GLfloat, GLfloat, GLfloat, GLfloat);
+    REAL_GL(glColor4fFn, "glColor4f");
+    ++glCounts.colour;
+    real(r, g, b, a);
+}
+
+void glColor4ub(GLubyte r, GLubyte g, GLubyte b, GLubyte a) {
+    typedef void (*glColor4ubFn)(GLubyte, GLubyte, GLubyte, GLubyte);
+    REAL_GL(glColor4ubFn, "glColor4ub");
+    ++glCounts.colour;
+    real(r, g, b, a);
+}
+
+void glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    typedef void (*glDrawArraysFn)(GLenum, GLint, GLsizei);
+    REAL_GL(glDrawArraysFn, "glDrawArrays");
+    ++glCounts.drawArrays;
+    real(mode, first, count);
+}
+
+void glPushMatrix() {
+    typedef void (*glPushMatrixFn)();
+    REAL_GL(glPushMatrixFn, "glPushMatrix");
+    ++glCounts.matrix;
+    real();
+}
+
+void glPopMatrix() {
+    typedef void (*glPopMatrixFn)();
+    REAL_GL(glPopMatrixFn, "glPopMatrix");
+    ++glCounts.matrix;
+    real();
+}
+
+void glTranslatef(GLfloat x, GLfloat y, GLfloat z) {
+    typedef void (*glTranslatefFn)(GLfloat, GLfloat, GLfloat);
+    REAL_GL(glTranslatefFn, "glTranslatef");
+    ++glCounts.matrix;
+    real(x, y, z);
+}
+
+void glEnable(GLenum cap) {
+    typedef void (*glEnableFn)(GLenum);
+    REAL_GL(glEnableFn, "glEnable");
+    ++glCounts.state;
+    real(cap);
+}
+
+void glDisable(GLenum cap) {
+    typedef void (*glDisableFn)(GLenum);
+    REAL_GL(glDisableFn, "glDisable");
+    ++glCounts.state;
+    real(cap);
+}
+
+}
+#endif
+
+// resident memory now and at its peak, in kB - only available where there is a /proc
+static bool memoryUse(qint64 &current, qint64 &peak) {
+
+    current = -1;
+    peak = -1;
+
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    QTextStream in(&status);
+    QString line = in.readLine();
+    while (!line.isNull()) {
+        QStringList fields = line.simplified().split(' ');
+        if (fields.size() >= 2 && fields[0] == "VmRSS:")
+            current = fields[1].toLongLong();
+        if (fields.size() >= 2 && fields[0] == "VmHWM:")
+            peak = fields[1].toLongLong();
+        line = in.readLine();
+    }
+
+    return current >= 0;
+
+}
+
+static QString memoryString(qint64 kB) {
+
+    if (kB < 0)
+        return "n/a";
+    return QString::number(double(kB) / 1024.0, 'f', 1) + " MB";
+
+}
+
+static double percentile(const QVector <double> &sorted, double p) {
+
+    if (sorted.isEmpty())
+        return 0;
+    int index = int(p * double(sorted.size() - 1) + 0.5);
+    return sorted[qBound(0, index, sorted.size() - 1)];
+
+}
+
+static void usage(QTextStream &out) {
+
+    out << "Usage: glbenchmark [options]\n"
+        << "  --frames N             frames to draw (default 200)\n"
+        << "  --populations N        populations, connected in a chain (default 4)\n"
+        << "  --neurons N            neurons in each population (default 1000)\n"
+        << "  --connectivity LIST    kinds of projection to cycle through, from\n"
+        << "                         all, one, prob and list (default all,one,prob,list)\n"
+        << "  --probability P        probability for 'prob' projections (default 0.01)\n"
+        << "  --list-connections N   connections in 'list' projections (default 10 per neuron)\n"
+        << "  --size WxH             size of the view (default 800x600)\n"
+        << "  --detail N             3D view detail setting (default 5)\n"
+        << "  --hardware             use the system's GL rather than Mesa's software renderer\n";
+
+}
+
+static bool parseOptions(const QStringList &args, benchmarkOptions &options, QTextStream &out) {
+
+    options.frames = 200;
+    options.populations = 4;
+    options.neurons = 1000;
+    options.connectivity = QString("all,one,prob,list").split(',');
+    options.probability = 0.01f;
+    options.listConnections = -1;
+    options.width = 800;
+    options.height = 600;
+    options.detail = 5;
+    options.software = true;
+
+    for (int i = 1; i < args.size(); ++i) {
+        QString arg = args[i];
+        if (arg == "--hardware") {
+            options.software = false;
+            continue;
+        }
+        if (arg == "--help" || i + 1 >= args.size()) {
+            usage(out);
+            return false;
+        }
+        QString value = args[++i];
+        bool ok = true;
+        if (arg == "--frames") {
+            options.frames = value.toInt(&ok);
+        } else if (arg == "--populations") {
+            options.populations = value.toInt(&ok);
+        } else if (arg == "--neurons") {
+            options.neurons = value.toInt(&ok);
+        } else if (arg == "--connectivity") {
+            options.connectivity = value.split(',', QString::SkipEmptyParts);
+            for (int j = 0; j < options.connectivity.size(); ++j) {
+                if (!QString("all,one,prob,list").split(',').contains(options.connectivity[j]))
+                    ok = false;
+            }
+        } else if (arg == "--probability") {
+            options.probability = value.toFloat(&ok);
+        } else if (arg == "--list-connections") {
+            options.listConnections = value.toInt(&ok);
+        } else if (arg == "--size") {
+            QStringList size = value.split('x');
+            ok = size.size() == 2;
+            if (ok) {
+                bool okHeight;
+                options.width = size[0].toInt(&ok);
+                options.height = size[1].toInt(&okHeight);
+                ok = ok && okHeight;
+            }
+        } else if (arg == "--detail") {
+            options.detail = value.toInt(&ok);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            out << "Bad option: " << arg << " " << value << "\n";
+            usage(out);
+            return false;
+        }
+    }
+
+    if (options.listConnections < 0)
+        options.listConnections = options.neurons * 10;
+
+    if (options.frames < 1 || options.populations < 1 || options.neurons < 1 || options.width < 1 || options.height < 1) {
+        usage(out);
+        return false;
+    }
+
+    return true;
+
+}
+
+// a population with its neurons jittered about a cubic grid
+static QSharedPointer <population> makePopulation(rootData &data, int index, int numNeurons, randomStream &random) {
+
+    QSharedPointer <population> pop = QSharedPointer <population> (new population(0, 0, 1.0f, 5.0/3.0f, "Population " + QString::number(index)));
+    pop->tag = data.getIndex();
+    pop->numNeurons = numNeurons;
+    pop->layoutType = QSharedPointer <NineMLLayoutData> (new NineMLLayoutData(data.catalogLayout[0]));
+    pop->neuronType = QSharedPointer <NineMLComponentData> (new NineMLComponentData(data.catalogNrn[0]));
+    pop->neuronType->owner = pop;
+    pop->colour = QColor::fromHsv((index * 67) % 360, 200, 220);
+    pop->isVisualised = true;
+
+    int side = ceil(pow(double(numNeurons), 1.0/3.0));
+    for (int i = 0; i < numNeurons; ++i) {
+        loc location;
+        location.x = (i % side) + 0.5f * (random.uniform() - 0.5f);
+        location.y = ((i / side) % side) + 0.5f * (random.uniform() - 0.5f);
+        location.z = (i / (side * side)) + 0.5f * (random.uniform() - 0.5f);
+        pop->layoutType->locations.push_back(location);
+    }
+
+    // side by side along x
+    pop->loc3.x = index * (side + 5);
+    pop->loc3.y = 0;
+    pop->loc3.z = 0;
+
+    return pop;
+
+}
+
+static connection * makeConnection(QString kind, const benchmarkOptions &options, int index) {
+
+    if (kind == "one")
+        return new onetoOne_connection;
+    if (kind == "prob") {
+        fixedProb_connection * prob = new fixedProb_connection;
+        prob->p = options.probability;
+        prob->seed = 123 + index;
+        return prob;
+    }
+    if (kind == "list") {
+        // an explicit list - the connections themselves are handed to the widget
+        return new kernel_connection;
+    }
+    return new alltoAll_connection;
+
+}
+
+int main(int argc, char *argv[])
+{
+    // Mesa reads this when the first context is made, so it has to be set before anything else
+    bool software = true;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--hardware") == 0)
+            software = false;
+    }
+    if (software)
+        qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+
+    qputenv("QT_HASH_SEED", "12345");
+    QApplication app(argc, argv);
+
+    // keep the benchmark's settings away from the application's
+    QCoreApplication::setOrganizationName("BLANK");
+    QCoreApplication::setApplicationName("SpineCreator glbenchmark");
+
+    QTextStream out(stdout);
+
+    benchmarkOptions options;
+    if (!parseOptions(QCoreApplication::arguments(), options, out))
+        return 1;
+
+    QSettings settings;
+    settings.setValue("glOptions/detail", options.detail);
+
+    qint64 startMemory;
+    qint64 peakMemory;
+    memoryUse(startMemory, peakMemory);
+
+    rootData data;
+    glConnectionWidget widget(&data);
+    widget.resize(options.width, options.height);
+
+    // populations in a chain, each projecting to the next
+    randomStream random(1);
+    QVector <QSharedPointer <population> > pops;
+    for (int i = 0; i < options.populations; ++i) {
+        pops.push_back(makePopulation(data, i, options.neurons, random));
+        widget.showPopulation(pops.back());
+    }
+
+    int numProjections = 0;
+    for (int i = 0; i + 1 < pops.size() && options.connectivity.size() > 0; ++i) {
+
+        QString kind = options.connectivity[i % options.connectivity.size()];
+
+        QSharedPointer <projection> proj = QSharedPointer <projection> (new projection());
+        proj->tag = data.getIndex();
+        proj->source = pops[i];
+        proj->destination = pops[i+1];
+        pops[i]->projections.push_back(proj);
+        pops[i+1]->reverseProjections.push_back(proj);
+
+        QSharedPointer <synapse> syn = QSharedPointer <synapse> (new synapse(proj, &data, true));
+        delete syn->connectionType;
+        syn->connectionType = makeConnection(kind, options, i);
+        syn->isVisualised = true;
+        proj->synapses.push_back(syn);
+
+        widget.selectedConns.push_back(syn);
+        widget.connections.resize(widget.connections.size()+1);
+        if (kind == "list") {
+            QVector <conn> &list = widget.connections.back();
+            list.resize(options.listConnections);
+            for (int c = 0; c < list.size(); ++c) {
+                list[c].src = qMin(int(random.uniform() * options.neurons), options.neurons - 1);
+                list[c].dst = qMin(int(random.uniform() * options.neurons), options.neurons - 1);
+                list[c].metric = 0;
+            }
+        }
+        ++numProjections;
+    }
+
+    qint64 sceneMemory;
+    memoryUse(sceneMemory, peakMemory);
+
+    // draw as fast as possible - every repaint is a frame
+    widget.frameTiming()->setMaxFrameRate(1000000);
+
+    // the first frame shows the view and builds the buffers, so time it apart from the rest
+    QElapsedTimer clock;
+    clock.start();
+    widget.show();
+    QApplication::processEvents();
+
+    if (!widget.isVisible() || !widget.isValid()) {
+        out << "Could not create a GL view (is there a display? try xvfb-run)\n";
+        return 1;
+    }
+
+    widget.repaint();
+    widget.makeCurrent();
+    glFinish();
+    double firstFrame = double(clock.nsecsElapsed()) / 1000000.0;
+
+    out << "renderer:  " << (const char *) glGetString(GL_RENDERER) << " (" << (const char *) glGetString(GL_VERSION) << ")\n";
+    out << "scene:     " << options.populations << " populations of " << options.neurons << " neurons, "
+        << numProjections << " projections (" << options.connectivity.join(",") << "), "
+        << options.width << "x" << options.height << ", detail " << options.detail << "\n";
+
+    widget.frameTiming()->resetStatistics();
+    glCallCounts before = glCounts;
+
+    QVector <double> times;
+    for (int frame = 0; frame < options.frames; ++frame) {
+        clock.start();
+        widget.repaint();
+        widget.makeCurrent();
+        glFinish();
+        times.push_back(double(clock.nsecsElapsed()) / 1000000.0);
+    }
+
+    glCallCounts after = glCounts;
+
+    qint64 endMemory;
+    memoryUse(endMemory, peakMemory);
+
+    double total = 0;
+    for (int i = 0; i < times.size(); ++i)
+        total += times[i];
+    QVector <double> sorted = times;
+    std::sort(sorted.begin(), sorted.end());
+
+    out << "first frame: " << QString::number(firstFrame, 'f', 2) << " ms\n";
+    out << "frames:    " << times.size()
+        << "  mean " << QString::number(total / times.size(), 'f', 2)
+        << "  p50 " << QString::number(percentile(sorted, 0.5), 'f', 2)
+        << "  p90 " << QString::number(percentile(sorted, 0.9), 'f', 2)
+        << "  p99 " << QString::number(percentile(sorted, 0.99), 'f', 2)
+        << "  max " << QString::number(sorted.back(), 'f', 2) << " ms\n";
+    out << "painting:  mean " << QString::number(widget.frameTiming()->meanFrameTime(), 'f', 2)
+        << " ms of each frame before the GL pipeline finishes\n";
+
+#ifdef Q_OS_LINUX
+    double frames = options.frames;
+    out << "GL calls per frame:"
+        << "  glBegin " << QString::number(double(after.begin - before.begin) / frames, 'f', 1)
+        << "  glVertex " << QString::number(double(after.vertex - before.vertex) / frames, 'f', 1)
+        << "  glColor " << QString::number(double(after.colour - before.colour) / frames, 'f', 1)
+        << "  glDrawArrays " << QString::number(double(after.drawArrays - before.drawArrays) / frames, 'f', 1)
+        << "  matrix " << QString::number(double(after.matrix - before.matrix) / frames, 'f', 1)
+        << "  enable/disable " << QString::number(double(after.state - before.state) / frames, 'f', 1) << "\n";
+#else
+    Q_UNUSED(before)
+    Q_UNUSED(after)
+    out << "GL calls per frame: only counted on Linux\n";
+#endif
+
+    out << "memory:    resident " << memoryString(endMemory)
+        << ", peak " << memoryString(peakMemory)
+        << ", scene " << memoryString(sceneMemory >= 0 ? sceneMemory - startMemory : -1)
+        << ", drawing " << memoryString(endMemory >= 0 ? endMemory - sceneMemory : -1) << "\n";
+
+    return 0;
+}
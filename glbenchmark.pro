@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# Benchmark for drawing the 3D network view. Builds the
+# application's sources with its own main in place of
+# the application's. Build it away from the application,
+# so they don't share object files:
+#
+#   mkdir build-benchmark && cd build-benchmark
+#   qmake ../glbenchmark.pro && make
+#   xvfb-run -a ./glbenchmark --help
+#
+#-------------------------------------------------
+
+include(neuralNetworks.pro)
+
+TARGET = glbenchmark
+
+SOURCES -= main.cpp
+SOURCES += glbenchmark.cpp
+
+# GL calls are counted by passing them on with dlsym
+unix:!macx {
+    LIBS += -ldl
+}
+
+INSTALLS -= target
@@ -31,10 +31,13 @@
 #include "GL/glu.h"
 #endif
 #include "generate_dialog.h"
+#include "cinterpreter.h"
 #include "mainwindow.h"
-#if QT_VERSION > QT_VERSION_CHECK(5, 0, 0)
-#include <QOpenGLFramebufferObject>
-#endif
+#include <QToolTip>
+
+// quads of neuron spheres drawn at detail level 0, doubling with each level
+#define NEURON_QUAD_BUDGET 32768
+
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
   #define RETINA_SUPPORT 1.0
 #else
@@ -65,10 +68,31 @@ glConnectionWidget::glConnectionWidget(rootData * data, QWidget *parent) : QGLWi
 
     newLogTime = 0;
     currentLogTime = 0;
+    colourMapTexture = 0;
 
     orthoView = false;
 
-    repaintAllowed = true;
+    // limit the frame rate, coalescing redraws that come too fast
+    QSettings settings;
+    scheduler = new frameScheduler(this);
+    scheduler->setMaxFrameRate(settings.value("glOptions/maxFrameRate", 60).toInt());
+    scheduler->setLogging(settings.value("glOptions/logFrameTimes", false).toBool());
+
+    // hovering over neurons shows what they are
+    button = Qt::NoButton;
+    pickValid = false;
+    setMouseTracking(true);
+}
+
+glConnectionWidget::~glConnectionWidget()
+{
+    // stop any frames being worked out in the background
+    qDeleteAll(logFrames);
+
+    if (colourMapTexture != 0) {
+        this->makeCurrent();
+        glDeleteTextures(1, &colourMapTexture);
+    }
 }
 
 void glConnectionWidget::initializeGL()
@@ -87,18 +111,26 @@ void glConnectionWidget::toggleOrthoView(bool toggle) {
 void glConnectionWidget::clear() {
 
     selectedPops.clear();
-    popColours.clear();
+    popColourIndices.clear();
     popLogs.clear();
     selectedConns.clear();
     connections.clear();
     selectedIndex = 0;
     selectedType = 1;
     model = (QAbstractTableModel *)0;
+    invalidateScene();
+    fixedProbCache.clear();
+    qDeleteAll(logFrames);
+    logFrames.clear();
 
 }
 
 void glConnectionWidget::addLogs(QVector < logData * > * logs) {
 
+    // frames from the old logs are no use
+    qDeleteAll(logFrames);
+    logFrames.clear();
+
     // for each population
     for (int i = 0; i < selectedPops.size(); ++i) {
 
@@ -140,41 +172,31 @@ void glConnectionWidget::updateLogData() {
 
     currentLogTime = newLogTime;
 
-    // fetch data from logs
+    // drop the frames of logs no longer shown
+    QList <logData *> framedLogs = logFrames.keys();
+    for (int i = 0; i < framedLogs.size(); ++i) {
+        if (!popLogs.contains(framedLogs[i]))
+            delete logFrames.take(framedLogs[i]);
+    }
+
+    // fetch colours from logs
     for (int i = 0; i < popLogs.size(); ++i) {
 
         // skip where there is no log
         if (popLogs[i] == NULL)
             continue;
 
-        // get a row
-        QVector < double > logValues = popLogs[i]->getRow(currentLogTime);
-
-        // data not usable
-        if (logValues.size() == 0)
-            continue;
-        if ((int) logValues.size() > selectedPops[i]->numNeurons)
-            continue;
-
-        // resize container
-        QColor col(0,0,0,255);
-        popColours[i].resize(selectedPops[i]->numNeurons);
-        popColours[i].fill(col);
-
-        // remap data
-        for (int j = 0; j < logValues.size(); ++j) {
-            if (logValues[j] < Q_INFINITY && (popLogs[i]->getMax()-popLogs[i]->getMin()) != 0) {
-                int val = ((logValues[j]-popLogs[i]->getMin())*255.0)/(popLogs[i]->getMax()-popLogs[i]->getMin());
-                val *= 3;
-                // complete the remap in just 4 ternarys 
-                int val3 = val > 511 ? val-512 : 0;
-                int val2 = val3 > 0 ? 511 : val;
-                val2 = val2 > 255 ? val2 - 256 : 0;
-                int val1 = val < 255 ? val : 255;
-
-                popColours[i][j] = QColor(val1,val2, val3, 255);
-            }
+        // the frames are worked out in the background, ahead of the time shown
+        logColourFrames * frames = logFrames.value(popLogs[i], NULL);
+        if (frames == NULL || frames->neurons() != selectedPops[i]->numNeurons) {
+            delete frames;
+            frames = new logColourFrames(popLogs[i], selectedPops[i]->numNeurons);
+            logFrames[popLogs[i]] = frames;
         }
+
+        QVector <quint8> indices;
+        if (frames->frame(currentLogTime, indices))
+            popColourIndices[i] = indices;
     }
 
     // redraw!
@@ -203,6 +225,7 @@ void glConnectionWidget::redraw() {
             currPop->layoutType->generateLayout(currPop->numNeurons,&currPop->layoutType->locations,errs);
         }
     }
+    this->invalidateScene();
     this->repaint();
 }
 
@@ -229,27 +252,111 @@ void glConnectionWidget::redraw(int)
 
 }
 
-void glConnectionWidget::allowRepaint() {
-    this->repaintAllowed = true;
-}
-
 void glConnectionWidget::paintEvent(QPaintEvent * /*event*/ )
 {
 
-    // avoid repainting too fast
-    if (this->repaintAllowed == false) {
+    // don't try and repaint a hidden widget!
+    if (!this->isVisible())
+        return;
+
+    // avoid repainting too fast - the scheduler draws a frame later on instead (but images
+    // must be drawn now)
+    if (!imageSaveMode && !scheduler->beginFrame())
+        return;
+
+    this->drawScene();
+
+    // layout previews have no labels
+    if (locations.size() > 0) {
+        // need this as no painter!
+        swapBuffers();
+        if (!imageSaveMode)
+            scheduler->endFrame();
         return;
+    }
+
+    glPushMatrix();
+    glTranslatef(0,0,-5.0);
+
+    if (popIndicesShown) {
+        QPainter painter(this);
+        painter.setRenderHint(QPainter::Antialiasing);
+
+        QPen pen = painter.pen();
+        QPen oldPen = pen;
+        pen.setColor(QColor(0,0,0,255));
+        painter.setPen(pen);
+
+        float zoomVal = zoomFactor;
+        if (zoomVal < 0.3)
+            zoomVal = 0.3;
+
+        // draw text
+        for (int locNum = 0; locNum < selectedPops.size(); ++locNum) {
+            QSharedPointer <population> currPop = selectedPops[locNum];
+            for (int i = 0; i < currPop->layoutType->locations.size(); ++i) {
+                glPushMatrix();
+
+                glTranslatef(currPop->layoutType->locations[i].x, currPop->layoutType->locations[i].y, currPop->layoutType->locations[i].z);
+
+                // if currently selected
+                if (currPop == selectedObject) {
+                    // move to pop location denoted by the spinboxes for x, y, z
+                    glTranslatef(loc3Offset.x, loc3Offset.y,loc3Offset.z);
+                } else {
+                    glTranslatef(currPop->loc3.x, currPop->loc3.y,currPop->loc3.z);
+                }
+
+                // print up text:
+                GLdouble modelviewMatrix[16];
+                GLdouble projectionMatrix[16];
+                GLint viewPort[4];
+                GLdouble winX;
+                GLdouble winY;
+                GLdouble winZ;
+                glGetIntegerv(GL_VIEWPORT, viewPort);
+                glGetDoublev(GL_MODELVIEW_MATRIX, modelviewMatrix);
+                glGetDoublev(GL_PROJECTION_MATRIX, projectionMatrix);
+                gluProject(0, 0, 0, modelviewMatrix, projectionMatrix, viewPort, &winX, &winY, &winZ);
+
+                winX /= RETINA_SUPPORT;
+                winY /= RETINA_SUPPORT;
+
+                if (orthoView) {
+                    winX += this->width()/4.0;
+                    winY -= this->height()/4.0;
+                }
+
+                if (imageSaveMode) {}
+                    //painter.drawText(QRect(winX-(1.0-winZ)*220-20,imageSaveHeight-winY-(1.0-winZ)*220-10,40,20),QString::number(float(i)));
+                else
+                    if (orthoView)
+                        painter.drawText(QRect(winX-(1.0-winZ)*220-10.0/zoomVal-10,this->height()-winY-(1.0-winZ)*220-10.0/zoomVal-10,40,20),QString::number(float(i)));
+                    else
+                        painter.drawText(QRect(winX-(1.0-winZ)*300-10.0/zoomVal,this->height()-winY-(1.0-winZ)*300-10.0/zoomVal,40,20),QString::number(float(i)));
+                    //painter.drawText(QRect(winX-(1.0-winZ)*600,this->height()-winY-(1.0-winZ)*600,40,20),QString::number(float(i)));
+                    //painter.drawText(QRect((winX-(1.0-winZ)*220-20),this->height()-(winY-(1.0-winZ)*220+50),40,20),QString::number(float(i)));
+
+                glPopMatrix();
+            }
+        }
+        painter.setPen(oldPen);
+        painter.end();
     } else {
-        this->repaintAllowed = false;
-        QTimer * timer = new QTimer(this);
-        timer->setSingleShot(true);
-        connect(timer, SIGNAL(timeout()), this, SLOT(allowRepaint()));
-        timer->start(5);
+        // if the painter isn't there this doesn't get called!
+        QPainter painter(this);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.end();
     }
 
-    // don't try and repaint a hidden widget!
-    if (!this->isVisible())
-        return;
+    glPopMatrix();
+
+    if (!imageSaveMode)
+        scheduler->endFrame();
+
+}
+
+void glConnectionWidget::drawScene() {
 
     // get rid of old stuff
     if (imageSaveMode) {
@@ -308,71 +415,55 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/ )
 
     // if previewing a layout then override normal drawing
     if (locations.size() > 0) {
-        for (int i = 0; i < locations[0].size(); ++i) {
-            glPushMatrix();
 
-            glTranslatef(locations[0][i].x, locations[0][i].y, locations[0][i].z);
-
-            // draw with a level of detail dependant on the number on neurons we must draw
-            int LoD = round(250.0f/float(locations[0].size())*pow(2,float(quality)));
-            // put some bounds on
-            if (LoD < 4) LoD = 4; if (LoD > 32) LoD = 32;
-            this->drawNeuron(0.5, LoD, LoD, QColor(100,100,100,255));
-
-            glPopMatrix();
-        }
+        this->drawNeurons(previewBuffer, locations[0], QVector <quint8> (), QColor(100,100,100,255), quality, NEURON_QUAD_BUDGET << quality);
+        pickValid = false;
 
         glPopMatrix();
-        // need this as no painter!
-        swapBuffers();
         return;
     }
 
-    // draw with a level of detail dependant on the number on neurons we must draw
-    // sum neurons across all pops we'll draw
+    // keep the view for picking neurons with the mouse
+    if (!imageSaveMode) {
+        glGetDoublev(GL_MODELVIEW_MATRIX, pickModelview);
+        glGetDoublev(GL_PROJECTION_MATRIX, pickProjection);
+        glGetIntegerv(GL_VIEWPORT, pickViewport);
+        pickValid = true;
+    }
+
+    // sum neurons across all pops we'll draw, so each gets its share of the budget of quads
     int totalNeurons = 0;
     for (int locNum = 0; locNum < selectedPops.size(); ++locNum) {
         totalNeurons += selectedPops[locNum]->layoutType->locations.size();
     }
-    int LoD = round(250.0f/float(totalNeurons)*pow(2,float(quality)));
 
     // normal drawing
     for (int locNum = 0; locNum < selectedPops.size(); ++locNum) {
         QSharedPointer <population> currPop = selectedPops[locNum];
-        for (int i = 0; i < currPop->layoutType->locations.size(); ++i) {
-            glPushMatrix();
-
-            glTranslatef(currPop->layoutType->locations[i].x, currPop->layoutType->locations[i].y, currPop->layoutType->locations[i].z);
 
-            // if currently selected
-            if (currPop == selectedObject) {
-                // move to pop location denoted by the spinboxes for x, y, z
-                glTranslatef(loc3Offset.x, loc3Offset.y,loc3Offset.z);
-            } else {
-                glTranslatef(currPop->loc3.x, currPop->loc3.y,currPop->loc3.z);
-            }
+        // check we haven't broken stuff
+        if (popColourIndices[locNum].size() > currPop->layoutType->locations.size()) {
 
-            // draw with a level of detail dependant on the number on neurons we must draw
-            // put some bounds on
-            if (LoD < 4) LoD = 4; if (LoD > 32) LoD = 32;
-            if (imageSaveMode)
-                LoD = 64;
+            popColourIndices[locNum].clear();
+            popLogs[locNum] = NULL;
 
-            // check we haven't broken stuff
-            if (popColours[locNum].size() > currPop->layoutType->locations.size()) {
+        }
 
-                popColours[locNum].clear();
-                popLogs[locNum] = NULL;
+        glPushMatrix();
 
-            }
+        // if currently selected
+        if (currPop == selectedObject) {
+            // move to pop location denoted by the spinboxes for x, y, z
+            glTranslatef(loc3Offset.x, loc3Offset.y,loc3Offset.z);
+        } else {
+            glTranslatef(currPop->loc3.x, currPop->loc3.y,currPop->loc3.z);
+        }
 
-            if (popColours[locNum].size() > 0) {
-                this->drawNeuron(0.5, LoD, LoD, popColours[locNum][i]);
-            } else
-                this->drawNeuron(0.5, LoD, LoD, QColor(100 + 0.5*currPop->colour.red(),100 + 0.5*currPop->colour.green(),100 + 0.5*currPop->colour.blue(),255));
+        QColor popCol(100 + 0.5*currPop->colour.red(),100 + 0.5*currPop->colour.green(),100 + 0.5*currPop->colour.blue(),255);
+        int maxQuads = (NEURON_QUAD_BUDGET << quality) * (double(currPop->layoutType->locations.size()) / double(totalNeurons));
+        this->drawNeurons(popBuffers[currPop.data()], currPop->layoutType->locations, popColourIndices[locNum], popCol, quality, maxQuads);
 
-            glPopMatrix();
-        }
+        glPopMatrix();
     }
 
     // draw synapses
@@ -436,6 +527,9 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/ )
             dstZ = dst->loc3.z;
         }
 
+        loc3f srcOffset = {srcX, srcY, srcZ};
+        loc3f dstOffset = {dstX, dstY, dstZ};
+
         // check we have the current version of the connectivity
         if (conn->type == CSV) {
             csv_connection * csv_conn = dynamic_cast<csv_connection *> (conn);
@@ -448,6 +542,7 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/ )
                     // fetch connections back here:
                     connections[targNum].clear();
                     csv_conn->getAllData(connections[targNum]);
+                    connBuffers.remove(selectedConns[targNum].data());
                 }
             }
         }
@@ -461,424 +556,792 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/ )
             }
 
             connGenerationMutex->lock();
-            for (int i = 0; i < connections[targNum].size(); ++i) {
-
-                if (connections[targNum][i].src < src->layoutType->locations.size() && connections[targNum][i].dst < dst->layoutType->locations.size()) {
-                    glLineWidth(1.0*lineScaleFactor);
+            this->drawConnectionBuffer(targNum, src, dst, conn, srcOffset, dstOffset, lineScaleFactor);
 
-                    glColor4f(0.0, 0.0, 0.0, 0.1);
+            // draw selected connections on top
+            glDisable(GL_DEPTH_TEST);
+            if (selectedConns[targNum] == selectedObject && !selectedRows.isEmpty()) {
+
+                // connections sharing a source or destination with a selected cell are drawn
+                // through the index, rather than testing every connection against the selection
+                QSet <int> srcNeurons;
+                QSet <int> dstNeurons;
+                foreach (int row, selectedSrcRows) {
+                    if (row < connections[targNum].size())
+                        srcNeurons.insert(connections[targNum][row].src);
+                }
+                foreach (int row, selectedDstRows) {
+                    if (row < connections[targNum].size())
+                        dstNeurons.insert(connections[targNum][row].dst);
+                }
 
-                    // draw in
-                    glBegin(GL_TRIANGLES);
-                    if (src->isVisualised && dst->isVisualised) {
-                        glVertex3f(src->layoutType->locations[connections[targNum][i].src].x+srcX, src->layoutType->locations[connections[targNum][i].src].y+srcY, src->layoutType->locations[connections[targNum][i].src].z+srcZ);
-                        glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x+dstX, dst->layoutType->locations[connections[targNum][i].dst].y+dstY, dst->layoutType->locations[connections[targNum][i].dst].z+dstZ);
-                        glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x+dstX, dst->layoutType->locations[connections[targNum][i].dst].y+dstY, dst->layoutType->locations[connections[targNum][i].dst].z+dstZ+0.05);
-                    }
-                    if (src->isVisualised && !dst->isVisualised) {
-                        glVertex3f(src->layoutType->locations[connections[targNum][i].src].x, src->layoutType->locations[connections[targNum][i].src].y, src->layoutType->locations[connections[targNum][i].src].z);
-                        glVertex3f(dstX, dstY, dstZ);
-                        glVertex3f(dstX, dstY, dstZ+0.01);
+                glLineWidth(1.5*lineScaleFactor);
+                glColor4f(0.0, 1.0, 0.0, 0.8);
+                foreach (int neuron, srcNeurons)
+                    this->drawNeuronConnections(targNum, neuron, true, src, dst, srcOffset, dstOffset);
+                foreach (int neuron, dstNeurons)
+                    this->drawNeuronConnections(targNum, neuron, false, src, dst, srcOffset, dstOffset);
+
+                // and the selected rows themselves on top
+                glLineWidth(2.0*lineScaleFactor);
+                glColor4f(1.0, 0.0, 0.0, 1.0);
+                glBegin(GL_LINES);
+                foreach (int row, selectedRows) {
+                    loc start;
+                    loc end;
+                    if (row < connections[targNum].size() && this->connectionEnds(targNum, row, src, dst, srcOffset, dstOffset, start, end)) {
+                        glVertex3f(start.x, start.y, start.z);
+                        glVertex3f(end.x, end.y, end.z);
                     }
-                    if (!src->isVisualised && dst->isVisualised) {
-                        glVertex3f(src->loc3.x, src->loc3.y, src->loc3.z);
-                        glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x, dst->layoutType->locations[connections[targNum][i].dst].y, dst->layoutType->locations[connections[targNum][i].dst].z);
-                        glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x, dst->layoutType->locations[connections[targNum][i].dst].y, dst->layoutType->locations[connections[targNum][i].dst].z+0.01);
+                }
+                glEnd();
+            }
+            // the connections of the selected neuron are always drawn in full
+            if (selectedConns[targNum] == selectedObject && (selectedType == 1 || selectedType == 2)) {
+                glLineWidth(1.5*lineScaleFactor);
+                glColor4f(0.0, 1.0, 0.0, 1.0);
+                this->drawNeuronConnections(targNum, selectedIndex, selectedType == 1, src, dst, srcOffset, dstOffset);
+            }
+            glEnable(GL_DEPTH_TEST);
+            connGenerationMutex->unlock();
+
+        }
+
+
+        if (conn->type == OnetoOne || conn->type == AlltoAll) {
+
+            this->drawConnectionBuffer(targNum, src, dst, conn, srcOffset, dstOffset, lineScaleFactor);
+
+        }
+
+        if (conn->type == FixedProb) {
+
+            this->drawConnectionBuffer(targNum, src, dst, conn, srcOffset, dstOffset, lineScaleFactor);
+
+            // redraw the selected neuron's connections (over the top of everything else so no depth test)
+            if (selectedType == 1 || selectedType == 2) {
+
+                const fixedProbEdges &sampled = fixedProbCache[selectedConns[targNum].data()];
+                const QVector <int> &starts = selectedType == 1 ? sampled.index.srcStart : sampled.index.dstStart;
+                const QVector <int> &list = selectedType == 1 ? sampled.index.srcConns : sampled.index.dstConns;
+
+                if (selectedIndex >= 0 && selectedIndex+1 < starts.size()) {
+                    glDisable(GL_DEPTH_TEST);
+                    glLineWidth(1.5*lineScaleFactor);
+                    glColor4f(0.0, 0.0, 1.0, 0.8);
+                    glBegin(GL_LINES);
+                    for (int k = starts[selectedIndex]; k < starts[selectedIndex+1]; ++k) {
+                        const loc &s = src->layoutType->locations[sampled.edges[list[k]].src];
+                        const loc &d = dst->layoutType->locations[sampled.edges[list[k]].dst];
+                        glVertex3f(s.x+srcX, s.y+srcY, s.z+srcZ);
+                        glVertex3f(d.x+dstX, d.y+dstY, d.z+dstZ);
                     }
                     glEnd();
+                }
+            }
 
+        }
 
 
-                } else {
-                    // ERR - CONNECTION INDEX OUT OF RANGE
-                }
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_LIGHTING);
+    }
+
+    glDisable(GL_BLEND);
+    glDisable(GL_POLYGON_SMOOTH);
+    glDisable(GL_LINE_SMOOTH);
+
+    glDisable(GL_DEPTH_TEST);
+    glShadeModel(GL_FLAT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_COLOR_MATERIAL);
+
+    glMatrixMode(GL_MODELVIEW);
+
+    glPopMatrix();
+
+}
 
+glVertexBuffer &glConnectionWidget::sphereMesh(int LoD) {
+
+    // a sphere of radius 0.5 to represent a neuron, as quads with normals - built once for each
+    // level of detail and drawn at every neuron
+    if (!sphereMeshes.contains(LoD)) {
+
+        float r = 0.5;
+        int rings = LoD;
+        int segments = LoD;
+
+        QVector <GLfloat> mesh;
+        mesh.reserve(rings*segments*4*6);
+        for (int i = 1; i <= rings; i++) {
+            double rings0 = M_PI * (-0.5 + (double) (i - 1) / rings);
+            double z0  = sin(rings0);
+            double zr0 =  cos(rings0);
+
+            double rings1 = M_PI * (-0.5 + (double) i / rings);
+            double z1 = sin(rings1);
+            double zr1 = cos(rings1);
+
+            for (int j = 0; j < segments; j++) {
+                double segment0 = 2 * M_PI * (double) (j - 1) / segments;
+                double segment1 = 2 * M_PI * (double) j / segments;
+                double x[4] = {cos(segment0), cos(segment0), cos(segment1), cos(segment1)};
+                double y[4] = {sin(segment0), sin(segment0), sin(segment1), sin(segment1)};
+                double z[4] = {z0, z1, z1, z0};
+                double zr[4] = {zr0, zr1, zr1, zr0};
+
+                for (int k = 0; k < 4; ++k) {
+                    // normal then vertex
+                    mesh.push_back(x[k] * zr[k]);
+                    mesh.push_back(y[k] * zr[k]);
+                    mesh.push_back(z[k]);
+                    mesh.push_back(x[k] * zr[k] * r);
+                    mesh.push_back(y[k] * zr[k] * r);
+                    mesh.push_back(z[k] * r);
+                }
             }
+        }
 
-            // draw selected connections on top
-            glDisable(GL_DEPTH_TEST);
-            if (selectedConns[targNum] == selectedObject) {
-                for (int i = 0; i < connections[targNum].size(); ++i) {
+        this->makeCurrent();
+        sphereMeshes[LoD].setVertices(mesh, true);
+    }
 
-                    if (connections[targNum][i].src < src->layoutType->locations.size() && connections[targNum][i].dst < dst->layoutType->locations.size()) {
-                        glLineWidth(1.0*lineScaleFactor);
+    return sphereMeshes[LoD];
 
-                        glColor4f(0.0, 0.0, 0.0, 0.1);
+}
 
-                        // find if selected
-                        bool isSelected = false;
+// hash of what a vector holds rather than where it lives - clear() keeps the allocation, so
+// connectivity or a layout regenerated in place can reuse the old pointer and size
+template <typename T> static uint contentHash(const QVector <T> &data) {
 
-                        for (int j = 0; j < (int) selection.count(); ++j) {
-                            if (i == (int) selection[j].row())
-                            {
-                                glLineWidth(2.0*lineScaleFactor);
-                                glColor4f(1.0, 0.0, 0.0, 1.0);
-                                isSelected = true;
-                                break;
-                            }
-                            if (connections[targNum][i].src == connections[targNum][selection[j].row()].src && selection[j].column() == 0)
-                            {
-                                glLineWidth(1.5*lineScaleFactor);
-                                glColor4f(0.0, 1.0, 0.0, 0.8);
-                                isSelected = true;
-                            }
-                            if (connections[targNum][i].dst == connections[targNum][selection[j].row()].dst && selection[j].column() == 1)
-                            {
-                                glLineWidth(1.5*lineScaleFactor);
-                                glColor4f(0.0, 1.0, 0.0, 0.8);
-                                isSelected = true;
-                            }
-                        }
+    return qHash(QByteArray::fromRawData((const char *) data.constData(), data.size()*sizeof(T)));
 
-                        if (((int) connections[targNum][i].src == selectedIndex && selectedType == 1) \
-                                || ((int) connections[targNum][i].dst == selectedIndex && selectedType == 2))
-                        {
-                            glLineWidth(1.5*lineScaleFactor);
-                            glColor4f(0.0, 1.0, 0.0, 1.0);
-                            isSelected = true;
-                        }
+}
 
-                        if (isSelected) {
-                            // draw in
-                            glBegin(GL_LINES);
-                            if (src->isVisualised && dst->isVisualised) {
-                                glVertex3f(src->layoutType->locations[connections[targNum][i].src].x+srcX, src->layoutType->locations[connections[targNum][i].src].y+srcY, src->layoutType->locations[connections[targNum][i].src].z+srcZ);
-                                glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x+dstX, dst->layoutType->locations[connections[targNum][i].dst].y+dstY, dst->layoutType->locations[connections[targNum][i].dst].z+dstZ);
-                            }
-                            if (src->isVisualised && !dst->isVisualised) {
-                                glVertex3f(src->layoutType->locations[connections[targNum][i].src].x, src->layoutType->locations[connections[targNum][i].src].y, src->layoutType->locations[connections[targNum][i].src].z);
-                                glVertex3f(dstX, dstY, dstZ);
-                            }
-                            if (!src->isVisualised && dst->isVisualised) {
-                                glVertex3f(src->loc3.x, src->loc3.y, src->loc3.z);
-                                glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x, dst->layoutType->locations[connections[targNum][i].dst].y, dst->layoutType->locations[connections[targNum][i].dst].z);
-                            }
-                            glEnd();
-                        }
+void glConnectionWidget::updateNeuronBuffer(glSceneBuffer &buffer, const QVector <loc> &locs) {
 
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+    stream << contentHash(locs) << locs.size();
 
+    if (buffer.key == key)
+        return;
 
-                    } else {
-                        // ERR - CONNECTION INDEX OUT OF RANGE
-                    }
-                }
-            }
-            glEnable(GL_DEPTH_TEST);
-            connGenerationMutex->unlock();
+    // neuron positions, and a bounding sphere for working out their size on screen
+    QVector <GLfloat> vertices;
+    vertices.reserve(locs.size()*3);
+    loc mins = locs[0];
+    loc maxes = locs[0];
+    for (int i = 0; i < locs.size(); ++i) {
+        vertices.push_back(locs[i].x);
+        vertices.push_back(locs[i].y);
+        vertices.push_back(locs[i].z);
+        mins.x = qMin(mins.x, locs[i].x); maxes.x = qMax(maxes.x, locs[i].x);
+        mins.y = qMin(mins.y, locs[i].y); maxes.y = qMax(maxes.y, locs[i].y);
+        mins.z = qMin(mins.z, locs[i].z); maxes.z = qMax(maxes.z, locs[i].z);
+    }
+    buffer.centre.x = (mins.x + maxes.x) / 2.0f;
+    buffer.centre.y = (mins.y + maxes.y) / 2.0f;
+    buffer.centre.z = (mins.z + maxes.z) / 2.0f;
+    buffer.radius = sqrt(pow(maxes.x - mins.x, 2) + pow(maxes.y - mins.y, 2) + pow(maxes.z - mins.z, 2)) / 2.0f;
+
+    this->makeCurrent();
+    buffer.vertices.setVertices(vertices);
+    buffer.grid = neuronGrid();
+    buffer.key = key;
+
+}
 
+float glConnectionWidget::neuronScreenRadius(const glSceneBuffer &buffer) {
+
+    GLfloat modelview[16];
+    GLfloat projection[16];
+    GLint viewPort[4];
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewPort);
+
+    // the centre of the neurons in eye coordinates (matrices are column major)
+    const loc &c = buffer.centre;
+    float ex = modelview[0]*c.x + modelview[4]*c.y + modelview[8]*c.z + modelview[12];
+    float ey = modelview[1]*c.x + modelview[5]*c.y + modelview[9]*c.z + modelview[13];
+    float ez = modelview[2]*c.x + modelview[6]*c.y + modelview[10]*c.z + modelview[14];
+
+    // w in clip coordinates is the distance for a perspective view, and 1 for an orthographic one
+    float w = projection[3]*ex + projection[7]*ey + projection[11]*ez + projection[15];
+    if (w < 0.001f)
+        w = 0.001f;
+
+    // neurons have a radius of 0.5
+    return 0.5f * projection[5] * float(viewPort[3]) / 2.0f / w;
+
+}
+
+void glConnectionWidget::bindColourMap() {
+
+    // the colour map as a 1D texture, so neurons can be coloured by their index into it
+    if (colourMapTexture == 0) {
+        const QVector <QRgb> &map = logColourFrames::colourMap();
+        QVector <GLubyte> rgba(map.size()*4);
+        for (int i = 0; i < map.size(); ++i) {
+            rgba[i*4] = qRed(map[i]); rgba[i*4+1] = qGreen(map[i]); rgba[i*4+2] = qBlue(map[i]); rgba[i*4+3] = 255;
         }
+        glGenTextures(1, &colourMapTexture);
+        glBindTexture(GL_TEXTURE_1D, colourMapTexture);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+        glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA, map.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.constData());
+    }
 
+    glBindTexture(GL_TEXTURE_1D, colourMapTexture);
+    glEnable(GL_TEXTURE_1D);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
 
-        if (conn->type == OnetoOne) {
+    // map each index to the centre of its texel
+    glMatrixMode(GL_TEXTURE);
+    glPushMatrix();
+    glLoadIdentity();
+    glTranslatef(0.5f/256.0f, 0.0f, 0.0f);
+    glScalef(1.0f/256.0f, 1.0f, 1.0f);
+    glMatrixMode(GL_MODELVIEW);
 
-            if (src->numNeurons == dst->numNeurons) {
+}
+
+void glConnectionWidget::releaseColourMap() {
+
+    glMatrixMode(GL_TEXTURE);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glDisable(GL_TEXTURE_1D);
+    glBindTexture(GL_TEXTURE_1D, 0);
+
+}
+
+void glConnectionWidget::drawNeurons(glSceneBuffer &buffer, const QVector <loc> &locs, const QVector <quint8> &colourIndices, QColor colour, int quality, int maxQuads) {
+
+    if (locs.size() == 0)
+        return;
+
+    this->updateNeuronBuffer(buffer, locs);
+
+    // pick the level of detail from the size of a neuron on screen, within the budget of quads
+    float radius = this->neuronScreenRadius(buffer);
+    int LoD = round(radius*pow(2,float(quality-5)));
+    if (LoD > 32) LoD = 32;
+    if (imageSaveMode)
+        LoD = 64;
+    int fit = sqrt(double(maxQuads) / double(locs.size()));
+    if (LoD > fit) LoD = fit;
 
-                if (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() > 0) {
+    if (LoD < 4) {
 
-                    for (int i = 0; i < src->layoutType->locations.size(); ++i) {
+        // too small or too many for spheres - draw all the neurons as round points in one go
+        float size = qBound(1.0f, 2.0f*radius, 64.0f);
 
-                        glLineWidth(1.5*lineScaleFactor);
-                        glColor4f(0.0, 0.0, 1.0, 0.8);
+        glDisable(GL_LIGHTING);
+        glEnable(GL_POINT_SMOOTH);
+        glPointSize(size);
+
+        buffer.vertices.bind();
+        int numIndexed = qMin(colourIndices.size(), locs.size());
+        if (numIndexed > 0) {
+            // logged neurons take their colour from the colour map texture
+            QVector <GLshort> texCoords(numIndexed);
+            for (int i = 0; i < numIndexed; ++i)
+                texCoords[i] = colourIndices[i];
+            this->bindColourMap();
+            buffer.vertices.setColourIndexArray(texCoords.constData());
+            buffer.vertices.draw(GL_POINTS, 0, numIndexed);
+            buffer.vertices.setColourIndexArray(NULL);
+            this->releaseColourMap();
+        }
+        glColor4f(colour.redF(), colour.greenF(), colour.blueF(), colour.alphaF());
+        buffer.vertices.draw(GL_POINTS, numIndexed);
+        buffer.vertices.release();
+
+        glDisable(GL_POINT_SMOOTH);
+        glEnable(GL_LIGHTING);
+
+        return;
+    }
+
+    // the sphere mesh is bound once and placed at each neuron
+    glVertexBuffer &mesh = this->sphereMesh(LoD);
+    const QVector <QRgb> &colourMap = logColourFrames::colourMap();
+    mesh.bind();
+    glColor4f(colour.redF(), colour.greenF(), colour.blueF(), colour.alphaF());
+    for (int i = 0; i < locs.size(); ++i) {
+        glPushMatrix();
+
+        glTranslatef(locs[i].x, locs[i].y, locs[i].z);
 
-                         // draw in
-                        glBegin(GL_LINES);
-                        glVertex3f(src->layoutType->locations[i].x+srcX, src->layoutType->locations[i].y+srcY, src->layoutType->locations[i].z+srcZ);
-                        glVertex3f(dst->layoutType->locations[i].x+dstX, dst->layoutType->locations[i].y+dstY, dst->layoutType->locations[i].z+dstZ);
-                        glEnd();
+        if (i < colourIndices.size()) {
+            QRgb col = colourMap[colourIndices[i]];
+            glColor4ub(qRed(col), qGreen(col), qBlue(col), 255);
+        }
+
+        mesh.draw(GL_QUADS);
+
+        glPopMatrix();
+    }
+    mesh.release();
+
+}
+
+static void appendVertex(QVector <GLfloat> &vertices, float x, float y, float z) {
+    vertices.push_back(x);
+    vertices.push_back(y);
+    vertices.push_back(z);
+}
+
+/*!
+ * \brief The connectionSampler class
+ * Steps through a deterministic random subsample of the indices [0, total), keeping about maxCount
+ * of them, so huge projections are drawn thinned out rather than as a solid mass. Gaps between
+ * kept indices are drawn from a geometric distribution, so the cost is in the number kept, not the
+ * total. If there are no more than maxCount indices all of them are kept.
+ */
+class connectionSampler
+{
+public:
+    connectionSampler(qint64 total, qint64 maxCount) {
+        this->total = total;
+        index = -1;
+        keep = (total > maxCount && maxCount >= 0) ? double(maxCount) / double(total) : 1.0;
+        logSkip = keep < 1.0 ? log(1.0 - keep) : 0.0;
+    }
+    // the next kept index, or -1 at the end
+    qint64 next() {
+        if (keep >= 1.0) {
+            ++index;
+        } else if (keep <= 0.0) {
+            index = total;
+        } else {
+            double u = random.uniform();
+            if (u <= 0.0)
+                u = 1.0 / 16777216.0;
+            index += 1 + qint64(log(u) / logSkip);
+        }
+        return index < total ? index : -1;
+    }
+
+private:
+    randomStream random;
+    qint64 total;
+    qint64 index;
+    double keep;
+    double logSkip;
+};
+
+// group connections by source and destination neuron in compressed rows - connections that are
+// out of range of the layouts are left out, as they aren't drawn
+static void buildConnectionIndex(const QVector <conn> &conns, int numSrc, int numDst, connectionIndex &index) {
+
+    index.srcStart.fill(0, numSrc+1);
+    index.dstStart.fill(0, numDst+1);
+    for (int i = 0; i < conns.size(); ++i) {
+        if (conns[i].src >= 0 && conns[i].src < numSrc && conns[i].dst >= 0 && conns[i].dst < numDst) {
+            ++index.srcStart[conns[i].src+1];
+            ++index.dstStart[conns[i].dst+1];
+        }
+    }
+    for (int i = 0; i < numSrc; ++i)
+        index.srcStart[i+1] += index.srcStart[i];
+    for (int i = 0; i < numDst; ++i)
+        index.dstStart[i+1] += index.dstStart[i];
+
+    index.srcConns.resize(index.srcStart[numSrc]);
+    index.dstConns.resize(index.dstStart[numDst]);
+    QVector <int> srcNext = index.srcStart;
+    QVector <int> dstNext = index.dstStart;
+    for (int i = 0; i < conns.size(); ++i) {
+        if (conns[i].src >= 0 && conns[i].src < numSrc && conns[i].dst >= 0 && conns[i].dst < numDst) {
+            index.srcConns[srcNext[conns[i].src]++] = i;
+            index.dstConns[dstNext[conns[i].dst]++] = i;
+        }
+    }
+
+}
+
+bool glConnectionWidget::connectionEnds(int targNum, int i, QSharedPointer <population> src, QSharedPointer <population> dst, loc3f srcOffset, loc3f dstOffset, loc &start, loc &end) {
+
+    const conn &c = connections[targNum][i];
+    const QVector <loc> &srcLocs = src->layoutType->locations;
+    const QVector <loc> &dstLocs = dst->layoutType->locations;
+
+    if (c.src < 0 || c.src >= srcLocs.size() || c.dst < 0 || c.dst >= dstLocs.size()) {
+        // ERR - CONNECTION INDEX OUT OF RANGE
+        return false;
+    }
+
+    if (src->isVisualised && dst->isVisualised) {
+        start.x = srcLocs[c.src].x+srcOffset.x; start.y = srcLocs[c.src].y+srcOffset.y; start.z = srcLocs[c.src].z+srcOffset.z;
+        end.x = dstLocs[c.dst].x+dstOffset.x; end.y = dstLocs[c.dst].y+dstOffset.y; end.z = dstLocs[c.dst].z+dstOffset.z;
+        return true;
+    }
+    if (src->isVisualised && !dst->isVisualised) {
+        start = srcLocs[c.src];
+        end.x = dstOffset.x; end.y = dstOffset.y; end.z = dstOffset.z;
+        return true;
+    }
+    if (!src->isVisualised && dst->isVisualised) {
+        start = src->loc3;
+        end = dstLocs[c.dst];
+        return true;
+    }
+    return false;
+
+}
+
+void glConnectionWidget::drawConnectionBuffer(int targNum, QSharedPointer <population> src, QSharedPointer <population> dst, connection * currConn, loc3f srcOffset, loc3f dstOffset, float lineScaleFactor) {
+
+    const QVector <loc> &srcLocs = src->layoutType->locations;
+    const QVector <loc> &dstLocs = dst->layoutType->locations;
+    const QVector <conn> &conns = connections[targNum];
+
+    // projections with more connections than this are drawn as a subsample
+    QSettings settings;
+    int maxConns = settings.value("glOptions/maxConnections", 250000).toInt();
+
+    // describe everything the vertices depend on - rotating and zooming change none of it
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+    stream << (int) currConn->type << contentHash(conns) << conns.size();
+    stream << contentHash(srcLocs) << srcLocs.size() << contentHash(dstLocs) << dstLocs.size();
+    stream << srcOffset.x << srcOffset.y << srcOffset.z << dstOffset.x << dstOffset.y << dstOffset.z;
+    stream << src->loc3.x << src->loc3.y << src->loc3.z << dst->loc3.x << dst->loc3.y << dst->loc3.z;
+    stream << src->isVisualised << dst->isVisualised << src->numNeurons << dst->numNeurons << maxConns;
+
+    // fixed probability connections are sampled once, and only again if what they're sampled from changes
+    if (currConn->type == FixedProb) {
+
+        fixedProb_connection * fpConn = dynamic_cast <fixedProb_connection *> (currConn);
+        CHECK_CAST(fpConn)
+
+        QByteArray sampleKey;
+        QDataStream sampleStream(&sampleKey, QIODevice::WriteOnly);
+        sampleStream << fpConn->seed << fpConn->p << srcLocs.size() << dstLocs.size();
+
+        fixedProbEdges &sampled = fixedProbCache[selectedConns[targNum].data()];
+        if (sampled.key != sampleKey) {
+
+            random.setSeed(fpConn->seed);
+            prob = fpConn->p;
 
+            sampled.edges.clear();
+            for (int i = 0; i < srcLocs.size(); ++i) {
+                for (int j = 0; j < dstLocs.size(); ++j) {
+                    if (random.value() < this->prob) {
+                        conn edge;
+                        edge.src = i;
+                        edge.dst = j;
+                        edge.metric = 0;
+                        sampled.edges.push_back(edge);
                     }
                 }
+            }
+            buildConnectionIndex(sampled.edges, srcLocs.size(), dstLocs.size(), sampled.index);
+            sampled.key = sampleKey;
+        }
 
-                if (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() == 0) {
+        stream << sampleKey;
+    }
 
-                    for (int i = 0; i < src->layoutType->locations.size(); ++i) {
+    glSceneBuffer &buffer = connBuffers[selectedConns[targNum].data()];
 
-                        glLineWidth(1.5*lineScaleFactor);
-                        glColor4f(0.0, 0.0, 1.0, 0.8);
-                        // draw in
-                        glBegin(GL_LINES);
-                        glVertex3f(src->layoutType->locations[i].x+srcX, src->layoutType->locations[i].y+srcY, src->layoutType->locations[i].z+srcZ);
-                        glVertex3f(dstX, dstY, dstZ);
-                        glEnd();
+    if (buffer.key != key) {
 
-                    }
-                }
+        QVector <GLfloat> vertices;
 
-                if (src->layoutType->locations.size() == 0 && dst->layoutType->locations.size() > 0) {
+        if (currConn->type == CSV || currConn->type == Kernel || currConn->type == Python) {
 
-                    for (int i = 0; i < dst->layoutType->locations.size(); ++i) {
+            // explicit lists are drawn as thin triangles
+            buffer.mode = GL_TRIANGLES;
+            buffer.lineWidth = 1.0;
+            buffer.colour[0] = 0.0; buffer.colour[1] = 0.0; buffer.colour[2] = 0.0; buffer.colour[3] = 0.1;
 
-                        glLineWidth(1.5*lineScaleFactor);
-                        glColor4f(0.0, 0.0, 1.0, 0.8);
-                        // draw in
-                        glBegin(GL_LINES);
-                        glVertex3f(srcX, srcY, srcZ);
-                        glVertex3f(dst->layoutType->locations[i].x+dst->loc3.x, dst->layoutType->locations[i].y+dst->loc3.y, dst->layoutType->locations[i].z+dst->loc3.z);
-                        glEnd();
+            float lift = src->isVisualised && dst->isVisualised ? 0.05 : 0.01;
 
-                    }
+            vertices.reserve(qMin(conns.size(), maxConns)*9);
+            connectionSampler sampler(conns.size(), maxConns);
+            for (qint64 i = sampler.next(); i >= 0; i = sampler.next()) {
+                loc start;
+                loc end;
+                if (this->connectionEnds(targNum, i, src, dst, srcOffset, dstOffset, start, end)) {
+                    appendVertex(vertices, start.x, start.y, start.z);
+                    appendVertex(vertices, end.x, end.y, end.z);
+                    appendVertex(vertices, end.x, end.y, end.z+lift);
                 }
             }
+
+            // so the connections of a selected neuron can be drawn in full
+            buildConnectionIndex(conns, srcLocs.size(), dstLocs.size(), buffer.index);
         }
 
-        if (conn->type == AlltoAll) {
+        if (currConn->type == FixedProb) {
+
+            buffer.mode = GL_LINES;
+            buffer.lineWidth = 1.0;
+            buffer.colour[0] = 0.0; buffer.colour[1] = 0.0; buffer.colour[2] = 0.0; buffer.colour[3] = 0.1;
 
-            if (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() > 0) {
+            const QVector <conn> &edges = fixedProbCache[selectedConns[targNum].data()].edges;
+            vertices.reserve(qMin(edges.size(), maxConns)*6);
+            connectionSampler sampler(edges.size(), maxConns);
+            for (qint64 i = sampler.next(); i >= 0; i = sampler.next()) {
+                const loc &s = srcLocs[edges[i].src];
+                const loc &d = dstLocs[edges[i].dst];
+                appendVertex(vertices, s.x+srcOffset.x, s.y+srcOffset.y, s.z+srcOffset.z);
+                appendVertex(vertices, d.x+dstOffset.x, d.y+dstOffset.y, d.z+dstOffset.z);
+            }
+        }
 
-                for (int i = 0; i < src->layoutType->locations.size(); ++i) {
-                    for (int j = 0; j <  dst->layoutType->locations.size(); ++j) {
+        if (currConn->type == OnetoOne) {
 
-                        glLineWidth(1.5*lineScaleFactor);
-                        glColor4f(0.0, 0.0, 1.0, 0.2);
-                        // draw in
-                        glBegin(GL_LINES);
-                        glVertex3f(src->layoutType->locations[i].x+srcX, src->layoutType->locations[i].y+srcY, src->layoutType->locations[i].z+srcZ);
-                        glVertex3f(dst->layoutType->locations[j].x+dstX, dst->layoutType->locations[j].y+dstY, dst->layoutType->locations[j].z+dstZ);
-                        glEnd();
+            buffer.mode = GL_LINES;
+            buffer.lineWidth = 1.5;
+            buffer.colour[0] = 0.0; buffer.colour[1] = 0.0; buffer.colour[2] = 1.0; buffer.colour[3] = 0.8;
 
+            if (src->numNeurons == dst->numNeurons) {
+                if (srcLocs.size() > 0 && dstLocs.size() > 0) {
+                    connectionSampler sampler(qMin(srcLocs.size(), dstLocs.size()), maxConns);
+                    for (qint64 i = sampler.next(); i >= 0; i = sampler.next()) {
+                        appendVertex(vertices, srcLocs[i].x+srcOffset.x, srcLocs[i].y+srcOffset.y, srcLocs[i].z+srcOffset.z);
+                        appendVertex(vertices, dstLocs[i].x+dstOffset.x, dstLocs[i].y+dstOffset.y, dstLocs[i].z+dstOffset.z);
+                    }
+                }
+                if (srcLocs.size() > 0 && dstLocs.size() == 0) {
+                    connectionSampler sampler(srcLocs.size(), maxConns);
+                    for (qint64 i = sampler.next(); i >= 0; i = sampler.next()) {
+                        appendVertex(vertices, srcLocs[i].x+srcOffset.x, srcLocs[i].y+srcOffset.y, srcLocs[i].z+srcOffset.z);
+                        appendVertex(vertices, dstOffset.x, dstOffset.y, dstOffset.z);
+                    }
+                }
+                if (srcLocs.size() == 0 && dstLocs.size() > 0) {
+                    connectionSampler sampler(dstLocs.size(), maxConns);
+                    for (qint64 i = sampler.next(); i >= 0; i = sampler.next()) {
+                        appendVertex(vertices, srcOffset.x, srcOffset.y, srcOffset.z);
+                        appendVertex(vertices, dstLocs[i].x+dst->loc3.x, dstLocs[i].y+dst->loc3.y, dstLocs[i].z+dst->loc3.z);
                     }
                 }
             }
-            if (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() == 0) {
-
-                for (int i = 0; i < src->layoutType->locations.size(); ++i) {
+        }
 
-                    glLineWidth(1.5*lineScaleFactor);
-                    glColor4f(0.0, 0.0, 1.0, 0.2);
-                    // draw in
-                    glBegin(GL_LINES);
-                    glVertex3f(src->layoutType->locations[i].x+srcX, src->layoutType->locations[i].y+srcY, src->layoutType->locations[i].z+srcZ);
-                    glVertex3f(dstX, dstY, dstZ);
-                    glEnd();
+        if (currConn->type == AlltoAll) {
+
+            buffer.mode = GL_LINES;
+            buffer.lineWidth = 1.5;
+            buffer.colour[0] = 0.0; buffer.colour[1] = 0.0; buffer.colour[2] = 1.0; buffer.colour[3] = 0.2;
+
+            if (srcLocs.size() > 0 && dstLocs.size() > 0) {
+                // sample over all the pairs without visiting each one
+                qint64 pairs = qint64(srcLocs.size()) * qint64(dstLocs.size());
+                vertices.reserve(qMin(pairs, qint64(maxConns))*6);
+                connectionSampler sampler(pairs, maxConns);
+                for (qint64 k = sampler.next(); k >= 0; k = sampler.next()) {
+                    int i = k / dstLocs.size();
+                    int j = k % dstLocs.size();
+                    appendVertex(vertices, srcLocs[i].x+srcOffset.x, srcLocs[i].y+srcOffset.y, srcLocs[i].z+srcOffset.z);
+                    appendVertex(vertices, dstLocs[j].x+dstOffset.x, dstLocs[j].y+dstOffset.y, dstLocs[j].z+dstOffset.z);
                 }
             }
-            if (src->layoutType->locations.size() == 0 && dst->layoutType->locations.size() > 0) {
-
-                 for (int j = 0; j <  dst->layoutType->locations.size(); ++j) {
-
-                    glLineWidth(1.5*lineScaleFactor);
-                    glColor4f(0.0, 0.0, 1.0, 0.2);
-                    // draw in
-                    glBegin(GL_LINES);
-                    glVertex3f(srcX, srcY, srcZ);
-                    glVertex3f(dst->layoutType->locations[j].x+dstX, dst->layoutType->locations[j].y+dstY, dst->layoutType->locations[j].z+dstZ);
-                    glEnd();
+            if (srcLocs.size() > 0 && dstLocs.size() == 0) {
+                connectionSampler sampler(srcLocs.size(), maxConns);
+                for (qint64 i = sampler.next(); i >= 0; i = sampler.next()) {
+                    appendVertex(vertices, srcLocs[i].x+srcOffset.x, srcLocs[i].y+srcOffset.y, srcLocs[i].z+srcOffset.z);
+                    appendVertex(vertices, dstOffset.x, dstOffset.y, dstOffset.z);
+                }
+            }
+            if (srcLocs.size() == 0 && dstLocs.size() > 0) {
+                connectionSampler sampler(dstLocs.size(), maxConns);
+                for (qint64 j = sampler.next(); j >= 0; j = sampler.next()) {
+                    appendVertex(vertices, srcOffset.x, srcOffset.y, srcOffset.z);
+                    appendVertex(vertices, dstLocs[j].x+dstOffset.x, dstLocs[j].y+dstOffset.y, dstLocs[j].z+dstOffset.z);
                 }
             }
         }
 
-        if (conn->type == FixedProb) {
-
-            fixedProb_connection * fpConn = dynamic_cast <fixedProb_connection *> (conn);
-            CHECK_CAST(fpConn)
-
-            random.setSeed(fpConn->seed);
-
-            prob = fpConn->p;
+        this->makeCurrent();
+        buffer.vertices.setVertices(vertices);
+        buffer.key = key;
+    }
 
-            // generate a list of projections to highlight
-            QVector < loc > redrawLocs;
+    glLineWidth(buffer.lineWidth*lineScaleFactor);
+    glColor4f(buffer.colour[0], buffer.colour[1], buffer.colour[2], buffer.colour[3]);
+    buffer.vertices.draw(buffer.mode);
 
-            for (int i = 0; i < src->layoutType->locations.size(); ++i) {
-                for (int j = 0; j <  dst->layoutType->locations.size(); ++j) {
-                    if (random.value() < this->prob) {
-                        glLineWidth(1.0*lineScaleFactor);
-                        glColor4f(0.0, 0.0, 0.0, 0.1);
-
-                        if (((int) i == selectedIndex && selectedType == 1) \
-                                || ((int) j == selectedIndex && selectedType == 2))
-                        {
-                            // store for redraw of selected connections
-                            loc pstart;
-                            loc pend;
-
-                            if ((src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() > 0) \
-                                    || (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() == 0)) {
-                                pstart.x = src->layoutType->locations[i].x+srcX;
-                                pstart.y = src->layoutType->locations[i].y+srcY;
-                                pstart.z = src->layoutType->locations[i].z+srcZ;
-                            }
-                            if (src->layoutType->locations.size() == 0 && dst->layoutType->locations.size() > 0) {
-                                pstart.x = srcX;
-                                pstart.y = srcY;
-                                pstart.z = srcZ;
-                            }
-                            if ((src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() > 0) \
-                                    || (src->layoutType->locations.size() == 0 && dst->layoutType->locations.size() > 0)) {
-                                pend.x = dst->layoutType->locations[j].x+dstX;
-                                pend.y = dst->layoutType->locations[j].y+dstY;
-                                pend.z = dst->layoutType->locations[j].z+dstZ;
-                            }
-                            if (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() == 0) {
-                                pend.x = dstX;
-                                pend.y = dstY;
-                                pend.z = dstZ;
-                            }
-                            redrawLocs.push_back(pstart);
-                            redrawLocs.push_back(pend);
-                        }
-                        else
-                        {
-                            // draw in
-                            glBegin(GL_LINES);
-                            if (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() > 0) {
-                                glVertex3f(src->layoutType->locations[i].x+srcX, src->layoutType->locations[i].y+srcY, src->layoutType->locations[i].z+srcZ);
-                                glVertex3f(dst->layoutType->locations[j].x+dstX, dst->layoutType->locations[j].y+dstY, dst->layoutType->locations[j].z+dstZ);
-                            }
-                            if (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() == 0) {
-                                glVertex3f(src->layoutType->locations[i].x+srcX, src->layoutType->locations[i].y+srcY, src->layoutType->locations[i].z+srcZ);
-                                glVertex3f(dstX, dstY, dstZ);
-                            }
-                            if (src->layoutType->locations.size() == 0 && dst->layoutType->locations.size() > 0) {
-                                glVertex3f(srcX, srcY, srcZ);
-                                glVertex3f(dst->layoutType->locations[j].x+dstX, dst->layoutType->locations[j].y+dstY, dst->layoutType->locations[j].z+dstZ);
-                            }
-                            glEnd();
-                        }
-                    }
-                }
-            }
-            // redraw selected (over the top of everything else so no depth test):
-            glDisable(GL_DEPTH_TEST);
+}
 
-            for (int i=0; i < redrawLocs.size(); i+=2) {
+void glConnectionWidget::drawNeuronConnections(int targNum, int neuron, bool outgoing, QSharedPointer <population> src, QSharedPointer <population> dst, loc3f srcOffset, loc3f dstOffset) {
 
-                // redraw
-                glLineWidth(1.5*lineScaleFactor);
-                glColor4f(0.0, 0.0, 1.0, 0.8);
-                glBegin(GL_LINES);
-                glVertex3f(redrawLocs[i].x, redrawLocs[i].y,redrawLocs[i].z);
-                glVertex3f(redrawLocs[i+1].x, redrawLocs[i+1].y,redrawLocs[i+1].z);
-                glEnd();
-            }
+    // look up the connections of the neuron in the index built with the vertices
+    const connectionIndex &index = connBuffers[selectedConns[targNum].data()].index;
+    const QVector <int> &starts = outgoing ? index.srcStart : index.dstStart;
+    const QVector <int> &conns = outgoing ? index.srcConns : index.dstConns;
 
+    if (neuron < 0 || neuron+1 >= starts.size())
+        return;
 
+    glBegin(GL_LINES);
+    for (int k = starts[neuron]; k < starts[neuron+1]; ++k) {
+        loc start;
+        loc end;
+        if (this->connectionEnds(targNum, conns[k], src, dst, srcOffset, dstOffset, start, end)) {
+            glVertex3f(start.x, start.y, start.z);
+            glVertex3f(end.x, end.y, end.z);
         }
+    }
+    glEnd();
 
+}
 
-        glEnable(GL_DEPTH_TEST);
-        glEnable(GL_LIGHTING);
+bool glConnectionWidget::connectionPopulations(QSharedPointer <systemObject> object, QSharedPointer <population> &src, QSharedPointer <population> &dst, connection * &conn) {
+
+    if (object->type == synapseObject) {
+        QSharedPointer <synapse> currTarg = qSharedPointerDynamicCast <synapse> (object);
+        CHECK_CAST(currTarg)
+        conn = currTarg->connectionType;
+        src = currTarg->proj->source;
+        dst = currTarg->proj->destination;
+        return true;
+    }
+    if (object->type == inputObject) {
+        QSharedPointer<genericInput> currIn = qSharedPointerDynamicCast<genericInput> (object);
+        CHECK_CAST(currIn)
+        conn = currIn->connectionType;
+        src = qSharedPointerDynamicCast <population> (currIn->source);
+        dst = qSharedPointerDynamicCast <population> (currIn->destination);
+        return src != NULL && dst != NULL;
     }
+    return false;
 
-    glDisable(GL_BLEND);
-    glDisable(GL_POLYGON_SMOOTH);
-    glDisable(GL_LINE_SMOOTH);
+}
 
-    glDisable(GL_DEPTH_TEST);
-    glShadeModel(GL_FLAT);
-    glDisable(GL_LIGHTING);
-    glDisable(GL_COLOR_MATERIAL);
+bool glConnectionWidget::pickNeuron(QPoint point, QSharedPointer <population> &pickedPop, int &pickedIndex) {
 
-    glMatrixMode(GL_MODELVIEW);
+    // nothing to pick in layout previews
+    if (!pickValid || locations.size() > 0)
+        return false;
 
+    // a ray through the point from the near to the far plane
+    GLdouble winX = point.x()*RETINA_SUPPORT;
+    GLdouble winY = pickViewport[3] - point.y()*RETINA_SUPPORT;
+    GLdouble nearX, nearY, nearZ;
+    GLdouble farX, farY, farZ;
+    if (gluUnProject(winX, winY, 0.0, pickModelview, pickProjection, pickViewport, &nearX, &nearY, &nearZ) == GL_FALSE)
+        return false;
+    if (gluUnProject(winX, winY, 1.0, pickModelview, pickProjection, pickViewport, &farX, &farY, &farZ) == GL_FALSE)
+        return false;
 
-    if (popIndicesShown) {
-        QPainter painter(this);
-        painter.setRenderHint(QPainter::Antialiasing);
+    float bestDistance = INFINITY;
+    bool found = false;
 
-        QPen pen = painter.pen();
-        QPen oldPen = pen;
-        pen.setColor(QColor(0,0,0,255));
-        painter.setPen(pen);
+    for (int locNum = 0; locNum < selectedPops.size(); ++locNum) {
 
-        float zoomVal = zoomFactor;
-        if (zoomVal < 0.3)
-            zoomVal = 0.3;
+        QSharedPointer <population> currPop = selectedPops[locNum];
+        if (currPop->layoutType->locations.size() == 0)
+            continue;
 
-        // draw text
-        for (int locNum = 0; locNum < selectedPops.size(); ++locNum) {
-            QSharedPointer <population> currPop = selectedPops[locNum];
-            for (int i = 0; i < currPop->layoutType->locations.size(); ++i) {
-                glPushMatrix();
+        loc3f offset;
+        if (currPop == selectedObject) {
+            offset = loc3Offset;
+        } else {
+            offset.x = currPop->loc3.x; offset.y = currPop->loc3.y; offset.z = currPop->loc3.z;
+        }
 
-                glTranslatef(currPop->layoutType->locations[i].x, currPop->layoutType->locations[i].y, currPop->layoutType->locations[i].z);
+        glSceneBuffer &buffer = popBuffers[currPop.data()];
+        if (buffer.grid.isEmpty())
+            buffer.grid.build(currPop->layoutType->locations, 0.5);
+
+        // the ray in the population's own coordinates
+        loc origin;
+        origin.x = nearX - offset.x; origin.y = nearY - offset.y; origin.z = nearZ - offset.z;
+        loc direction;
+        direction.x = farX - nearX; direction.y = farY - nearY; direction.z = farZ - nearZ;
+
+        float distance;
+        int index = buffer.grid.pick(origin, direction, &distance);
+        if (index >= 0 && distance < bestDistance) {
+            bestDistance = distance;
+            pickedPop = currPop;
+            pickedIndex = index;
+            found = true;
+        }
+    }
 
-                // if currently selected
-                if (currPop == selectedObject) {
-                    // move to pop location denoted by the spinboxes for x, y, z
-                    glTranslatef(loc3Offset.x, loc3Offset.y,loc3Offset.z);
-                } else {
-                    glTranslatef(currPop->loc3.x, currPop->loc3.y,currPop->loc3.z);
-                }
+    return found;
 
-                // print up text:
-                GLdouble modelviewMatrix[16];
-                GLdouble projectionMatrix[16];
-                GLint viewPort[4];
-                GLdouble winX;
-                GLdouble winY;
-                GLdouble winZ;
-                glGetIntegerv(GL_VIEWPORT, viewPort);
-                glGetDoublev(GL_MODELVIEW_MATRIX, modelviewMatrix);
-                glGetDoublev(GL_PROJECTION_MATRIX, projectionMatrix);
-                gluProject(0, 0, 0, modelviewMatrix, projectionMatrix, viewPort, &winX, &winY, &winZ);
+}
 
-                winX /= RETINA_SUPPORT;
-                winY /= RETINA_SUPPORT;
+void glConnectionWidget::neuronFans(QSharedPointer <population> pop, int index, int &fanIn, int &fanOut) {
 
-                if (orthoView) {
-                    winX += this->width()/4.0;
-                    winY -= this->height()/4.0;
-                }
+    fanIn = 0;
+    fanOut = 0;
 
-                if (imageSaveMode) {}
-                    //painter.drawText(QRect(winX-(1.0-winZ)*220-20,imageSaveHeight-winY-(1.0-winZ)*220-10,40,20),QString::number(float(i)));
-                else
-                    if (orthoView)
-                        painter.drawText(QRect(winX-(1.0-winZ)*220-10.0/zoomVal-10,this->height()-winY-(1.0-winZ)*220-10.0/zoomVal-10,40,20),QString::number(float(i)));
-                    else
-                        painter.drawText(QRect(winX-(1.0-winZ)*300-10.0/zoomVal,this->height()-winY-(1.0-winZ)*300-10.0/zoomVal,40,20),QString::number(float(i)));
-                    //painter.drawText(QRect(winX-(1.0-winZ)*600,this->height()-winY-(1.0-winZ)*600,40,20),QString::number(float(i)));
-                    //painter.drawText(QRect((winX-(1.0-winZ)*220-20),this->height()-(winY-(1.0-winZ)*220+50),40,20),QString::number(float(i)));
+    // count over the projections being shown, using their indices where they have them
+    for (int targNum = 0; targNum < selectedConns.size(); ++targNum) {
 
-                glPopMatrix();
+        QSharedPointer <population> src;
+        QSharedPointer <population> dst;
+        connection * conn;
+        if (!this->connectionPopulations(selectedConns[targNum], src, dst, conn))
+            continue;
+
+        if (conn->type == OnetoOne) {
+            if (src->numNeurons == dst->numNeurons) {
+                if (src == pop) ++fanOut;
+                if (dst == pop) ++fanIn;
             }
+            continue;
+        }
+        if (conn->type == AlltoAll) {
+            if (src == pop) fanOut += dst->numNeurons;
+            if (dst == pop) fanIn += src->numNeurons;
+            continue;
         }
-        painter.setPen(oldPen);
-        painter.end();
-    } else {
-        // if the painter isn't there this doesn't get called!
-        QPainter painter(this);
-        painter.setRenderHint(QPainter::Antialiasing);
-        painter.end();
-    }
 
-    glPopMatrix();
+        const connectionIndex * connIndex = NULL;
+        if (conn->type == FixedProb && fixedProbCache.contains(selectedConns[targNum].data()))
+            connIndex = &fixedProbCache[selectedConns[targNum].data()].index;
+        if ((conn->type == CSV || conn->type == Kernel || conn->type == Python) && connBuffers.contains(selectedConns[targNum].data()))
+            connIndex = &connBuffers[selectedConns[targNum].data()].index;
+        if (connIndex == NULL)
+            continue;
 
+        if (src == pop && index+1 < connIndex->srcStart.size())
+            fanOut += connIndex->srcStart[index+1] - connIndex->srcStart[index];
+        if (dst == pop && index+1 < connIndex->dstStart.size())
+            fanIn += connIndex->dstStart[index+1] - connIndex->dstStart[index];
+    }
 
 }
 
-void glConnectionWidget::drawNeuron(GLfloat r, int rings, int segments, QColor col) {
-
-    // draw a sphere to represent a neuron
-    int i, j;
-    for(i = 0; i <= rings; i++) {
-        double rings0 = M_PI * (-0.5 + (double) (i - 1) / rings);
-        double z0  = sin(rings0);
-        double zr0 =  cos(rings0);
-
-        double rings1 = M_PI * (-0.5 + (double) i / rings);
-        double z1 = sin(rings1);
-        double zr1 = cos(rings1);
-
-        glBegin(GL_QUAD_STRIP);
-        for(j = 0; j <= segments; j++) {
-            double segment = 2 * M_PI * (double) (j - 1) / segments;
-            double x = cos(segment);
-            double y = sin(segment);
-
-            glNormal3f(x * zr0, y * zr0, z0);
-            glColor4f(col.redF(), col.greenF(), col.blueF(), col.alphaF());
-            glVertex3f(x * zr0*r, y * zr0*r, z0*r);
-            glNormal3f(x * zr1, y * zr1, z1);
-            glColor4f(col.redF(), col.greenF(), col.blueF(), col.alphaF());
-            glVertex3f(x * zr1*r, y * zr1*r, z1*r);
-        }
-        glEnd();
+void glConnectionWidget::pruneFixedProbCache() {
+
+    // sampled connectivity is large, so only keep it for the projections being shown
+    QSet <systemObject *> shown;
+    for (int i = 0; i < selectedConns.size(); ++i)
+        shown.insert(selectedConns[i].data());
+
+    QList <systemObject *> cached = fixedProbCache.keys();
+    for (int i = 0; i < cached.size(); ++i) {
+        if (!shown.contains(cached[i]))
+            fixedProbCache.remove(cached[i]);
     }
 
 }
 
+void glConnectionWidget::invalidateScene() {
+
+    // layouts or connectivity may have been regenerated in place, so rebuild all the vertices
+    connBuffers.clear();
+    popBuffers.clear();
+
+}
+
 void glConnectionWidget::setupView() {
 
     int width;
@@ -892,11 +1355,23 @@ void glConnectionWidget::setupView() {
         height = this->height()*RETINA_SUPPORT;
     }
 
-    glViewport(0, 0, width, height);
+    if (imageSaveMode && !imageTile.isNull()) {
+        // draw only the tile, by stretching its part of the view over the whole viewport
+        glViewport(0, 0, imageTile.width(), imageTile.height());
+    } else {
+        glViewport(0, 0, width, height);
+    }
 
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
 
+    if (imageSaveMode && !imageTile.isNull()) {
+        float centreX = float(2*imageTile.x() + imageTile.width())/float(width) - 1.0f;
+        float centreY = float(2*imageTile.y() + imageTile.height())/float(height) - 1.0f;
+        glScalef(float(width)/float(imageTile.width()), float(height)/float(imageTile.height()), 1.0f);
+        glTranslatef(-centreX, -centreY, 0.0f);
+    }
+
     // move view
     if (!orthoView)
         gluPerspective(60.0,((GLfloat)width)/((GLfloat)height), 1.0, 100000.0);
@@ -1169,7 +1644,7 @@ void glConnectionWidget::typeChanged(int) {
 
     }
 
-
+    this->invalidateScene();
 
     // redraw
     this->repaint();
@@ -1193,10 +1668,12 @@ void glConnectionWidget::parsChangedPopulation(int value) {
 
             // invalidate logs as size of pop has changed
             popLogs[i] = NULL;
-            popColours[i].clear();
+            popColourIndices[i].clear();
         }
     }
 
+    this->invalidateScene();
+
     // redraw
     this->repaint();
 
@@ -1218,6 +1695,8 @@ void glConnectionWidget::parsChangedPopulation(double) {
             }
         }
     }
+    this->invalidateScene();
+
     // redraw
     this->repaint();
 
@@ -1241,6 +1720,8 @@ void glConnectionWidget::parsChangedPopulation() {
         }
     }
 
+    this->invalidateScene();
+
     // redraw
     this->repaint();
 
@@ -1301,6 +1782,8 @@ void glConnectionWidget::parsChangedProjections() {
     }
 
 
+    this->invalidateScene();
+
     // redraw:
     repaint();
 
@@ -1395,6 +1878,8 @@ void glConnectionWidget::parsChangedProjection() {
         }
 
 
+        this->invalidateScene();
+
         // redraw:
         repaint();
 
@@ -1413,7 +1898,7 @@ void glConnectionWidget::refreshAll() {
             // remove
             selectedPops.erase(selectedPops.begin()+i);
             popLogs.erase(popLogs.begin()+i);
-            popColours.erase(popColours.begin()+i);
+            popColourIndices.erase(popColourIndices.begin()+i);
             --i;
             continue;
         }*/
@@ -1425,7 +1910,7 @@ void glConnectionWidget::refreshAll() {
             // remove
             selectedPops.erase(selectedPops.begin()+i);
             popLogs.erase(popLogs.begin()+i);
-            popColours.erase(popColours.begin()+i);
+            popColourIndices.erase(popColourIndices.begin()+i);
             --i;
             continue;
         }
@@ -1467,6 +1952,9 @@ void glConnectionWidget::refreshAll() {
 
     }
 
+    this->pruneFixedProbCache();
+    this->invalidateScene();
+
 }
 
 
@@ -1485,6 +1973,7 @@ void glConnectionWidget::drawLocations(QVector <loc> locs) {
     locations.clear();
 
     this->locations.push_back(locs);
+    previewBuffer.key.clear();
 
     // redraw
     this->repaint();
@@ -1529,10 +2018,21 @@ void glConnectionWidget::getConnections() {
         }
     }
 
+    this->invalidateScene();
+
     // force a redraw
     repaint();
 }
 
+void glConnectionWidget::showPopulation(QSharedPointer <population> pop) {
+
+    selectedPops.push_back(pop);
+    popLogs.push_back(NULL);
+    popColourIndices.resize(popColourIndices.size()+1);
+    this->invalidateScene();
+
+}
+
 void glConnectionWidget::sysSelectionChanged(QModelIndex, QModelIndex) {
 
     // this is fired when an item is checked or unchecked
@@ -1559,9 +2059,7 @@ void glConnectionWidget::sysSelectionChanged(QModelIndex, QModelIndex) {
                         //this->data->statusBarUpdate(errs,2000);
                     }
                 }
-                selectedPops.push_back(currPop);
-                popLogs.push_back(NULL);
-                popColours.resize(popColours.size()+1);
+                this->showPopulation(currPop);
             }
         } else {
             // if in list then remove from list
@@ -1569,7 +2067,7 @@ void glConnectionWidget::sysSelectionChanged(QModelIndex, QModelIndex) {
                 if (selectedPops[p] == currPop) {
                     selectedPops.erase(selectedPops.begin()+p);
                     popLogs.erase(popLogs.begin()+p);
-                    popColours.erase(popColours.begin()+p);
+                    popColourIndices.erase(popColourIndices.begin()+p);
                     // clear location data
                     currPop->layoutType->locations.clear();
                 }
@@ -1720,6 +2218,9 @@ void glConnectionWidget::sysSelectionChanged(QModelIndex, QModelIndex) {
     // check for logs:
     addLogs(&data->main->viewGV.properties->logs);
 
+    this->pruneFixedProbCache();
+    this->invalidateScene();
+
     // force redraw!
     this->repaint();
 
@@ -1737,7 +2238,18 @@ void glConnectionWidget::connectionSelectionChanged(QItemSelection, QItemSelecti
     this->selectedIndex = 0;
     this->selectedType = 4;
 
-    this->selection = ((QItemSelectionModel *) sender())->selectedIndexes();
+    // keep the selection as sets of rows, so drawing doesn't search it
+    QModelIndexList selection = ((QItemSelectionModel *) sender())->selectedIndexes();
+    selectedRows.clear();
+    selectedSrcRows.clear();
+    selectedDstRows.clear();
+    for (int i = 0; i < selection.count(); ++i) {
+        selectedRows.insert(selection[i].row());
+        if (selection[i].column() == 0)
+            selectedSrcRows.insert(selection[i].row());
+        if (selection[i].column() == 1)
+            selectedDstRows.insert(selection[i].row());
+    }
     // force redraw
     repaint();
 
@@ -1747,6 +2259,7 @@ void glConnectionWidget::mousePressEvent(QMouseEvent *event){
 
     setCursor(Qt::ClosedHandCursor);
     button = event->button();
+    pressPos = event->pos();
     origPos = event->globalPos();
     origPos.setX(origPos.x() - pos.x()*100/zoomFactor);
     origPos.setY(origPos.y() + pos.y()*100/zoomFactor);
@@ -1756,12 +2269,51 @@ void glConnectionWidget::mousePressEvent(QMouseEvent *event){
 
 }
 
-void glConnectionWidget::mouseReleaseEvent(QMouseEvent *){
+void glConnectionWidget::mouseReleaseEvent(QMouseEvent *event){
     setCursor(Qt::ArrowCursor);
+
+    // a click without a drag on a neuron of the selected projection shows that neuron's connections
+    if (button == Qt::LeftButton && (event->pos() - pressPos).manhattanLength() < 3 && selectedObject != NULL) {
+        QSharedPointer <population> src;
+        QSharedPointer <population> dst;
+        connection * conn;
+        QSharedPointer <population> pop;
+        int index;
+        if (this->connectionPopulations(selectedObject, src, dst, conn) && this->pickNeuron(event->pos(), pop, index)) {
+            if (pop == src && !(pop == dst && selectedType == 2)) {
+                selectedType = 1;
+            } else if (pop == dst) {
+                selectedType = 2;
+            }
+            if (pop == src || pop == dst) {
+                selectedIndex = index;
+                emit currElement(selectedType, selectedIndex);
+                repaint();
+            }
+        }
+    }
+
+    button = Qt::NoButton;
 }
 
 void glConnectionWidget::mouseMoveEvent(QMouseEvent *event){
 
+    // hovering - show the neuron under the pointer
+    if (button == Qt::NoButton) {
+        QSharedPointer <population> pop;
+        int index;
+        if (this->pickNeuron(event->pos(), pop, index)) {
+            int fanIn;
+            int fanOut;
+            this->neuronFans(pop, index, fanIn, fanOut);
+            QToolTip::showText(event->globalPos(), pop->getName() + " neuron " + QString::number(index) \
+                               + "\nFan-in: " + QString::number(fanIn) + "  Fan-out: " + QString::number(fanOut), this);
+        } else {
+            QToolTip::hideText();
+        }
+        return;
+    }
+
     if (button == Qt::LeftButton) {
         pos.setX(-(origPos.x() - event->globalPos().x())*0.01*zoomFactor);
         pos.setY((origPos.y() - event->globalPos().y())*0.01*zoomFactor);
@@ -1807,62 +2359,48 @@ void glConnectionWidget::selectedNrnChanged(int index) {
 
 }
 
-#if QT_VERSION > QT_VERSION_CHECK(5, 0, 0)
-QImage glConnectionWidget:: renderQImage(int w, int h)
-{
-    // Set the rendering engine to the size of the image to render
-    // Also set the format so that the depth buffer will work
-    QOpenGLFramebufferObjectFormat format;
-    format.setAttachment(QOpenGLFramebufferObject::Depth);
-    QOpenGLFramebufferObject qfb(w,h,format);
-    qfb.bind();
-    // If the frame buffer does not work then return an empty image
-    if(!qfb.isValid()) return(QImage());
-    resizeGL(w,h);
-    // Draw the scene to the buffer
-    glEnable(GL_MULTISAMPLE);
-    this->repaint();
-    qfb.release();
-    resizeGL(width(),height());
-    return(qfb.toImage());
-}
-#endif
-
-QPixmap glConnectionWidget::renderImage(int width, int height) {
+QImage glConnectionWidget::renderTiled(int width, int height, tiffWriter * writer) {
 
-    QPixmap pix;
-    imageSaveHeight = height;
-    imageSaveWidth = width;
-    imageSaveMode = true;
+    QImage image;
+    if (width < 1 || height < 1)
+        return image;
 
-// renderPixmap is broken in Qt > 5.0 - this fix doesn't currently work correctly, but is better than nothing
-#if QT_VERSION > QT_VERSION_CHECK(5, 0, 0)
-    QImage img = renderQImage(width, height);
+    this->makeCurrent();
 
-    if (img.isNull()) {
-        qDebug() << "renderQimage returned a dud";
+    // the image is drawn a tile at a time, so its size isn't limited by the card
+    QSettings settings;
+    int tileSize = settings.value("glOptions/exportTileSize", 1024).toInt();
+    GLint maxSize[2];
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxSize);
+    tileSize = qBound(64, tileSize, (int) qMin(maxSize[0], maxSize[1]));
+
+    QGLFramebufferObject fbo(tileSize, tileSize, QGLFramebufferObject::Depth);
+    if (!fbo.isValid()) {
+        qDebug() << "Could not create a framebuffer for rendering the image";
+        return image;
     }
 
-    pix = QPixmap::fromImage(img);
-#else
+    imageSaveHeight = height;
+    imageSaveWidth = width;
+    imageSaveMode = true;
+    imageTile = QRect();
 
-   pix = this->renderPixmap(width, height);
-#endif
+    // place the labels using the view of the whole image, then draw them onto each band of tiles
+    QVector <QRect> labelRects;
+    QStringList labelTexts;
+    if (popIndicesShown) {
 
-    QPainter painter(&pix);
-    painter.setRenderHint(QPainter::Antialiasing);
-    QFont font = painter.font();
-    font.setPointSizeF(font.pointSizeF()*((float) width)/((float) this->width()));
-    painter.setFont(font);
-    painter.setPen(QColor(100,100,100));
+        setupView();
+        glLoadIdentity();
 
-    setupView();
+        GLint viewPort[4] = {0, 0, width, height};
+        GLdouble modelviewMatrix[16];
+        GLdouble projectionMatrix[16];
+        glGetDoublev(GL_PROJECTION_MATRIX, projectionMatrix);
 
-    glPushMatrix();
-    glTranslatef(0,0,-5.0);
+        glPushMatrix();
+        glTranslatef(0,0,-5.0);
 
-    if (popIndicesShown) {
-        // draw text
         for (int locNum = 0; locNum < selectedPops.size(); ++locNum) {
             QSharedPointer <population> currPop = selectedPops[locNum];
             for (int i = 0; i < currPop->layoutType->locations.size(); ++i) {
@@ -1878,30 +2416,113 @@ QPixmap glConnectionWidget::renderImage(int width, int height) {
                     glTranslatef(currPop->loc3.x, currPop->loc3.y,currPop->loc3.z);
                 }
 
-                // print up text:
-                GLdouble modelviewMatrix[16];
-                GLdouble projectionMatrix[16];
-                GLint viewPort[4];
                 GLdouble winX;
                 GLdouble winY;
                 GLdouble winZ;
-                glGetIntegerv(GL_VIEWPORT, viewPort);
                 glGetDoublev(GL_MODELVIEW_MATRIX, modelviewMatrix);
-                glGetDoublev(GL_PROJECTION_MATRIX, projectionMatrix);
                 gluProject(0, 0, 0, modelviewMatrix, projectionMatrix, viewPort, &winX, &winY, &winZ);
 
-                painter.drawText(QRect(winX-(1.0-winZ)*220-(20.0)*(float(width)/500.0),height-winY-(1.0-winZ)*220-10*(float(width)/500.0),40*(float(width)/500.0),20*(float(width)/500.0)),QString::number(float(i)));
+                labelRects.push_back(QRect(winX-(1.0-winZ)*220-(20.0)*(float(width)/500.0),height-winY-(1.0-winZ)*220-10*(float(width)/500.0),40*(float(width)/500.0),20*(float(width)/500.0)));
+                labelTexts.push_back(QString::number(float(i)));
 
                 glPopMatrix();
             }
         }
+
+        glPopMatrix();
+    }
+
+    // without a writer the bands are gathered into one image
+    QPainter imagePainter;
+    if (writer == NULL) {
+        image = QImage(width, height, QImage::Format_ARGB32);
+        image.fill(0);
+        imagePainter.begin(&image);
+        imagePainter.setCompositionMode(QPainter::CompositionMode_Source);
+    }
+
+    fbo.bind();
+
+    for (int bandTop = 0; bandTop < height; bandTop += tileSize) {
+
+        int bandHeight = qMin(tileSize, height - bandTop);
+        QImage band(width, bandHeight, QImage::Format_ARGB32);
+        band.fill(0);
+
+        QPainter painter(&band);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+
+        for (int left = 0; left < width; left += tileSize) {
+
+            int tileWidth = qMin(tileSize, width - left);
+
+            // GL counts rows up from the bottom of the image
+            imageTile = QRect(left, height - bandTop - bandHeight, tileWidth, bandHeight);
+            this->drawScene();
+
+            // the tile is in the bottom left of the framebuffer
+            QImage tile = fbo.toImage();
+            painter.drawImage(QPoint(left, 0), tile, QRect(0, tileSize - bandHeight, tileWidth, bandHeight));
+        }
+
+        if (labelRects.size() > 0) {
+            painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+            painter.setRenderHint(QPainter::Antialiasing);
+            QFont font = painter.font();
+            font.setPointSizeF(font.pointSizeF()*((float) width)/((float) this->width()));
+            painter.setFont(font);
+            painter.setPen(QColor(100,100,100));
+            painter.translate(0, -bandTop);
+            for (int i = 0; i < labelRects.size(); ++i) {
+                if (labelRects[i].bottom() >= bandTop && labelRects[i].top() < bandTop + bandHeight)
+                    painter.drawText(labelRects[i], labelTexts[i]);
+            }
+        }
         painter.end();
+
+        if (writer == NULL) {
+            imagePainter.drawImage(0, bandTop, band);
+        } else if (!writer->writeRows(band)) {
+            break;
+        }
     }
 
-    glPopMatrix();
+    fbo.release();
 
+    if (imagePainter.isActive())
+        imagePainter.end();
+
+    imageTile = QRect();
     imageSaveMode = false;
-    //QImage image = pix.toImage();
-    return pix;
+
+    // put the widget's own view back
+    this->update();
+
+    return image;
+
+}
+
+QPixmap glConnectionWidget::renderImage(int width, int height) {
+
+    QImage img = this->renderTiled(width, height);
+
+    if (img.isNull()) {
+        qDebug() << "renderTiled returned a dud";
+    }
+
+    return QPixmap::fromImage(img);
+
+}
+
+bool glConnectionWidget::saveImage(int width, int height, QString fileName) {
+
+    // stream the image to disk a band at a time, so it never needs to be held in memory
+    tiffWriter writer;
+    if (!writer.open(fileName, width, height))
+        return false;
+
+    this->renderTiled(width, height, &writer);
+
+    return writer.close();
 
 }
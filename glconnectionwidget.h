@@ -27,6 +27,11 @@
 
 #include "globalHeader.h"
 #include "logdata.h"
+#include "glvertexbuffer.h"
+#include "framescheduler.h"
+#include "neurongrid.h"
+#include "tiffwriter.h"
+#include "logcolourframes.h"
 
 class RNG
 {
@@ -62,11 +67,44 @@ struct loc3f {
     float z;
 };
 
+// connections grouped by source and by destination neuron (as compressed rows of connection
+// indices), so the connections of one neuron can be found without a scan
+struct connectionIndex {
+    QVector <int> srcStart;
+    QVector <int> srcConns;
+    QVector <int> dstStart;
+    QVector <int> dstConns;
+};
+
+// connections sampled for a fixed probability projection, and a key of what they were sampled from
+struct fixedProbEdges {
+    QByteArray key;
+    QVector <conn> edges;
+    connectionIndex index;
+};
+
+// vertices kept for drawing neurons or a projection, and a key describing what they were built from
+struct glSceneBuffer {
+    glVertexBuffer vertices;
+    QByteArray key;
+    GLenum mode;
+    GLfloat colour[4];
+    float lineWidth;
+    // bounding sphere of the vertices
+    loc centre;
+    float radius;
+    // for explicit lists
+    connectionIndex index;
+    // for picking neurons, built when first needed
+    neuronGrid grid;
+};
+
 class glConnectionWidget : public QGLWidget
 {
     Q_OBJECT
 public:
     explicit glConnectionWidget(rootData * data, QWidget *parent = 0);
+    ~glConnectionWidget();
     QVector <QSharedPointer <population> > selectedPops;
     QVector < popLocs> pops;
     QVector <QSharedPointer<systemObject> > selectedConns;
@@ -82,21 +120,43 @@ public:
     bool popIndicesShown;
     void clear();
     QPixmap renderImage(int, int);
+    bool saveImage(int width, int height, QString fileName);
     void addLogs(QVector<logData *> *logs);
     void refreshAll();
+    void showPopulation(QSharedPointer <population> pop);
+    frameScheduler * frameTiming() {return scheduler;}
 
 private:
-    void drawNeuron(GLfloat, int, int, QColor);
+    glVertexBuffer &sphereMesh(int LoD);
+    void updateNeuronBuffer(glSceneBuffer &buffer, const QVector <loc> &locs);
+    float neuronScreenRadius(const glSceneBuffer &buffer);
+    void bindColourMap();
+    void releaseColourMap();
+    void drawNeurons(glSceneBuffer &buffer, const QVector <loc> &locs, const QVector <quint8> &colourIndices, QColor colour, int quality, int maxQuads);
+    bool connectionEnds(int targNum, int i, QSharedPointer <population> src, QSharedPointer <population> dst, loc3f srcOffset, loc3f dstOffset, loc &start, loc &end);
+    void drawNeuronConnections(int targNum, int neuron, bool outgoing, QSharedPointer <population> src, QSharedPointer <population> dst, loc3f srcOffset, loc3f dstOffset);
+    void drawConnectionBuffer(int targNum, QSharedPointer <population> src, QSharedPointer <population> dst, connection * currConn, loc3f srcOffset, loc3f dstOffset, float lineScaleFactor);
+    void invalidateScene();
+    void pruneFixedProbCache();
+    bool connectionPopulations(QSharedPointer <systemObject> object, QSharedPointer <population> &src, QSharedPointer <population> &dst, connection * &conn);
+    bool pickNeuron(QPoint point, QSharedPointer <population> &pickedPop, int &pickedIndex);
+    void neuronFans(QSharedPointer <population> pop, int index, int &fanIn, int &fanOut);
     void setupView();
+    void drawScene();
+    QImage renderTiled(int width, int height, tiffWriter * writer = NULL);
     QString currentObjectName;
     QAbstractTableModel * model;
     QAbstractItemModel * sysModel;
-    QModelIndexList selection;
+    // connection table selection - all selected rows, and rows selected in the src and dst columns
+    QSet <int> selectedRows;
+    QSet <int> selectedSrcRows;
+    QSet <int> selectedDstRows;
     float zoomFactor;
     QPointF pos;
     QPointF rot;
     QPointF origPos;
     QPointF origRot;
+    QPoint pressPos;
     Qt::MouseButton button;
     connectionType currProjectionType;
     RNG random;
@@ -110,16 +170,29 @@ private:
     bool imageSaveMode;
     int imageSaveWidth;
     int imageSaveHeight;
-    QVector < QVector < QColor > > popColours;
+    // part of the image being drawn when exporting in tiles (in GL coordinates), or null for all of it
+    QRect imageTile;
+    QVector < QVector < quint8 > > popColourIndices;
     QVector < logData * > popLogs;
+    // colours of the logged neurons, precomputed for upcoming times
+    QHash <logData *, logColourFrames *> logFrames;
+    GLuint colourMapTexture;
     int currentLogTime;
     int newLogTime;
     QTimer timer;
     bool orthoView;
-    bool repaintAllowed;
-#if QT_VERSION > QT_VERSION_CHECK(5, 0, 0)
-    QImage renderQImage(int w, int h);
-#endif
+    frameScheduler * scheduler;
+    // retained geometry - rebuilt only when layouts or connectivity change
+    QMap <int, glVertexBuffer> sphereMeshes;
+    QHash <systemObject *, glSceneBuffer> connBuffers;
+    QHash <population *, glSceneBuffer> popBuffers;
+    glSceneBuffer previewBuffer;
+    QHash <systemObject *, fixedProbEdges> fixedProbCache;
+    // the view of the last frame, for picking
+    GLdouble pickModelview[16];
+    GLdouble pickProjection[16];
+    GLint pickViewport[4];
+    bool pickValid;
 
 signals:
     void currElement(int type, int index);
@@ -148,7 +221,6 @@ public slots:
     void updateLogDataTime(int index);
     void updateLogData();
     void toggleOrthoView(bool);
-    void allowRepaint();
 
 protected:
     void initializeGL();
@@ -0,0 +1,160 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "glvertexbuffer.h"
+
+glVertexBuffer::glVertexBuffer()
+{
+    vertices = 0;
+    normals = false;
+    colours = false;
+    colourIndices = false;
+    bound = false;
+}
+
+void glVertexBuffer::setVertices(const QVector <GLfloat> &data, bool withNormals) {
+
+    normals = withNormals;
+    vertices = data.size() / (normals ? 6 : 3);
+    clientData.clear();
+
+    if (!buffer.isCreated()) {
+        buffer.setUsagePattern(QGLBuffer::StaticDraw);
+        buffer.create();
+    }
+
+    if (buffer.isCreated()) {
+        buffer.bind();
+        buffer.allocate(data.constData(), data.size() * sizeof(GLfloat));
+        buffer.release();
+    } else {
+        // no buffer objects - keep a (shared) copy to draw from
+        clientData = data;
+    }
+
+}
+
+void glVertexBuffer::clear() {
+
+    if (buffer.isCreated())
+        buffer.destroy();
+    clientData.clear();
+    vertices = 0;
+
+}
+
+void glVertexBuffer::bind() {
+
+    const GLfloat * base = NULL;
+    if (buffer.isCreated())
+        buffer.bind();
+    else
+        base = clientData.constData();
+
+    // with a buffer bound the pointers are offsets into it
+    GLsizei stride = normals ? 6 * sizeof(GLfloat) : 0;
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, base);
+    if (normals) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, stride, base + 3);
+    }
+
+    bound = true;
+
+}
+
+void glVertexBuffer::release() {
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    if (normals)
+        glDisableClientState(GL_NORMAL_ARRAY);
+    if (colours)
+        glDisableClientState(GL_COLOR_ARRAY);
+    colours = false;
+    if (colourIndices)
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    colourIndices = false;
+    if (buffer.isCreated())
+        buffer.release();
+
+    bound = false;
+
+}
+
+void glVertexBuffer::setColourArray(const GLubyte * rgba) {
+
+    // per vertex colours change often so they are passed from memory - the buffer is unbound
+    // first so the pointer isn't taken as an offset into it (the vertex pointers set in bind()
+    // keep using the buffer)
+    if (buffer.isCreated())
+        buffer.release();
+
+    if (rgba) {
+        glEnableClientState(GL_COLOR_ARRAY);
+        glColorPointer(4, GL_UNSIGNED_BYTE, 0, rgba);
+        colours = true;
+    } else {
+        glDisableClientState(GL_COLOR_ARRAY);
+        colours = false;
+    }
+
+}
+
+void glVertexBuffer::setColourIndexArray(const GLshort * indices) {
+
+    // as setColourArray, but one texture coordinate per vertex for looking colours up in a 1D
+    // texture - half the size of colours to pass each frame
+    if (buffer.isCreated())
+        buffer.release();
+
+    if (indices) {
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(1, GL_SHORT, 0, indices);
+        colourIndices = true;
+    } else {
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        colourIndices = false;
+    }
+
+}
+
+void glVertexBuffer::draw(GLenum mode, int first, int num) {
+
+    if (num < 0)
+        num = vertices - first;
+    if (num <= 0)
+        return;
+
+    // bind for just this draw if not already bound
+    bool wasBound = bound;
+    if (!wasBound)
+        this->bind();
+
+    glDrawArrays(mode, first, num);
+
+    if (!wasBound)
+        this->release();
+
+}
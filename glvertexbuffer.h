@@ -0,0 +1,61 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef GLVERTEXBUFFER_H
+#define GLVERTEXBUFFER_H
+
+#include "globalHeader.h"
+
+/*!
+ * \brief The glVertexBuffer class
+ * A block of vertices, optionally interleaved with normals, uploaded once into a GL buffer object
+ * so it can be drawn again and again with a single call. Where buffer objects aren't available
+ * the vertices are kept in memory and drawn from client side arrays instead. The GL context the
+ * buffer was filled in must be current when it is used.
+ */
+class glVertexBuffer
+{
+public:
+    glVertexBuffer();
+    void setVertices(const QVector <GLfloat> &data, bool withNormals = false);
+    void clear();
+    int count() const {return vertices;}
+    bool isEmpty() const {return vertices == 0;}
+    void bind();
+    void release();
+    void setColourArray(const GLubyte * rgba);
+    void setColourIndexArray(const GLshort * indices);
+    void draw(GLenum mode, int first = 0, int num = -1);
+
+private:
+    QGLBuffer buffer;
+    QVector <GLfloat> clientData;
+    int vertices;
+    bool normals;
+    bool colours;
+    bool colourIndices;
+    bool bound;
+};
+
+#endif // GLVERTEXBUFFER_H
@@ -24,10 +24,47 @@
 
 #include "layouteditpreviewdialog.h"
 
+layoutPreviewJob::layoutPreviewJob(QSharedPointer<NineMLLayoutData> data, int numNeurons, int generation, layoutEditPreviewDialog * owner)
+{
+    this->data = data;
+    this->numNeurons = numNeurons;
+    this->generation = generation;
+    this->owner = owner;
+}
+
+void layoutPreviewJob::run()
+{
+    // superseded before we started
+    if (this->isCancelled()) {
+        return;
+    }
+
+    QVector <loc> locations;
+    QString err;
+    this->data->generateLayout(this->numNeurons, &locations, err, this);
+
+    QMetaObject::invokeMethod(this->owner, "layoutReady", Qt::QueuedConnection, Q_ARG(QVector <loc>, locations), Q_ARG(int, this->generation), Q_ARG(bool, true), Q_ARG(QString, err));
+}
+
+bool layoutPreviewJob::isCancelled()
+{
+    return this->owner->currentGeneration() != this->generation;
+}
+
+void layoutPreviewJob::partialLayout(const QVector <loc> &locations)
+{
+    QMetaObject::invokeMethod(this->owner, "layoutReady", Qt::QueuedConnection, Q_ARG(QVector <loc>, locations), Q_ARG(int, this->generation), Q_ARG(bool, false), Q_ARG(QString, QString()));
+}
+
 layoutEditPreviewDialog::layoutEditPreviewDialog(QSharedPointer<NineMLLayout> inSrcNineMLLayout, glConnectionWidget * glConn, QWidget *parent) :
-    QDialog(parent)
+    QDialog(parent), generation(0)
 {
 
+    qRegisterMetaType < QVector <loc> > ("QVector<loc>");
+
+    // one preview at a time - a new job waits for the cancelled one to stop
+    pool.setMaxThreadCount(1);
+
     srcNineMLLayout = inSrcNineMLLayout;
     glView = glConn;
     QObject::connect(this, SIGNAL(drawLayout(QVector <loc>)), glView, SLOT(drawLocations(QVector <loc>)));
@@ -108,11 +145,28 @@ layoutEditPreviewDialog::layoutEditPreviewDialog(QSharedPointer<NineMLLayout> in
     numNeurons->setValue(100.0);
 }
 
+layoutEditPreviewDialog::~layoutEditPreviewDialog() {
+
+    // cancel the preview in progress and wait for it, as it refers to us
+    this->generation.fetchAndAddOrdered(1);
+    this->pool.waitForDone();
+
+}
+
+int layoutEditPreviewDialog::currentGeneration() {
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+    return (int) this->generation;
+#else
+    return this->generation.loadAcquire();
+#endif
+}
+
 void layoutEditPreviewDialog::reDraw(QString) {
 
-    // create a new layoutData from the layout:
+    // create a new layoutData from a copy of the layout, as the job runs while it is edited:
 
-    QSharedPointer<NineMLLayoutData> data = QSharedPointer<NineMLLayoutData> (new NineMLLayoutData(srcNineMLLayout));
+    QSharedPointer<NineMLLayout> layoutCopy = QSharedPointer<NineMLLayout> (new NineMLLayout(srcNineMLLayout));
+    QSharedPointer<NineMLLayoutData> data = QSharedPointer<NineMLLayoutData> (new NineMLLayoutData(layoutCopy));
 
     // populate from the spinboxes:
     for (int i = 0; i < data->ParameterList.size(); ++i) {
@@ -152,20 +206,32 @@ void layoutEditPreviewDialog::reDraw(QString) {
     }
 
 
-    // ok, data is filled in, now to get the locations
-    QVector <loc> locations;
+    // ok, data is filled in, now get the locations in the background - this cancels any
+    // preview that is still being generated
+    int next = this->generation.fetchAndAddOrdered(1) + 1;
+    this->setWindowTitle("Preview layout (generating...)");
+    this->pool.start(new layoutPreviewJob(data, numNeurons, next, this));
 
-    QString err;
-    data->generateLayout(numNeurons, &locations, err);
-
-    if (err.size() == 0) {
-        emit drawLayout(locations);
-    } else
-    {
-        emit drawLayout(locations);
-        QMessageBox msgBox;
-        msgBox.setText(err);
-        msgBox.exec();
+}
+
+void layoutEditPreviewDialog::layoutReady(QVector <loc> locations, int generation, bool finished, QString err) {
+
+    // ignore anything from a cancelled preview
+    if (generation != this->currentGeneration()) {
+        return;
+    }
+
+    emit drawLayout(locations);
+
+    if (finished) {
+        this->setWindowTitle("Preview layout");
+        if (err.size() != 0) {
+            QMessageBox msgBox;
+            msgBox.setText(err);
+            msgBox.exec();
+        }
+    } else {
+        this->setWindowTitle("Preview layout (" + QString::number(locations.size()) + " placed...)");
     }
 
 }
@@ -26,27 +26,58 @@
 #define LAYOUTEDITPREVIEWDIALOG_H
 
 #include <QDialog>
+#include <QRunnable>
+#include <QThreadPool>
 #include "globalHeader.h"
 #include "nineml_layout_classes.h"
 #include "glconnectionwidget.h"
 
+class layoutEditPreviewDialog;
+
+/*!
+ * \brief The layoutPreviewJob class
+ * Generates a preview layout on the dialog's thread pool, passing partial layouts back to the
+ * dialog as they are placed. The job is cancelled as soon as the dialog starts a newer one.
+ * It works on its own copy of the layout, which the editor can change while it runs.
+ */
+class layoutPreviewJob : public QRunnable, public layoutProgress
+{
+public:
+    layoutPreviewJob(QSharedPointer<NineMLLayoutData> data, int numNeurons, int generation, layoutEditPreviewDialog * owner);
+    void run();
+    bool isCancelled();
+    void partialLayout(const QVector <loc> &locations);
+
+private:
+    QSharedPointer<NineMLLayoutData> data;
+    int numNeurons;
+    int generation;
+    layoutEditPreviewDialog * owner;
+};
+
 class layoutEditPreviewDialog : public QDialog
 {
     Q_OBJECT
 public:
     explicit layoutEditPreviewDialog(QSharedPointer<NineMLLayout>, glConnectionWidget *glConn, QWidget *parent = 0);
+    ~layoutEditPreviewDialog();
+
+    // the preview being generated - jobs from earlier generations are stale. Read by the jobs
+    QAtomicInt generation;
+    int currentGeneration();
 
-    
 private:
     QSharedPointer<NineMLLayout> srcNineMLLayout;
     QFormLayout * contentLayoutRef;
     glConnectionWidget * glView;
+    QThreadPool pool;
 
 signals:
     void drawLayout(QVector <loc>);
     
 public slots:
     void reDraw(QString);
+    void layoutReady(QVector <loc> locations, int generation, bool finished, QString err);
     
 };
 
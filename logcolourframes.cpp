@@ -0,0 +1,178 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "logcolourframes.h"
+#include <climits>
+
+void logFrameJob::run() {
+
+    owner->fill();
+
+}
+
+logColourFrames::logColourFrames(logData * log, int numNeurons) : foreground(log), background(log)
+{
+    this->numNeurons = numNeurons;
+    min = log->getMin();
+    max = log->getMax();
+
+    ring.resize(LOG_FRAME_RING_SIZE);
+    ringTimes.fill(-1, LOG_FRAME_RING_SIZE);
+    playhead = 0;
+    endRow = INT_MAX;
+    jobRunning = false;
+    cancelled = false;
+
+    pool.setMaxThreadCount(1);
+}
+
+logColourFrames::~logColourFrames()
+{
+    mutex.lock();
+    cancelled = true;
+    mutex.unlock();
+    pool.waitForDone();
+}
+
+const QVector <QRgb> &logColourFrames::colourMap() {
+
+    // black through red and yellow to white
+    static QVector <QRgb> map;
+    if (map.isEmpty()) {
+        map.resize(256);
+        for (int i = 0; i < 256; ++i) {
+            int val = i*3;
+            // complete the remap in just 4 ternarys
+            int val3 = val > 511 ? val-512 : 0;
+            int val2 = val3 > 0 ? 511 : val;
+            val2 = val2 > 255 ? val2 - 256 : 0;
+            int val1 = val < 255 ? val : 255;
+            map[i] = qRgb(val1, val2, val3);
+        }
+    }
+    return map;
+
+}
+
+bool logColourFrames::quantise(const QVector <double> &row, QVector <quint8> &indices) const {
+
+    // data not usable
+    if (row.size() == 0 || row.size() > numNeurons)
+        return false;
+
+    // neurons without data are black, as is everything if the log is flat
+    indices.fill(0, numNeurons);
+    if (max - min == 0)
+        return true;
+
+    for (int j = 0; j < row.size(); ++j) {
+        if (row[j] < Q_INFINITY) {
+            int val = ((row[j]-min)*255.0)/(max-min);
+            indices[j] = qBound(0, val, 255);
+        }
+    }
+    return true;
+
+}
+
+bool logColourFrames::frame(int time, QVector <quint8> &indices) {
+
+    if (time < 0)
+        return false;
+
+    int slot = time % LOG_FRAME_RING_SIZE;
+    bool found = false;
+    bool usable = false;
+
+    mutex.lock();
+    playhead = time;
+    if (ringTimes[slot] == time) {
+        found = true;
+        usable = ring[slot].size() > 0;
+        if (usable)
+            indices = ring[slot];
+    }
+    // get the frames after this one ready
+    if (!jobRunning && !cancelled) {
+        jobRunning = true;
+        pool.start(new logFrameJob(this));
+    }
+    mutex.unlock();
+
+    if (found)
+        return usable;
+
+    // not ready yet (the slider has jumped) - work it out now
+    QVector <quint8> computed;
+    usable = this->quantise(foreground.getRow(time), computed);
+    if (usable)
+        indices = computed;
+
+    mutex.lock();
+    ring[slot] = computed;
+    ringTimes[slot] = time;
+    mutex.unlock();
+
+    return usable;
+
+}
+
+void logColourFrames::fill() {
+
+    for (;;) {
+
+        // the first frame after the playhead that isn't ready
+        mutex.lock();
+        int next = -1;
+        if (!cancelled) {
+            for (int t = playhead; t < playhead + LOG_FRAME_RING_SIZE && t < endRow; ++t) {
+                if (ringTimes[t % LOG_FRAME_RING_SIZE] != t) {
+                    next = t;
+                    break;
+                }
+            }
+        }
+        if (next < 0) {
+            jobRunning = false;
+            mutex.unlock();
+            return;
+        }
+        mutex.unlock();
+
+        QVector <double> row = background.getRow(next);
+        QVector <quint8> indices;
+        this->quantise(row, indices);
+
+        mutex.lock();
+        if (row.size() == 0 && next < endRow)
+            endRow = next;
+        // the playhead may have moved on while this frame was being read
+        if (next >= playhead && next < playhead + LOG_FRAME_RING_SIZE) {
+            ring[next % LOG_FRAME_RING_SIZE] = indices;
+            ringTimes[next % LOG_FRAME_RING_SIZE] = next;
+        }
+        mutex.unlock();
+    }
+
+}
@@ -0,0 +1,92 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef LOGCOLOURFRAMES_H
+#define LOGCOLOURFRAMES_H
+
+#include <QRunnable>
+#include <QThreadPool>
+#include "globalHeader.h"
+#include "logdata.h"
+
+// number of frames held ahead of the one being shown
+#define LOG_FRAME_RING_SIZE 64
+
+class logColourFrames;
+
+/*!
+ * \brief The logFrameJob class
+ * Fills a logColourFrames' ring with the frames after the one last shown, on its thread pool,
+ * until the ring is full or the log runs out.
+ */
+class logFrameJob : public QRunnable
+{
+public:
+    explicit logFrameJob(logColourFrames * owner) {this->owner = owner;}
+    void run();
+
+private:
+    logColourFrames * owner;
+};
+
+/*!
+ * \brief The logColourFrames class
+ * The colours of a population's neurons through a log, worked out ahead of playback. Each frame
+ * is kept as one byte per neuron, indexing the 256 entry colour map, in a ring of the frames after
+ * the one last shown, which a background job keeps filled. Playing the log back then just hands
+ * over the indices of the next frame, and the colour map is applied when drawing.
+ *
+ * The range of the log is found when the frames are created, so the logData isn't used after that.
+ */
+class logColourFrames
+{
+public:
+    logColourFrames(logData * log, int numNeurons);
+    ~logColourFrames();
+    int neurons() const {return numNeurons;}
+    bool frame(int time, QVector <quint8> &indices);
+    static const QVector <QRgb> &colourMap();
+
+private:
+    friend class logFrameJob;
+    void fill();
+    bool quantise(const QVector <double> &row, QVector <quint8> &indices) const;
+    logRowReader foreground;
+    logRowReader background;
+    double min;
+    double max;
+    int numNeurons;
+    QMutex mutex;
+    QThreadPool pool;
+    // the ring, and the time held in each slot (-1 for none) - an empty slot with a time set
+    // marks a row that can't be shown
+    QVector < QVector <quint8> > ring;
+    QVector <int> ringTimes;
+    int playhead;
+    int endRow;
+    bool jobRunning;
+    bool cancelled;
+};
+
+#endif // LOGCOLOURFRAMES_H
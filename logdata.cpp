@@ -79,72 +79,39 @@ double logData::getMin() {
     return min;
 }
 
-QVector < double > logData::getRow(int rowNum) {
-
+// read a row of a binary log - the row readers use this too, with their own files
+static QVector < double > readBinaryRow(QIODevice * device, const QVector < column > &columns, int binaryDataStride, bool allLogged, int rowNum) {
 
     QVector < double > rowData;
 
-    // is not analog return empty
-    if (this->dataClass != ANALOGDATA)
-        return rowData;
-
-    // get data
-    switch (dataFormat) {
-    case BINARY:
-    {
-        if (!calculateBinaryDataStride())
-            return rowData;
+    // stream data from file
+    QDataStream data(device);
+    data.device()->seek(0);
+    // offset into file
+    data.skipRawData(binaryDataStride*rowNum);
 
-        // stream data from file
-        QDataStream data(&logFile);
-        data.device()->seek(0);
-        // offset into file
-        data.skipRawData(binaryDataStride*rowNum);
+    // if we skip to the end of the file
+    if (data.atEnd())
+        return rowData;
 
-        // if we skip to the end of the file
-        if (data.atEnd())
+    // check that all are same type
+    dataType mainType;
+    mainType = columns[0].type;
+    for (int i = 0; i < columns.size(); ++i) {
+        if (columns[i].type != mainType)
             return rowData;
+    }
 
-        // check that all are same type
-        dataType mainType;
-        mainType = columns[0].type;
-        for (int i = 0; i < columns.size(); ++i) {
-            if (columns[i].type != mainType)
-                return rowData;
-        }
-
-        switch (columns[0].type) {
-        case TYPE_DOUBLE:
-        {
-            if (allLogged) {
-                rowData.resize(columns.size());
-                data.readRawData((char *) &rowData[0], sizeof(double)*rowData.size());
-            } else {
-                QVector < double > tempDbl;
-                tempDbl.resize(columns.size());
-                data.readRawData((char *) &tempDbl[0], sizeof(double)*tempDbl.size());
-                // a good first guess
-                vector <double> temp = rowData.toStdVector();
-                temp.resize(columns.back().index+1, Q_INFINITY);
-                rowData = QVector <double>::fromStdVector(temp);
-                for (int i = 0; i < columns.size(); ++i) {
-                    if (static_cast<int>(columns[i].index) > rowData.size()) {
-                        vector <double> temp = rowData.toStdVector();
-                        temp.resize(columns[i].index+1, Q_INFINITY);
-                        rowData = QVector <double>::fromStdVector(temp);
-                    }
-                    rowData[columns[i].index] = tempDbl[i];
-                }
-            }
-            return rowData;
-        }
-        break;
-        case TYPE_FLOAT:
-        {
-            QVector < float > tempFloat;
-            tempFloat.resize(columns.size());
-            data.setFloatingPointPrecision(QDataStream::SinglePrecision);
-            data.readRawData((char *) &tempFloat[0], sizeof(float)*tempFloat.size());
+    switch (columns[0].type) {
+    case TYPE_DOUBLE:
+    {
+        if (allLogged) {
+            rowData.resize(columns.size());
+            data.readRawData((char *) &rowData[0], sizeof(double)*rowData.size());
+        } else {
+            QVector < double > tempDbl;
+            tempDbl.resize(columns.size());
+            data.readRawData((char *) &tempDbl[0], sizeof(double)*tempDbl.size());
             // a good first guess
             vector <double> temp = rowData.toStdVector();
             temp.resize(columns.back().index+1, Q_INFINITY);
@@ -155,41 +122,84 @@ QVector < double > logData::getRow(int rowNum) {
                     temp.resize(columns[i].index+1, Q_INFINITY);
                     rowData = QVector <double>::fromStdVector(temp);
                 }
-                rowData[columns[i].index] = tempFloat[i];
+                rowData[columns[i].index] = tempDbl[i];
             }
-            return rowData;
         }
-        break;
-        case TYPE_INT64:
-        {
-            // not supported currently
-            return rowData;
-
+        return rowData;
+    }
+    break;
+    case TYPE_FLOAT:
+    {
+        QVector < float > tempFloat;
+        tempFloat.resize(columns.size());
+        data.setFloatingPointPrecision(QDataStream::SinglePrecision);
+        data.readRawData((char *) &tempFloat[0], sizeof(float)*tempFloat.size());
+        // a good first guess
+        vector <double> temp = rowData.toStdVector();
+        temp.resize(columns.back().index+1, Q_INFINITY);
+        rowData = QVector <double>::fromStdVector(temp);
+        for (int i = 0; i < columns.size(); ++i) {
+            if (static_cast<int>(columns[i].index) > rowData.size()) {
+                vector <double> temp = rowData.toStdVector();
+                temp.resize(columns[i].index+1, Q_INFINITY);
+                rowData = QVector <double>::fromStdVector(temp);
+            }
+            rowData[columns[i].index] = tempFloat[i];
         }
-        break;
-        case TYPE_INT32:
-        {
-            QVector < int > tempInt;
-            tempInt.resize(columns.size());
-            data.readRawData((char *) &tempInt[0], sizeof(int)*tempInt.size());
-            // a good first guess
-            vector <double> temp = rowData.toStdVector();
-            temp.resize(columns.back().index+1, Q_INFINITY);
-            rowData = QVector <double>::fromStdVector(temp);
-            for (int i = 0; i < columns.size(); ++i) {
-                if (static_cast<int>(columns[i].index) > rowData.size()) {
-                    vector <double> temp = rowData.toStdVector();
-                    temp.resize(columns[i].index+1, Q_INFINITY);
-                    rowData = QVector <double>::fromStdVector(temp);
-                }
-                rowData[columns[i].index] = tempInt[i];
+        return rowData;
+    }
+    break;
+    case TYPE_INT64:
+    {
+        // not supported currently
+        return rowData;
+
+    }
+    break;
+    case TYPE_INT32:
+    {
+        QVector < int > tempInt;
+        tempInt.resize(columns.size());
+        data.readRawData((char *) &tempInt[0], sizeof(int)*tempInt.size());
+        // a good first guess
+        vector <double> temp = rowData.toStdVector();
+        temp.resize(columns.back().index+1, Q_INFINITY);
+        rowData = QVector <double>::fromStdVector(temp);
+        for (int i = 0; i < columns.size(); ++i) {
+            if (static_cast<int>(columns[i].index) > rowData.size()) {
+                vector <double> temp = rowData.toStdVector();
+                temp.resize(columns[i].index+1, Q_INFINITY);
+                rowData = QVector <double>::fromStdVector(temp);
             }
-            return rowData;
+            rowData[columns[i].index] = tempInt[i];
         }
-        break;
-        case TYPE_STRING:
+        return rowData;
+    }
+    break;
+    case TYPE_STRING:
+        return rowData;
+    } // end switch (columns[0].type)
+
+    return rowData;
+}
+
+QVector < double > logData::getRow(int rowNum) {
+
+
+    QVector < double > rowData;
+
+    // is not analog return empty
+    if (this->dataClass != ANALOGDATA)
+        return rowData;
+
+    // get data
+    switch (dataFormat) {
+    case BINARY:
+    {
+        if (!calculateBinaryDataStride())
             return rowData;
-        } // end switch (columns[0].type)
+
+        return readBinaryRow(&logFile, columns, binaryDataStride, allLogged, rowNum);
     }
     case CSVFormat:
     case SSVFormat:
@@ -201,6 +211,29 @@ QVector < double > logData::getRow(int rowNum) {
     return rowData;
 }
 
+logRowReader::logRowReader(logData * log) {
+
+    columns = log->columns;
+    allLogged = log->allLogged;
+    binaryDataStride = 0;
+    valid = log->dataClass == ANALOGDATA && log->dataFormat == BINARY && log->calculateBinaryDataStride();
+    if (valid) {
+        binaryDataStride = log->binaryDataStride;
+        file.setFileName(log->logFile.fileName());
+        valid = file.open(QIODevice::ReadOnly);
+    }
+
+}
+
+QVector < double > logRowReader::getRow(int rowNum) {
+
+    if (!valid)
+        return QVector < double > ();
+
+    return readBinaryRow(&file, columns, binaryDataStride, allLogged, rowNum);
+
+}
+
 bool logData::plotLine(QCustomPlot *plot, int colNum, int update) {
 
     // if no plot give up
@@ -95,4 +95,24 @@ public slots:
     
 };
 
+/*!
+ * \brief The logRowReader class
+ * Reads rows of an analog binary log through its own copy of the file and of the log's columns,
+ * so rows can be read on another thread without touching the logData (which may be in use by a
+ * plot, or deleted).
+ */
+class logRowReader
+{
+public:
+    explicit logRowReader(logData * log);
+    QVector < double > getRow(int rowNum);
+
+private:
+    QFile file;
+    QVector < column > columns;
+    int binaryDataStride;
+    bool allLogged;
+    bool valid;
+};
+
 #endif // LOGDATA_H
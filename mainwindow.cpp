@@ -47,6 +47,10 @@
 
 #include "qdebug.h"
 #include "aboutdialog.h"
+#include "pythongeneratorqueue.h"
+
+// the GUI thread's interpreter state, held while the GIL is released
+static PyThreadState * pyMainThreadState = NULL;
 
 
 MainWindow::
@@ -68,6 +72,10 @@ MainWindow(QWidget *parent) :
 
     // initialise Python
     Py_Initialize();
+    // connection scripts are run on a worker thread, so set up the GIL and release it from
+    // the GUI thread - all Python calls must now take the GIL with PyGILState_Ensure()
+    PyEval_InitThreads();
+    pyMainThreadState = PyEval_SaveThread();
 
    QSettings settings;
 
@@ -622,7 +630,9 @@ MainWindow::~MainWindow()
         this->viewVZ.layout.clear();
     }
 
-    // clear up python
+    // stop any running connection scripts and clear up python
+    pythonGeneratorQueue::shutdown();
+    PyEval_RestoreThread(pyMainThreadState);
     Py_Finalize();
 
     // Ensure viewELhandler's destructor is called to clean up temporary model directory
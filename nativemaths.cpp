@@ -0,0 +1,370 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "nativemaths.h"
+#include <QProcess>
+#include <QThreadPool>
+
+QMutex nativeMaths::mutex;
+QHash <QByteArray, QLibrary *> nativeMaths::libraries;
+QSet <QByteArray> nativeMaths::building;
+QSet <QByteArray> nativeMaths::failed;
+bool nativeMaths::noCompiler = false;
+
+// the start of every generated file
+static const char * nativeMathsHeader =
+        "// generated by SpineCreator from layout maths\n"
+        "#include <math.h>\n"
+        "#include <cmath>\n"
+        "using namespace std;\n"
+        "\n"
+        "#ifdef _WIN32\n"
+        "#define SPINE_EXPORT extern \"C\" __declspec(dllexport)\n"
+        "#else\n"
+        "#define SPINE_EXPORT extern \"C\"\n"
+        "#endif\n";
+
+// keep results identical to the interpreter - no fused multiply-adds
+static const char * nativeMathsFlags[] = {"-O2", "-ffp-contract=off", "-shared"};
+
+static QString floatLiteral(float val) {
+
+    if (val != val) {
+        return "NAN";
+    }
+    if (val == INFINITY) {
+        return "INFINITY";
+    }
+    if (val == -INFINITY) {
+        return "-INFINITY";
+    }
+    // enough digits to give back exactly the same float
+    return "float(" + QString::number(double(val), 'g', 17) + ")";
+
+}
+
+/*!
+ * \brief functionCall
+ * \param func the function number, as for doFunctionOp
+ * \param a
+ * \param b the second argument, or empty if the function was called with one
+ * \return C++ that gives the same result as doFunctionOp, using the functions in cinterpreter's table
+ */
+static QString functionCall(int func, QString a, QString b) {
+
+    const char * name = functionLibraryName(func);
+    if (name == NULL) {
+        return "0";
+    }
+
+    // an INFINITY second argument means there wasn't one, anything else is an error for functions
+    // of one argument
+    if (functionIsUnary(func)) {
+        if (b.isEmpty()) {
+            return QString(name) + "(" + a + ")";
+        }
+        return "(" + b + " == INFINITY ? " + QString(name) + "(" + a + ") : INFINITY)";
+    }
+
+    if (b.isEmpty()) {
+        return "INFINITY";
+    }
+    return "(" + b + " == INFINITY ? INFINITY : " + QString(name) + "(" + a + ", " + b + "))";
+
+}
+
+/*!
+ * \brief nativeMaths::isEnabled
+ * \param numNeurons
+ * \return true if native code should be used for a layout of this size
+ */
+bool nativeMaths::isEnabled(int numNeurons) {
+
+    QSettings settings;
+    if (!settings.value("layoutOptions/nativeCode", false).toBool()) {
+        return false;
+    }
+    return numNeurons >= settings.value("layoutOptions/nativeCodeMinNeurons", 100000).toInt();
+
+}
+
+/*!
+ * \brief nativeMaths::functionSource
+ * \param program
+ * \param name
+ * \return a C++ function evaluating the program over a batch, with each instruction as a temporary
+ */
+QString nativeMaths::functionSource(const bytecodeProgram &program, QString name) {
+
+    QString body;
+    QStringList stack;
+
+    const vector <bytecodeInstr> &code = program.instructions();
+
+    for (uint i = 0; i < code.size(); ++i) {
+
+        const bytecodeInstr &instr = code[i];
+        QString value;
+        QString a;
+        QString b;
+
+        switch (instr.op) {
+        case BC_CONST:
+            value = floatLiteral(instr.val);
+            break;
+        case BC_VAR:
+            value = "inputs[" + QString::number(instr.arg) + "][k]";
+            break;
+        case BC_ADD:
+        case BC_SUB:
+        case BC_MULT:
+        case BC_DIV:
+            b = stack.takeLast();
+            a = stack.takeLast();
+            if (instr.op == BC_ADD) value = a + " + " + b;
+            if (instr.op == BC_SUB) value = a + " - " + b;
+            if (instr.op == BC_MULT) value = a + " * " + b;
+            if (instr.op == BC_DIV) value = a + " / " + b;
+            break;
+        case BC_ZERO_OP:
+            a = stack.takeLast();
+            if (instr.func == ADD) value = "0 + " + a;
+            if (instr.func == SUB) value = "0 - " + a;
+            if (instr.func == MULT) value = "0 * " + a;
+            if (instr.func == DIV) value = "0 / " + a;
+            break;
+        case BC_FUNC1:
+            a = stack.takeLast();
+            if (instr.func == 19) {
+                value = "rands[" + QString::number(instr.arg) + "][k]";
+            } else {
+                value = functionCall(instr.func, a, QString());
+            }
+            break;
+        case BC_FUNC2:
+            b = stack.takeLast();
+            a = stack.takeLast();
+            value = functionCall(instr.func, a, b);
+            break;
+        case BC_RAND:
+            value = "rands[" + QString::number(instr.arg) + "][k]";
+            break;
+        }
+
+        QString temp = "t" + QString::number(i);
+        body += "        const float " + temp + " = " + value + ";\n";
+        stack.push_back(temp);
+    }
+
+    QString result = stack.isEmpty() ? "0.0f" : stack.last();
+
+    return "SPINE_EXPORT void " + name + "(const float * const * inputs, const float * const * rands, int count, float * out) {\n"
+            "    (void) inputs;\n"
+            "    (void) rands;\n"
+            "    for (int k = 0; k < count; ++k) {\n"
+            + body +
+            "        out[k] = " + result + ";\n"
+            "    }\n"
+            "}\n";
+
+}
+
+QString nativeMaths::source(const vector <const bytecodeProgram *> &programs) {
+
+    QString src = nativeMathsHeader;
+    for (uint i = 0; i < programs.size(); ++i) {
+        src += "\n" + functionSource(*programs[i], "spine_maths_" + QString::number(i));
+    }
+    return src;
+
+}
+
+QDir nativeMaths::cacheDir() {
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+    QDir lib_dir = QDir(QDesktopServices::storageLocation(QDesktopServices::DataLocation));
+#else
+    QDir lib_dir = QDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+#endif
+    QDir cache_dir = QDir(lib_dir.absoluteFilePath("layout_maths_cache"));
+    if (!cache_dir.exists()) {
+        if (!cache_dir.mkpath(cache_dir.absolutePath())) {
+            qDebug() << "error creating layout maths cache";
+        }
+    }
+    return cache_dir;
+
+}
+
+QString nativeMaths::libraryFileName(QByteArray key) {
+
+    // the suffix QLibrary looks for first on each platform
+#if defined(Q_OS_WIN)
+    return key + ".dll";
+#elif defined(Q_OS_MAC)
+    return key + ".dylib";
+#else
+    return key + ".so";
+#endif
+
+}
+
+nativeMathsBuildJob::nativeMathsBuildJob(QByteArray key, QString src, QString compiler, QStringList flags) {
+
+    this->key = key;
+    this->src = src;
+    this->compiler = compiler;
+    this->flags = flags;
+
+}
+
+void nativeMathsBuildJob::run() {
+
+    nativeMaths::build(key, src, compiler, flags);
+
+}
+
+/*!
+ * \brief nativeMaths::build
+ * Write out the source and compile it into the cache, on a pool thread. The library only appears
+ * under its real name once it is complete, which is what compile() looks for
+ */
+void nativeMaths::build(QByteArray key, QString src, QString compiler, QStringList flags) {
+
+    QDir dir = cacheDir();
+    QString libPath = dir.absoluteFilePath(libraryFileName(key));
+    QString srcPath = dir.absoluteFilePath(key + ".cpp");
+    QString tmpPath = dir.absoluteFilePath(key + ".tmp");
+
+    bool built = false;
+    bool compilerMissing = false;
+
+    QFile file(srcPath);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        file.write(src.toUtf8());
+        file.close();
+
+        QStringList args = flags;
+        args << "-o" << tmpPath << srcPath;
+
+        QProcess process;
+        process.start(compiler, args);
+        if (!process.waitForStarted()) {
+            qDebug() << "Cannot run" << compiler << "- layout maths will be interpreted";
+            compilerMissing = true;
+        } else if (!process.waitForFinished(60000) || process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+            qDebug() << "Building native layout maths failed:" << process.readAllStandardError();
+        } else {
+            QFile::remove(libPath);
+            built = QFile::rename(tmpPath, libPath);
+        }
+        QFile::remove(srcPath);
+        QFile::remove(tmpPath);
+    }
+
+    QMutexLocker locker(&mutex);
+    building.remove(key);
+    if (compilerMissing) {
+        noCompiler = true;
+    } else if (!built) {
+        failed.insert(key);
+    }
+
+}
+
+/*!
+ * \brief nativeMaths::compile
+ * \param programs
+ * \param functions filled with a function for each program
+ * \return false if native code can't be used yet, in which case the programs should be interpreted.
+ * If the library hasn't been built it is started in the background, ready for the next time
+ */
+bool nativeMaths::compile(const vector <const bytecodeProgram *> &programs, vector <nativeMathsFunction> &functions) {
+
+    for (uint i = 0; i < programs.size(); ++i) {
+        if (!programs[i]->isCompiled()) {
+            return false;
+        }
+    }
+
+    QSettings settings;
+    QString compiler = settings.value("layoutOptions/compiler", "c++").toString();
+
+    QStringList flags;
+    for (uint i = 0; i < sizeof(nativeMathsFlags)/sizeof(nativeMathsFlags[0]); ++i) {
+        flags << nativeMathsFlags[i];
+    }
+#ifndef Q_OS_WIN
+    flags << "-fPIC";
+#endif
+
+    QString src = source(programs);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(compiler.toUtf8());
+    hash.addData(flags.join(" ").toUtf8());
+    hash.addData(src.toUtf8());
+    QByteArray key = hash.result().toHex();
+
+    QMutexLocker locker(&mutex);
+
+    if (noCompiler || failed.contains(key) || building.contains(key)) {
+        return false;
+    }
+
+    QLibrary * library = libraries.value(key, NULL);
+
+    if (library == NULL) {
+
+        QString libPath = cacheDir().absoluteFilePath(libraryFileName(key));
+
+        if (!QFile::exists(libPath)) {
+            building.insert(key);
+            QThreadPool::globalInstance()->start(new nativeMathsBuildJob(key, src, compiler, flags));
+            return false;
+        }
+
+        library = new QLibrary(libPath);
+        if (!library->load()) {
+            qDebug() << "Loading native layout maths failed:" << library->errorString();
+            delete library;
+            failed.insert(key);
+            return false;
+        }
+        libraries.insert(key, library);
+    }
+
+    functions.clear();
+    for (uint i = 0; i < programs.size(); ++i) {
+        QByteArray name = ("spine_maths_" + QString::number(i)).toLatin1();
+        nativeMathsFunction function = (nativeMathsFunction) library->resolve(name.constData());
+        if (function == NULL) {
+            functions.clear();
+            return false;
+        }
+        functions.push_back(function);
+    }
+
+    return true;
+
+}
@@ -0,0 +1,87 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef NATIVEMATHS_H
+#define NATIVEMATHS_H
+
+#include "globalHeader.h"
+#include "cinterpreter.h"
+#include <QLibrary>
+#include <QMutex>
+#include <QRunnable>
+
+// same arguments as bytecodeProgram::evaluateBatch, without the stack
+typedef void (*nativeMathsFunction)(const float * const * inputs, const float * const * rands, int count, float * out);
+
+/*!
+ * \brief The nativeMathsBuildJob class
+ * Runs the compiler for one set of maths on the global thread pool
+ */
+class nativeMathsBuildJob : public QRunnable
+{
+public:
+    nativeMathsBuildJob(QByteArray key, QString src, QString compiler, QStringList flags);
+    void run();
+
+private:
+    QByteArray key;
+    QString src;
+    QString compiler;
+    QStringList flags;
+};
+
+/*!
+ * \brief The nativeMaths class
+ * An optional backend that turns compiled maths into C++, builds it into a shared library with
+ * the system compiler and loads it with QLibrary. The libraries are cached on disk by a hash of
+ * the generated source, so each set of maths is only built once. Building happens in the
+ * background - until the library is ready, and whenever anything goes wrong (no compiler, maths
+ * that isn't compiled), the interpreter is used instead.
+ *
+ * It is turned on with the layoutOptions/nativeCode setting, and only used for layouts of at least
+ * layoutOptions/nativeCodeMinNeurons neurons as building takes a moment.
+ */
+class nativeMaths
+{
+public:
+    static bool isEnabled(int numNeurons);
+    static bool compile(const vector <const bytecodeProgram *> &programs, vector <nativeMathsFunction> &functions);
+
+private:
+    friend class nativeMathsBuildJob;
+    static QString source(const vector <const bytecodeProgram *> &programs);
+    static QString functionSource(const bytecodeProgram &program, QString name);
+    static QDir cacheDir();
+    static QString libraryFileName(QByteArray key);
+    static void build(QByteArray key, QString src, QString compiler, QStringList flags);
+
+    static QMutex mutex;
+    // loaded libraries by key, keys being built and keys that failed to build
+    static QHash <QByteArray, QLibrary *> libraries;
+    static QSet <QByteArray> building;
+    static QSet <QByteArray> failed;
+    static bool noCompiler;
+};
+
+#endif // NATIVEMATHS_H
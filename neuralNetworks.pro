@@ -64,7 +64,16 @@ SOURCES += main.cpp \
     projectobject.cpp \
     filteroutundoredoevents.cpp \
     batchexperimentwindow.cpp \
-    vectorlistmodel.cpp
+    vectorlistmodel.cpp \
+    pythongeneratorqueue.cpp \
+    connectivityregenerator.cpp \
+    connectionsink.cpp \
+    nativemaths.cpp \
+    glvertexbuffer.cpp \
+    framescheduler.cpp \
+    neurongrid.cpp \
+    tiffwriter.cpp \
+    logcolourframes.cpp
 
 HEADERS  += mainwindow.h \
     glwidget.h \
@@ -116,7 +125,16 @@ HEADERS  += mainwindow.h \
     filteroutundoredoevents.h \
     batchexperimentwindow.h \
     vectorlistmodel.h \
-    qmessageboxresizable.h
+    qmessageboxresizable.h \
+    pythongeneratorqueue.h \
+    connectivityregenerator.h \
+    connectionsink.h \
+    nativemaths.h \
+    glvertexbuffer.h \
+    framescheduler.h \
+    neurongrid.h \
+    tiffwriter.h \
+    logcolourframes.h
 
 FORMS    += mainwindow.ui \
     ninemlsortingdialog.ui \
@@ -0,0 +1,200 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "neurongrid.h"
+
+// cells in each direction at most, to bound the memory used for sparse layouts
+#define NEURON_GRID_MAX_DIM 512
+
+neuronGrid::neuronGrid()
+{
+    radius = 0;
+    cellSize = 1;
+    dims[0] = 0; dims[1] = 0; dims[2] = 0;
+}
+
+void neuronGrid::build(const QVector <loc> &locs, float radius) {
+
+    locations = locs;
+    this->radius = radius;
+    cellStart.clear();
+    cellNeurons.clear();
+
+    if (locs.size() == 0)
+        return;
+
+    // bounds of the spheres
+    mins = locs[0];
+    maxes = locs[0];
+    for (int i = 0; i < locs.size(); ++i) {
+        mins.x = qMin(mins.x, locs[i].x); maxes.x = qMax(maxes.x, locs[i].x);
+        mins.y = qMin(mins.y, locs[i].y); maxes.y = qMax(maxes.y, locs[i].y);
+        mins.z = qMin(mins.z, locs[i].z); maxes.z = qMax(maxes.z, locs[i].z);
+    }
+    mins.x -= radius; mins.y -= radius; mins.z -= radius;
+    maxes.x += radius; maxes.y += radius; maxes.z += radius;
+
+    // size the cells to hold a couple of neurons each on average, but no smaller than a neuron
+    double volume = double(maxes.x - mins.x) * double(maxes.y - mins.y) * double(maxes.z - mins.z);
+    cellSize = pow(volume / (double(locs.size()) / 2.0), 1.0/3.0);
+    if (!(cellSize > 0))
+        cellSize = 1;
+    if (cellSize < 2.0f*radius)
+        cellSize = 2.0f*radius;
+    float extent = qMax(maxes.x - mins.x, qMax(maxes.y - mins.y, maxes.z - mins.z));
+    if (cellSize < extent / NEURON_GRID_MAX_DIM)
+        cellSize = extent / NEURON_GRID_MAX_DIM;
+
+    dims[0] = qMax(1, int(ceil((maxes.x - mins.x) / cellSize)));
+    dims[1] = qMax(1, int(ceil((maxes.y - mins.y) / cellSize)));
+    dims[2] = qMax(1, int(ceil((maxes.z - mins.z) / cellSize)));
+
+    // count then fill the neurons of each cell their sphere overlaps
+    cellStart.fill(0, dims[0]*dims[1]*dims[2]+1);
+    for (int pass = 0; pass < 2; ++pass) {
+        QVector <int> next;
+        if (pass == 1) {
+            for (int c = 0; c < dims[0]*dims[1]*dims[2]; ++c)
+                cellStart[c+1] += cellStart[c];
+            cellNeurons.resize(cellStart.back());
+            next = cellStart;
+        }
+        for (int i = 0; i < locs.size(); ++i) {
+            int lo[3];
+            int hi[3];
+            float centre[3] = {locs[i].x - mins.x, locs[i].y - mins.y, locs[i].z - mins.z};
+            for (int d = 0; d < 3; ++d) {
+                lo[d] = qBound(0, int(floor((centre[d] - radius) / cellSize)), dims[d]-1);
+                hi[d] = qBound(0, int(floor((centre[d] + radius) / cellSize)), dims[d]-1);
+            }
+            for (int z = lo[2]; z <= hi[2]; ++z) {
+                for (int y = lo[1]; y <= hi[1]; ++y) {
+                    for (int x = lo[0]; x <= hi[0]; ++x) {
+                        if (pass == 0)
+                            ++cellStart[cellIndex(x,y,z)+1];
+                        else
+                            cellNeurons[next[cellIndex(x,y,z)]++] = i;
+                    }
+                }
+            }
+        }
+    }
+
+}
+
+int neuronGrid::pick(const loc &origin, const loc &direction, float * distance) const {
+
+    if (locations.size() == 0)
+        return -1;
+
+    float o[3] = {origin.x - mins.x, origin.y - mins.y, origin.z - mins.z};
+    float d[3] = {direction.x, direction.y, direction.z};
+    float size[3] = {maxes.x - mins.x, maxes.y - mins.y, maxes.z - mins.z};
+
+    // where the ray is inside the grid's bounds
+    float tEnter = 0;
+    float tExit = INFINITY;
+    for (int a = 0; a < 3; ++a) {
+        if (d[a] == 0) {
+            if (o[a] < 0 || o[a] > size[a])
+                return -1;
+        } else {
+            float t0 = (0 - o[a]) / d[a];
+            float t1 = (size[a] - o[a]) / d[a];
+            if (t0 > t1) qSwap(t0, t1);
+            tEnter = qMax(tEnter, t0);
+            tExit = qMin(tExit, t1);
+        }
+    }
+    if (tEnter > tExit)
+        return -1;
+
+    // step through the cells along the ray
+    int cell[3];
+    int step[3];
+    float tNext[3];
+    float tDelta[3];
+    for (int a = 0; a < 3; ++a) {
+        float p = o[a] + d[a]*tEnter;
+        cell[a] = qBound(0, int(floor(p / cellSize)), dims[a]-1);
+        if (d[a] > 0) {
+            step[a] = 1;
+            tNext[a] = tEnter + ((cell[a]+1)*cellSize - p) / d[a];
+            tDelta[a] = cellSize / d[a];
+        } else if (d[a] < 0) {
+            step[a] = -1;
+            tNext[a] = tEnter + (cell[a]*cellSize - p) / d[a];
+            tDelta[a] = -cellSize / d[a];
+        } else {
+            step[a] = 0;
+            tNext[a] = INFINITY;
+            tDelta[a] = INFINITY;
+        }
+    }
+
+    float lengthSq = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+    int best = -1;
+    float bestT = INFINITY;
+
+    while (true) {
+
+        int c = cellIndex(cell[0], cell[1], cell[2]);
+        for (int k = cellStart[c]; k < cellStart[c+1]; ++k) {
+            const loc &n = locations[cellNeurons[k]];
+            // ray against sphere
+            float oc[3] = {origin.x - n.x, origin.y - n.y, origin.z - n.z};
+            float b = oc[0]*d[0] + oc[1]*d[1] + oc[2]*d[2];
+            float cc = oc[0]*oc[0] + oc[1]*oc[1] + oc[2]*oc[2] - radius*radius;
+            float disc = b*b - lengthSq*cc;
+            if (disc < 0)
+                continue;
+            float t = (-b - sqrt(disc)) / lengthSq;
+            if (t < 0)
+                t = (-b + sqrt(disc)) / lengthSq;
+            if (t >= 0 && t < bestT) {
+                bestT = t;
+                best = cellNeurons[k];
+            }
+        }
+
+        // neurons span cells, so a hit only counts once the ray has passed it
+        int a = 0;
+        if (tNext[1] < tNext[a]) a = 1;
+        if (tNext[2] < tNext[a]) a = 2;
+        if (best >= 0 && bestT <= tNext[a])
+            break;
+
+        if (tNext[a] > tExit)
+            break;
+        cell[a] += step[a];
+        if (cell[a] < 0 || cell[a] >= dims[a])
+            break;
+        tNext[a] += tDelta[a];
+    }
+
+    if (distance)
+        *distance = bestT;
+    return best;
+
+}
@@ -0,0 +1,58 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef NEURONGRID_H
+#define NEURONGRID_H
+
+#include "globalHeader.h"
+
+/*!
+ * \brief The neuronGrid class
+ * A uniform grid over the neurons of a layout, for finding which neuron a ray (such as one through
+ * the mouse pointer) hits first. Each neuron is a sphere, and is listed in every cell its sphere
+ * overlaps. A ray steps through the cells in order from its start, so only the neurons near the
+ * ray are tested and the search stops at the first cell with a hit.
+ */
+class neuronGrid
+{
+public:
+    neuronGrid();
+    void build(const QVector <loc> &locs, float radius);
+    int pick(const loc &origin, const loc &direction, float * distance = NULL) const;
+    bool isEmpty() const {return locations.size() == 0;}
+
+private:
+    int cellIndex(int x, int y, int z) const {return (z*dims[1] + y)*dims[0] + x;}
+    QVector <loc> locations;
+    float radius;
+    loc mins;
+    loc maxes;
+    float cellSize;
+    int dims[3];
+    // neurons in each cell, as compressed rows
+    QVector <int> cellStart;
+    QVector <int> cellNeurons;
+};
+
+#endif // NEURONGRID_H
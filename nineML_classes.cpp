@@ -557,6 +557,9 @@ void NineMLData::write_node_xml(QXmlStreamWriter &xmlOut) {
         NineMLLayoutData * lay = static_cast<NineMLLayoutData *> (this);
         xmlOut.writeAttribute("seed", QString::number(lay->seed));
         xmlOut.writeAttribute("minimum_distance", QString::number(lay->minimumDistance));
+        if (!lay->legacyRandom) {
+            xmlOut.writeAttribute("random", "stream");
+        }
     }
 
     if (this->type == NineMLComponentType) {
@@ -1872,6 +1875,24 @@ MathInLine::MathInLine(MathInLine *data)
     equation = data->equation;
 }
 
+/*!
+ * \brief MathInLine::getExpression
+ * \return the equation parsed
+ *
+ * The parsed equation is kept and only parsed again when the equation has changed, so validation
+ * and layout generation don't each tokenise it every time. Layouts may be generated on other
+ * threads, hence the lock - the parsed equation itself is shared, not copied.
+ */
+QSharedPointer <const mathsExpression> MathInLine::getExpression()
+{
+    QMutexLocker locker(&expressionLock);
+
+    if (this->expression.isNull() || this->expression->equation() != this->equation) {
+        this->expression = QSharedPointer <mathsExpression> (new mathsExpression(this->equation));
+    }
+    return this->expression;
+}
+
 QString MathInLine::getHTMLSafeEquation()
 {
     QString result = equation;
@@ -2591,26 +2612,9 @@ void NineMLComponentData::copyFrom(QSharedPointer <NineMLComponentData>src, QSha
     return *this;
 }*/
 
-void MathInLine::validateMathSetup(QString& testequation, QStringList& FuncList)
-{
-    testequation = equation;
-    testequation.replace('+', ' ');
-    testequation = testequation.replace('-', ' ');
-    testequation = testequation.replace('*', ' ');
-    testequation = testequation.replace('/', ' ');
-    testequation = testequation.replace('(', ' ');
-    testequation = testequation.replace(')', ' ');
-    testequation = testequation.replace('<', ' ');
-    testequation = testequation.replace('>', ' ');
-    testequation = testequation.replace('=', ' ');
-    testequation = testequation.replace(',', ' ');
-    testequation = testequation.replace('&', ' ');
-    testequation = testequation.replace('|', ' ');
-    testequation = testequation.replace('!', ' ');
-
-    // remove double whitespaces
-    testequation = testequation.simplified();
-
+QStringList MathInLine::knownFunctions()
+{
+    QStringList FuncList;
     FuncList.push_back("pow");
     FuncList.push_back("exp");
     FuncList.push_back("sin");
@@ -2639,6 +2643,8 @@ void MathInLine::validateMathSetup(QString& testequation, QStringList& FuncList)
     // not strictly functions...
     FuncList.push_back("t");
     FuncList.push_back("dt");
+
+    return FuncList;
 }
 
 int MathInLine::validateMathInLine(NineMLComponent* component, QStringList * )
@@ -2647,13 +2653,11 @@ int MathInLine::validateMathInLine(NineMLComponent* component, QStringList * )
         return 1;
     }
 
-    QString test = equation;
-    QStringList FuncList;
-    this->validateMathSetup (test, FuncList);
+    QStringList FuncList = knownFunctions();
 
-    // tokenise
-    QStringList splitTest;
-    splitTest = test.split(' ');
+    // the names used in the equation
+    QSharedPointer <const mathsExpression> expression = this->getExpression();
+    QStringList splitTest = expression->variableNames() + expression->functionNames();
 
     // check each token...
     for (int i = 0; i < (int) splitTest.count(); ++i) {
@@ -2685,10 +2689,6 @@ int MathInLine::validateMathInLine(NineMLComponent* component, QStringList * )
             if (FuncList[j].compare(splitTest[i]) == 0)
                 recognised = true;
         }
-        // see if it is a number...
-        if (splitTest[i][0] > 47 && splitTest[i][0] < 58 && splitTest[i][0] != '.') {
-            recognised = true;
-        }
 
         // if a token is not recognised, then let the user know - this may be better done elsewhere...
         if (!recognised) {
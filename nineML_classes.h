@@ -27,6 +27,7 @@
 
 #include "globalHeader.h"
 #include "systemobject.h"
+#include "cinterpreter.h"
 
 // This is the number of connections there has to be for the system to
 // start writing these connections into a binary file. If there are
@@ -288,6 +289,7 @@ public:
     MathInLine(){}
     virtual ~MathInLine(){}
     QString getHTMLSafeEquation();
+    QSharedPointer <const mathsExpression> getExpression();
     int validateMathInLine(NineMLComponent *component, QStringList * errs);
     int validateMathInLine(NineMLLayout * component, QStringList * errs);
     void readIn(QDomElement e);
@@ -296,12 +298,15 @@ public:
 
 private:
     /*!
-     * Remove an approved list of operators from the testequation,
-     * then set up a function list of allowed functions. If what
-     * remains in testequation is only FuncList, then the testequation
-     * will validate.
+     * The functions (and other names) that can be used in an equation
+     * without being part of the component.
      */
-    void validateMathSetup(QString& testequation, QStringList& FuncList);
+    static QStringList knownFunctions();
+
+    // the last equation parsed - replaced (never changed) when the equation changes, so copies
+    // handed out stay valid
+    QSharedPointer <mathsExpression> expression;
+    QMutex expressionLock;
 };
 
 class Trigger: public NineMLObject {
@@ -23,6 +23,15 @@
 ****************************************************************************/
 
 #include "nineml_layout_classes.h"
+#include "nativemaths.h"
+#include <algorithm>
+
+// guards the cached layouts, which are used from the layout preview, connectivity and GUI threads -
+// only held to look up or store a layout, not while one is generated
+static QMutex layoutCacheMutex;
+
+// layouts using the C library's rand() share its state, so only one can be generated at a time
+static QMutex legacyRandomMutex;
 
 NineMLLayout::NineMLLayout(QSharedPointer<NineMLLayout>data)
 {
@@ -117,6 +126,7 @@ NineMLLayoutData::NineMLLayoutData(QSharedPointer<NineMLLayout>data)
 {
     seed = 123;
     minimumDistance = 0.0;
+    legacyRandom = false;
     type = NineMLLayoutType;
     StateVariableList.resize(data->StateVariableList.size());
     ParameterList.resize(data->ParameterList.size());
@@ -285,6 +295,8 @@ void NineMLLayoutData::import_parameters_from_xml(QDomNode &nIn)
 
     this->seed = nIn.toElement().attribute("seed","123").toInt();
     this->minimumDistance = nIn.toElement().attribute("minimum_distance","0.0").toDouble();
+    // layouts saved before random streams keep using rand(), so their neurons stay where they were
+    this->legacyRandom = nIn.toElement().attribute("random", "rand") != "stream";
 
     QDomNodeList nList = nIn.toElement().elementsByTagName("Property");
 
@@ -399,7 +411,394 @@ void rotateAxes(axisType axis, float angle, float x[3], float y[3], float z[3])
 }
 
 
-void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations, QString &errRet) {
+/*!
+ * \brief layoutCellKey
+ * \param x
+ * \param y
+ * \param z
+ * \return a key for the grid cell, using 21 bits for each coordinate - cells that share a key
+ * are just checked together
+ */
+static quint64 layoutCellKey(qint32 x, qint32 y, qint32 z) {
+
+    return ((quint64(quint32(x)) & 0x1FFFFF) << 42) | ((quint64(quint32(y)) & 0x1FFFFF) << 21) | (quint64(quint32(z)) & 0x1FFFFF);
+
+}
+
+/*!
+ * \brief The layoutStep struct
+ * An alias or transform that is evaluated for each neuron in a layout, along with the variables
+ * in the variable list its result is assigned to.
+ */
+struct layoutStep {
+    const bytecodeProgram * program;
+    vector <int> targets;
+    // native code for the program, if it has been built
+    nativeMathsFunction native;
+
+    void evaluateBatch(const float * const * inputs, const float * const * rands, int count, float * out, float * stack) const {
+        if (this->native != NULL) {
+            this->native(inputs, rands, count, out);
+        } else {
+            this->program->evaluateBatch(inputs, rands, count, out, stack);
+        }
+    }
+};
+
+/*!
+ * \brief The layoutBatch class
+ * The steps of a layout and their results for every neuron, shared by the blocks of neurons that
+ * batchLayout evaluates.
+ */
+class layoutBatch {
+
+public:
+    const vector <layoutStep> * steps;
+    vector <bool> sequential;
+    vector <int> randBase;
+    int numRands;
+    // where the values of the variables each step reads come from, for every neuron
+    vector < vector <const float *> > sources;
+    vector < vector <float> > results;
+    randomStream random;
+    layoutProgress * progress;
+
+    void evaluateBlock(int start, int count, vector <float> &stack, vector <float> &rands);
+};
+
+/*!
+ * \brief layoutBatch::evaluateBlock
+ * \param start
+ * \param count
+ * \param stack scratch space for the evaluation stack
+ * \param rands scratch space for the random numbers
+ *
+ * Evaluate the steps that aren't sequential for count neurons from start. Each neuron draws its
+ * random numbers from its own stream, so blocks can be evaluated in any order.
+ */
+void layoutBatch::evaluateBlock(int start, int count, vector <float> &stack, vector <float> &rands) {
+
+    stack.resize(BYTECODE_MAX_STACK * count);
+    rands.resize(qMax(this->numRands, 1) * count);
+    for (int i = 0; i < count; ++i) {
+        randomStream neuronRandom = this->random.split(start + i);
+        for (int r = 0; r < this->numRands; ++r) {
+            rands[r * count + i] = neuronRandom.uniform();
+        }
+    }
+
+    vector <const float *> inputs;
+    vector <const float *> randInputs(this->numRands + 1, NULL);
+
+    for (uint s = 0; s < this->steps->size(); ++s) {
+
+        if (this->sequential[s]) continue;
+
+        inputs.assign(this->sources[s].size() + 1, NULL);
+        for (uint v = 0; v < this->sources[s].size(); ++v) {
+            inputs[v] = this->sources[s][v] + start;
+        }
+        for (int r = 0; r < (*this->steps)[s].program->numRandoms(); ++r) {
+            randInputs[r] = &rands[(this->randBase[s] + r) * count];
+        }
+        (*this->steps)[s].evaluateBatch(&inputs[0], &randInputs[0], count, &this->results[s][start], &stack[0]);
+    }
+
+}
+
+/*!
+ * \brief The layoutBatchJob class
+ * Evaluates a range of neurons in a layoutBatch on a thread pool
+ */
+class layoutBatchJob : public QRunnable {
+
+public:
+    layoutBatchJob(layoutBatch * batch, int start, int end) {this->batch = batch; this->start = start; this->end = end;}
+    void run() {
+        vector <float> stack;
+        vector <float> rands;
+        for (int i = this->start; i < this->end; i += BYTECODE_BATCH_SIZE) {
+            if (this->batch->progress != NULL && this->batch->progress->isCancelled()) {
+                return;
+            }
+            this->batch->evaluateBlock(i, qMin(BYTECODE_BATCH_SIZE, this->end - i), stack, rands);
+        }
+    }
+
+private:
+    layoutBatch * batch;
+    int start;
+    int end;
+};
+
+/*!
+ * \brief batchLayout
+ * \param steps
+ * \param varList
+ * \param numNeurons
+ * \param xyz the index of the x, y and z state variables in varList, or -1 if there is none
+ * \param random
+ * \param progress checked for cancellation, may be NULL
+ * \param locations
+ * \return false if the steps can't be evaluated in batches, in which case nothing has been done
+ *
+ * Generate the locations for a layout by evaluating each step over whole blocks of neurons,
+ * giving the same results as evaluating all of the steps for one neuron at a time. A step that
+ * reads a variable before it has been assigned for the current neuron sees the value from the
+ * previous neuron, so those steps (and the steps they depend on - usually just a counter) are still
+ * evaluated one neuron at a time before the rest are done in batches. Neuron i draws its random
+ * numbers from random.split(i), so the blocks are independent and large layouts are split across
+ * the cores.
+ */
+static bool batchLayout(const vector <layoutStep> &steps, const vector <lookup> &varList, int numNeurons, const int xyz[3], const randomStream &random, layoutProgress * progress, QVector <loc> *locations) {
+
+    int numSteps = (int) steps.size();
+    int numSlots = (int) varList.size();
+
+    layoutBatch batch;
+    batch.steps = &steps;
+    batch.random = random;
+    batch.progress = progress;
+
+    // find which variables each step reads
+    vector < vector <int> > reads(numSteps);
+    batch.randBase.resize(numSteps);
+    batch.numRands = 0;
+    for (int s = 0; s < numSteps; ++s) {
+        if (!steps[s].program->isCompiled()) {
+            return false;
+        }
+        const vector <float *> &vars = steps[s].program->variables();
+        for (uint v = 0; v < vars.size(); ++v) {
+            int slot = -1;
+            for (int j = 0; j < numSlots; ++j) {
+                if (&varList[j].value == vars[v]) {
+                    slot = j;
+                }
+            }
+            if (slot == -1) {
+                return false;
+            }
+            reads[s].push_back(slot);
+        }
+        batch.randBase[s] = batch.numRands;
+        batch.numRands += steps[s].program->numRandoms();
+    }
+
+    vector < vector <int> > writers(numSlots);
+    for (int s = 0; s < numSteps; ++s) {
+        for (uint t = 0; t < steps[s].targets.size(); ++t) {
+            writers[steps[s].targets[t]].push_back(s);
+        }
+    }
+
+    // steps assigning a variable that is read before it is assigned are recurrences
+    vector <bool> &sequential = batch.sequential;
+    sequential.assign(numSteps, false);
+    vector <bool> assigned(numSlots, false);
+    for (int s = 0; s < numSteps; ++s) {
+        for (uint v = 0; v < reads[s].size(); ++v) {
+            if (!assigned[reads[s][v]]) {
+                for (uint w = 0; w < writers[reads[s][v]].size(); ++w) {
+                    sequential[writers[reads[s][v]][w]] = true;
+                }
+            }
+        }
+        for (uint t = 0; t < steps[s].targets.size(); ++t) {
+            assigned[steps[s].targets[t]] = true;
+        }
+    }
+    // ... as is anything they read
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int s = 0; s < numSteps; ++s) {
+            if (!sequential[s]) continue;
+            for (uint v = 0; v < reads[s].size(); ++v) {
+                for (uint w = 0; w < writers[reads[s][v]].size(); ++w) {
+                    if (!sequential[writers[reads[s][v]][w]]) {
+                        sequential[writers[reads[s][v]][w]] = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // the result of each step for every neuron
+    batch.results.assign(numSteps, vector <float> (numNeurons));
+
+    vector <float> stack(BYTECODE_MAX_STACK);
+
+    // recurrences first, one neuron at a time
+    vector <float> current(numSlots);
+    for (int j = 0; j < numSlots; ++j) {
+        current[j] = varList[j].value;
+    }
+    vector < vector <const float *> > currentInputs(numSteps);
+    for (int s = 0; s < numSteps; ++s) {
+        for (uint v = 0; v < reads[s].size(); ++v) {
+            currentInputs[s].push_back(&current[reads[s][v]]);
+        }
+        // there is always at least one pointer so the arrays can be passed
+        currentInputs[s].push_back(NULL);
+    }
+    vector <float> neuronRands(batch.numRands + 1);
+    vector <const float *> randInputs(batch.numRands + 1, NULL);
+    if (find(sequential.begin(), sequential.end(), true) != sequential.end()) {
+        for (int i = 0; i < numNeurons; ++i) {
+            if (progress != NULL && i % BYTECODE_BATCH_SIZE == 0 && progress->isCancelled()) {
+                return true;
+            }
+            randomStream neuronRandom = random.split(i);
+            for (int r = 0; r < batch.numRands; ++r) {
+                neuronRands[r] = neuronRandom.uniform();
+            }
+            for (int s = 0; s < numSteps; ++s) {
+                if (!sequential[s]) continue;
+                for (int r = 0; r < steps[s].program->numRandoms(); ++r) {
+                    randInputs[r] = &neuronRands[batch.randBase[s]+r];
+                }
+                float result;
+                steps[s].evaluateBatch(&currentInputs[s][0], &randInputs[0], 1, &result, &stack[0]);
+                batch.results[s][i] = result;
+                for (uint t = 0; t < steps[s].targets.size(); ++t) {
+                    current[steps[s].targets[t]] = result;
+                }
+            }
+        }
+    }
+
+    // then everything else in batches. Variables that are never assigned are constant, and those
+    // only assigned later in the steps take the last value from the previous neuron
+    vector < vector <float> > constants(numSlots);
+    vector < vector <float> > previous(numSlots);
+    batch.sources.resize(numSteps);
+    for (int s = 0; s < numSteps; ++s) {
+
+        if (sequential[s]) continue;
+
+        for (uint v = 0; v < reads[s].size(); ++v) {
+
+            int slot = reads[s][v];
+            int latest = -1;
+            for (uint w = 0; w < writers[slot].size(); ++w) {
+                if (writers[slot][w] < s) {
+                    latest = writers[slot][w];
+                }
+            }
+
+            if (latest != -1) {
+                batch.sources[s].push_back(&batch.results[latest][0]);
+            } else if (writers[slot].size() > 0) {
+                if (previous[slot].empty()) {
+                    previous[slot].resize(numNeurons);
+                    previous[slot][0] = varList[slot].value;
+                    for (int i = 1; i < numNeurons; ++i) {
+                        previous[slot][i] = batch.results[writers[slot].back()][i-1];
+                    }
+                }
+                batch.sources[s].push_back(&previous[slot][0]);
+            } else {
+                if (constants[slot].empty()) {
+                    constants[slot].resize(numNeurons, varList[slot].value);
+                }
+                batch.sources[s].push_back(&constants[slot][0]);
+            }
+        }
+    }
+
+    // split the neurons between the cores if there are enough of them to be worth it
+    int numBlocks = (numNeurons + BYTECODE_BATCH_SIZE - 1) / BYTECODE_BATCH_SIZE;
+    int numJobs = qMin(QThread::idealThreadCount(), numBlocks / 4);
+    if (numJobs > 1) {
+        // a pool of our own, so we don't wait on (or for) anything else
+        QThreadPool pool;
+        pool.setMaxThreadCount(numJobs);
+        int blocksPerJob = (numBlocks + numJobs - 1) / numJobs;
+        for (int job = 0; job < numJobs; ++job) {
+            int start = job * blocksPerJob * BYTECODE_BATCH_SIZE;
+            int end = qMin(numNeurons, start + blocksPerJob * BYTECODE_BATCH_SIZE);
+            if (start < end) {
+                pool.start(new layoutBatchJob(&batch, start, end));
+            }
+        }
+        pool.waitForDone();
+    } else {
+        layoutBatchJob(&batch, 0, numNeurons).run();
+    }
+
+    // write out the locations from the last value assigned to x, y and z
+    const float * columns[3];
+    float initial[3];
+    for (int c = 0; c < 3; ++c) {
+        columns[c] = NULL;
+        initial[c] = 0;
+        if (xyz[c] != -1) {
+            initial[c] = varList[xyz[c]].value;
+            if (writers[xyz[c]].size() > 0) {
+                columns[c] = &batch.results[writers[xyz[c]].back()][0];
+            }
+        }
+    }
+
+    locations->resize(numNeurons);
+    for (int i = 0; i < numNeurons; ++i) {
+        (*locations)[i].x = columns[0] ? columns[0][i] : initial[0];
+        (*locations)[i].y = columns[1] ? columns[1][i] : initial[1];
+        (*locations)[i].z = columns[2] ? columns[2][i] : initial[2];
+    }
+
+    return true;
+
+}
+
+/*!
+ * \brief NineMLLayoutData::generateLayout
+ * \param numNeurons
+ * \param locations
+ * \param errRet
+ * \param progress if not NULL, given partial layouts and checked for cancellation
+ *
+ * Generate the locations for numNeurons neurons. The last layout generated is kept along with a
+ * hash of everything that went into it, and if nothing has changed the locations are shared from
+ * that - QVector is implicitly shared, so all the callers use the same buffer until one of them
+ * modifies its copy.
+ */
+void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations, QString &errRet, layoutProgress * progress) {
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    this->addToHash(hash);
+    QByteArray numData;
+    QDataStream stream(&numData, QIODevice::WriteOnly);
+    stream << (qint32) numNeurons;
+    hash.addData(numData);
+    QByteArray key = hash.result();
+
+    layoutCacheMutex.lock();
+    if (key == this->cachedLayoutKey) {
+        *locations = this->cachedLayout;
+        layoutCacheMutex.unlock();
+        return;
+    }
+    layoutCacheMutex.unlock();
+
+    QString err;
+    this->calculateLayout(numNeurons, locations, err, progress);
+
+    QMutexLocker locker(&layoutCacheMutex);
+    if (err.isEmpty()) {
+        this->cachedLayoutKey = key;
+        this->cachedLayout = *locations;
+    } else {
+        this->cachedLayoutKey.clear();
+        this->cachedLayout.clear();
+        errRet = err;
+    }
+
+}
+
+void NineMLLayoutData::calculateLayout(int numNeurons, QVector <loc> *locations, QString &errRet, layoutProgress * progress) {
 
     float result = 0;
 
@@ -452,6 +851,15 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
     varList.push_back(lookup("e", M_E));
     varList.push_back(lookup("pi", M_PI));
 
+    // resolve the names once - varList is never resized after this
+    symbolTable symbols(varList);
+
+    int xyz[3] = {-1, -1, -1};
+    for (int sv = 0; sv < this->StateVariableList.size(); ++sv) {
+        if (varList[sv].name == "x") xyz[0] = sv;
+        if (varList[sv].name == "y") xyz[1] = sv;
+        if (varList[sv].name == "z") xyz[2] = sv;
+    }
 
     if (this->component->RegimeList.size() > 0) {
 
@@ -476,7 +884,7 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
             QString err;
             vector < valop > newStack;
             trstacks.push_back(newStack);
-            err = createStack(regime->TransformList[order[trans]]->maths->equation, varList, &trstacks.back());
+            err = regime->TransformList[order[trans]]->maths->getExpression()->bind(symbols, &trstacks.back());
 
             // if error doing maths...
             if (err != "") {
@@ -493,7 +901,7 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
             QString err;
             vector < valop > newStack;
             alstacks.push_back(newStack);
-            err = createStack(this->component->AliasList[j]->maths->equation, varList, &alstacks.back());
+            err = this->component->AliasList[j]->maths->getExpression()->bind(symbols, &alstacks.back());
 
             // if error doing maths...
             if (err != "") {
@@ -506,14 +914,104 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
            }
         }
 
-        srand(this->seed);
+        // compile the stacks - the pointers they hold into varList stay valid as it is never resized
+        vector < bytecodeProgram > trprograms(trstacks.size());
+        for (uint trans = 0; trans < trstacks.size(); ++trans) {
+            trprograms[trans].compile(trstacks[trans]);
+        }
+        vector < bytecodeProgram > alprograms(alstacks.size());
+        for (uint j = 0; j < alstacks.size(); ++j) {
+            alprograms[j].compile(alstacks[j]);
+        }
+
+        // the state variables each transform assigns to
+        vector < vector <int> > trtargets(order.size());
+        for (int trans = 0; trans < order.size(); ++trans) {
+            if (regime->TransformList[order[trans]]->type == TRANSLATE) {
+                for (int j = 0; j < this->StateVariableList.size(); ++j) {
+                    if (varList[j].name == regime->TransformList[order[trans]]->variable->name) {
+                        trtargets[trans].push_back(j);
+                    }
+                }
+            }
+        }
+
+        // each attempt at placing a neuron draws from its own stream split from the seed, so the
+        // numbers don't depend on anything else using rand() and neurons can be generated in parallel
+        randomStream random(this->seed);
+        int attempt = 0;
+
+        // older layouts draw from rand() in order, one neuron at a time, as they always did
+        QMutexLocker legacyLocker(this->legacyRandom ? &legacyRandomMutex : NULL);
+        if (this->legacyRandom) {
+            srand(this->seed);
+        }
+
+        // without a minimum distance every neuron is generated the same way, so the aliases and
+        // transforms can be evaluated over all of the neurons at once
+        if (this->minimumDistance <= 0 && !this->legacyRandom) {
+
+            vector <layoutStep> steps;
+            for (int j = 0; j < this->component->AliasList.size(); ++j) {
+                layoutStep step;
+                step.program = &alprograms[j];
+                step.native = NULL;
+                step.targets.push_back(StateVariableList.size()+j);
+                steps.push_back(step);
+            }
+            for (int trans = 0; trans < order.size(); ++trans) {
+                layoutStep step;
+                step.program = &trprograms[trans];
+                step.native = NULL;
+                step.targets = trtargets[trans];
+                steps.push_back(step);
+            }
+
+            // big layouts can optionally use the maths built as native code
+            if (nativeMaths::isEnabled(numNeurons)) {
+                vector <const bytecodeProgram *> programs;
+                for (uint s = 0; s < steps.size(); ++s) {
+                    programs.push_back(steps[s].program);
+                }
+                vector <nativeMathsFunction> functions;
+                if (nativeMaths::compile(programs, functions)) {
+                    for (uint s = 0; s < steps.size(); ++s) {
+                        steps[s].native = functions[s];
+                    }
+                }
+            }
+
+            if (batchLayout(steps, varList, numNeurons, xyz, random, progress, locations)) {
+                if (progress != NULL && progress->isCancelled()) {
+                    errRet = "Layout generation cancelled";
+                    locations->clear();
+                }
+                return;
+            }
+        }
 
         int loop = 0;
 
+        // rejection sampling statistics, reported if we can't place every neuron
+        int totalRejected = 0;
+        int maxRejected = 0;
+
+        // locations placed so far bucketed into cells the size of the minimum distance, so only
+        // the neighbouring cells need checking
+        QHash < quint64, QVector <int> > grid;
+
         for (int i = 0; i < (int) numNeurons; ++i) {
 
+            if (progress != NULL && progress->isCancelled()) {
+                errRet = "Layout generation cancelled";
+                locations->clear();
+                return;
+            }
+
             if (loop > 1000) {
-                errRet = "Cannot satisfy distance constraint";
+                errRet = "Cannot satisfy distance constraint: placed " + QString::number(locations->size()) + " of " + QString::number(numNeurons)
+                        + " neurons, rejecting " + QString::number(totalRejected) + " samples in total ("
+                        + QString::number(loop) + " for the failing neuron, at most " + QString::number(maxRejected) + " for any placed neuron)";
                 locations->clear();
                 return;
             }
@@ -521,6 +1019,9 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
             // back up the variables in case we infringe minimum distance
             vector < lookup > varListBack = varList;
 
+            randomStream neuronRandom = random.split(attempt++);
+            randomStream * neuronRandomPtr = this->legacyRandom ? NULL : &neuronRandom;
+
             // do aliases:
             for (int j = 0; j < this->component->AliasList.size(); ++j) {
 
@@ -530,7 +1031,7 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
 
                 //currAlias = this->component->AliasList[j];
 
-                result = interpretMaths(alstacks[j]);
+                result = alprograms[j].evaluate(neuronRandomPtr);
 
                 // assign back to the Alias:
                 varList[StateVariableList.size()+j].value = result;
@@ -540,60 +1041,114 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
             // do translations
             for (int trans = 0; trans < order.size(); ++trans) {
 
-                result = interpretMaths(trstacks[trans]);
+                result = trprograms[trans].evaluate(neuronRandomPtr);
 
                 // assign result to the given statevariable
-                if (regime->TransformList[order[trans]]->type == TRANSLATE) {
-                    for (int j = 0; j < this->StateVariableList.size(); ++j) {
-                        if (varList[j].name == regime->TransformList[order[trans]]->variable->name) {
-                            varList[j].value = result;
-                        }
-                    }
+                for (uint j = 0; j < trtargets[trans].size(); ++j) {
+                    varList[trtargets[trans][j]].value = result;
                 }
             }
 
 
             // write out the location
             loc newLoc = {0,0,0};
-            for (int sv = 0; sv < this->StateVariableList.size(); ++sv) {
-                if (varList[sv].name == "x" ) {
-                    newLoc.x = varList[sv].value;
-                }
-                if (varList[sv].name == "y" ) {
-                    newLoc.y = varList[sv].value;
-                }
-                if (varList[sv].name == "z" ) {
-                    newLoc.z = varList[sv].value;
-                }
-            }
+            if (xyz[0] != -1) newLoc.x = varList[xyz[0]].value;
+            if (xyz[1] != -1) newLoc.y = varList[xyz[1]].value;
+            if (xyz[2] != -1) newLoc.z = varList[xyz[2]].value;
 
             // check if minimum distance is infringed:
             if (this->minimumDistance > 0) {
 
                 bool tooClose = false;
 
-                for (int l = 0; l < locations->size(); ++l) {
-                    if (pow((*locations)[l].x - newLoc.x,2) + pow((*locations)[l].y - newLoc.y, 2) + pow((*locations)[l].z - newLoc.z,2) < pow(this->minimumDistance,2)) {
-                        tooClose = true;
-                        break;
+                double minDist2 = this->minimumDistance * this->minimumDistance;
+                qint32 cellX = floor(newLoc.x / this->minimumDistance);
+                qint32 cellY = floor(newLoc.y / this->minimumDistance);
+                qint32 cellZ = floor(newLoc.z / this->minimumDistance);
+
+                for (int cx = cellX - 1; cx <= cellX + 1 && !tooClose; ++cx) {
+                    for (int cy = cellY - 1; cy <= cellY + 1 && !tooClose; ++cy) {
+                        for (int cz = cellZ - 1; cz <= cellZ + 1 && !tooClose; ++cz) {
+                            QHash < quint64, QVector <int> >::const_iterator cell = grid.constFind(layoutCellKey(cx, cy, cz));
+                            if (cell == grid.constEnd()) continue;
+                            for (int c = 0; c < cell.value().size(); ++c) {
+                                const loc &other = (*locations)[cell.value()[c]];
+                                double dx = other.x - newLoc.x;
+                                double dy = other.y - newLoc.y;
+                                double dz = other.z - newLoc.z;
+                                if (dx*dx + dy*dy + dz*dz < minDist2) {
+                                    tooClose = true;
+                                    break;
+                                }
+                            }
+                        }
                     }
                 }
                 if (!tooClose) {
+                    grid[layoutCellKey(cellX, cellY, cellZ)].push_back(locations->size());
                     locations->push_back(newLoc);
+                    if (progress != NULL && locations->size() % LAYOUT_PROGRESS_INTERVAL == 0) {
+                        progress->partialLayout(*locations);
+                    }
+                    maxRejected = qMax(maxRejected, loop);
                     loop = 0;
                 } else {
                     // do this iteration again!
                     --i;
                     varList = varListBack;
                     ++loop;
+                    ++totalRejected;
                 }
-            } else
+            } else {
                 locations->push_back(newLoc);
+                if (progress != NULL && locations->size() % LAYOUT_PROGRESS_INTERVAL == 0) {
+                    progress->partialLayout(*locations);
+                }
+            }
+
+        }
+    }
+
+
+}
 
+/*!
+ * \brief NineMLLayoutData::addToHash
+ * \param hash
+ *
+ * Add everything that determines the locations generated by generateLayout (apart from the
+ * number of neurons, which the caller supplies) to a hash, so results can be cached
+ */
+void NineMLLayoutData::addToHash(QCryptographicHash &hash) {
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+
+    stream << this->component->name;
+
+    // the layout maths
+    for (int i = 0; i < this->component->RegimeList.size(); ++i) {
+        RegimeSpace * regime = this->component->RegimeList[i];
+        stream << regime->name;
+        for (int j = 0; j < regime->TransformList.size(); ++j) {
+            Transform * transform = regime->TransformList[j];
+            stream << (qint32) transform->order << (qint32) transform->type << transform->variableName << transform->maths->equation;
         }
     }
+    for (int i = 0; i < this->component->AliasList.size(); ++i) {
+        stream << this->component->AliasList[i]->name << this->component->AliasList[i]->maths->equation;
+    }
 
+    // the values used in this instance
+    for (int i = 0; i < this->StateVariableList.size(); ++i) {
+        stream << this->StateVariableList[i]->name << this->StateVariableList[i]->value;
+    }
+    for (int i = 0; i < this->ParameterList.size(); ++i) {
+        stream << this->ParameterList[i]->name << this->ParameterList[i]->value;
+    }
+    stream << (qint32) this->seed << this->minimumDistance << this->legacyRandom;
 
+    hash.addData(data);
 }
 
 void RegimeSpace::readIn(QDomElement e)
@@ -948,61 +1503,15 @@ int Alias::validateAlias(NineMLLayout * component, QStringList * errs)
 
 int MathInLine::validateMathInLine(NineMLLayout * component, QStringList * errs)
 {
-    // remove operators
-
     if (equation.size() == 0) {
         return 1;
     }
 
-    QString test = equation;
-
-    test = equation;
-    test.replace('+', ' ');
-    test = test.replace('-', ' ');
-    test = test.replace('*', ' ');
-    test = test.replace('/', ' ');
-    test = test.replace('(', ' ');
-    test = test.replace(')', ' ');
-    test = test.replace('<', ' ');
-    test = test.replace('>', ' ');
-    test = test.replace('=', ' ');
-    test = test.replace(',', ' ');
-    test = test.replace('!', ' ');
-
-    QStringList FuncList;
-    FuncList.push_back("pow");
-    FuncList.push_back("exp");
-    FuncList.push_back("sin");
-    FuncList.push_back("cos");
-    FuncList.push_back("log");
-    FuncList.push_back("log10");
-    FuncList.push_back("sinh");
-    FuncList.push_back("cosh");
-    FuncList.push_back("tanh");
-    FuncList.push_back("sqrt");
-    FuncList.push_back("atan");
-    FuncList.push_back("asin");
-    FuncList.push_back("acos");
-    FuncList.push_back("asinh");
-    FuncList.push_back("acosh");
-    FuncList.push_back("atanh");
-    FuncList.push_back("atan2");
-    FuncList.push_back("ceil");
-    FuncList.push_back("floor");
-    FuncList.push_back("rand");
-    FuncList.push_back("mod");
-
-
-    // not strictly functions...
-    FuncList.push_back("t");
-    FuncList.push_back("dt");
-
-    // remove double whitespaces
-    test = test.simplified();
-
-    // tokenise
-    QStringList splitTest;
-    splitTest = test.split(' ');
+    QStringList FuncList = knownFunctions();
+
+    // the names used in the equation
+    QSharedPointer <const mathsExpression> expression = this->getExpression();
+    QStringList splitTest = expression->variableNames() + expression->functionNames();
 
     // check each token...
     for (int i = 0; i < (int) splitTest.count(); ++i) {
@@ -1026,10 +1535,6 @@ int MathInLine::validateMathInLine(NineMLLayout * component, QStringList * errs)
             if (FuncList[j].compare(splitTest[i]) == 0)
                 recognised = true;
         }
-        // see if it is a number...
-        if (splitTest[i][0] > 47 && splitTest[i][0] < 58 && splitTest[i][0] != '.') {
-            recognised = true;
-        }
 
         // if a token is not recognised, then let the user know - this may be better done elsewhere...
         if (!recognised) {
@@ -1041,6 +1546,9 @@ int MathInLine::validateMathInLine(NineMLLayout * component, QStringList * errs)
     if (equation.count("(") != equation.count(")")) {
         errs->push_back("MathString contains mis-matched brackets");
     }
+    if (expression->error() == doError(14)) {
+        errs->push_back("MathString contains an unrecognised character");
+    }
 
     return 0;
 }
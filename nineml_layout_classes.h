@@ -115,19 +115,44 @@ public:
     void writeOut(QDomDocument *doc, QDomElement &parent);
 };
 
+/*!
+ * \brief The layoutProgress class
+ * Passed to generateLayout by callers generating a layout on another thread, so that partial
+ * layouts can be shown as they are placed and generation can be stopped early. Both are called
+ * from the generating thread.
+ */
+class layoutProgress {
+public:
+    virtual ~layoutProgress() {}
+    virtual bool isCancelled() = 0;
+    virtual void partialLayout(const QVector <loc> &locations) = 0;
+};
+
+// number of neurons placed between partial layouts
+#define LAYOUT_PROGRESS_INTERVAL 8192
+
 class NineMLLayoutData : public NineMLData
 {
 public:
     int seed;
     double minimumDistance;
+    // generate with the C library's rand() rather than randomStream, for layouts saved before it
+    bool legacyRandom;
     QSharedPointer<NineMLLayout> component;
     NineMLLayoutData(QSharedPointer<NineMLLayout>data);
     NineMLLayoutData& operator=(const NineMLLayoutData& data);
-    NineMLLayoutData(){}
+    NineMLLayoutData(){legacyRandom = false;}
     ~NineMLLayoutData(){}
     void import_parameters_from_xml(QDomNode &e);
-    void generateLayout(int numNeurons, QVector <loc> *locations, QString &errRet);
+    void generateLayout(int numNeurons, QVector <loc> *locations, QString &errRet, layoutProgress * progress = NULL);
+    void addToHash(QCryptographicHash &hash);
     QVector < loc > locations;
+
+private:
+    void calculateLayout(int numNeurons, QVector <loc> *locations, QString &errRet, layoutProgress * progress);
+    // the last layout generated and the hash of everything it depends on
+    QByteArray cachedLayoutKey;
+    QVector < loc > cachedLayout;
 };
 
 
@@ -1499,6 +1499,10 @@ void projection::readFromXML(QDomElement  &e, QDomDocument *, QDomDocument * met
                                     // prevent regeneration
                                     ((pythonscript_connection *) conn->generator)->setUnchanged(true);
                                 }
+                                // analytic kernels are exported as tables, and described here
+                                if (this->synapses[i]->connectionType->type == Kernel) {
+                                    this->synapses[i]->connectionType->read_metadata_xml(metaData);
+                                }
                             }
                         }
                     }
@@ -6,6 +6,7 @@
 #include "versioncontrol.h"
 #include "experiment.h"
 #include "systemmodel.h"
+#include "connectivityregenerator.h"
 
 projectObject::projectObject(QObject *parent) :
     QObject(parent)
@@ -142,6 +143,14 @@ bool projectObject::save_project(QString fileName, rootData * data)
     }
     qDebug() << "save_project ('" << fileName << "', rootData*)";
 
+    // bring any out of date generated connectivity up to date before anything is written, so the
+    // network can be streamed out without running scripts part way through
+    connectivityRegenerator regenerator;
+    regenerator.addNetwork(data->populations);
+    if (!regenerator.run()) {
+        return false;
+    }
+
     QDir project_dir(fileName);
 
     // remove filename
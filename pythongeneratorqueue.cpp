@@ -0,0 +1,197 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "pythongeneratorqueue.h"
+#include "connection.h"
+
+pythonGeneratorQueue * pythonGeneratorQueue::queueInstance = NULL;
+
+pythonGeneratorWorker::pythonGeneratorWorker(pythonGeneratorQueue * queue)
+{
+    this->queue = queue;
+}
+
+void pythonGeneratorWorker::processQueue()
+{
+    pythonscript_connection * job = queue->takeNext();
+    while (job != NULL) {
+        emit jobStarted(job);
+        job->generateFromLayouts();
+        bool cancelled = job->generationCancelled();
+        queue->jobDone(job);
+        emit jobFinished(job, cancelled);
+        job = queue->takeNext();
+    }
+    emit queueEmpty();
+}
+
+pythonGeneratorQueue::pythonGeneratorQueue()
+{
+    currentJob = NULL;
+
+    // needed to pass the connection between threads in queued signals
+    qRegisterMetaType <pythonscript_connection *> ("pythonscript_connection*");
+
+    worker = new pythonGeneratorWorker(this);
+    worker->moveToThread(&workerThread);
+
+    connect(this, SIGNAL(processRequested()), worker, SLOT(processQueue()), Qt::QueuedConnection);
+    connect(worker, SIGNAL(jobStarted(pythonscript_connection*)), this, SIGNAL(jobStarted(pythonscript_connection*)));
+    connect(worker, SIGNAL(jobFinished(pythonscript_connection*,bool)), this, SLOT(workerFinished(pythonscript_connection*,bool)));
+    connect(worker, SIGNAL(queueEmpty()), this, SIGNAL(queueEmpty()));
+
+    workerThread.start();
+}
+
+pythonGeneratorQueue::~pythonGeneratorQueue()
+{
+    cancelAll();
+    workerThread.quit();
+    workerThread.wait();
+    delete worker;
+}
+
+pythonGeneratorQueue * pythonGeneratorQueue::instance()
+{
+    if (queueInstance == NULL) {
+        queueInstance = new pythonGeneratorQueue();
+    }
+    return queueInstance;
+}
+
+/*!
+ * \brief pythonGeneratorQueue::shutdown
+ * Stop any running script and the worker thread - must be called before Python is finalised
+ */
+void pythonGeneratorQueue::shutdown()
+{
+    if (queueInstance != NULL) {
+        delete queueInstance;
+        queueInstance = NULL;
+    }
+}
+
+/*!
+ * \brief pythonGeneratorQueue::enqueue
+ * Queue a script to be run - on the GUI thread, as the layouts it needs are generated and copied
+ * here, so the worker never touches the populations
+ */
+void pythonGeneratorQueue::enqueue(pythonscript_connection * conn)
+{
+    if (isPending(conn)) {
+        // already waiting to be run
+        return;
+    }
+
+    conn->resetCancel();
+    if (!conn->prepareGeneration()) {
+        emit jobFinished(conn, false);
+        return;
+    }
+
+    mutex.lock();
+    jobs.enqueue(conn);
+    mutex.unlock();
+
+    emit processRequested();
+}
+
+void pythonGeneratorQueue::cancel(pythonscript_connection * conn)
+{
+    mutex.lock();
+    if (jobs.removeAll(conn) > 0) {
+        // never started, so nothing to interrupt
+        mutex.unlock();
+        emit jobFinished(conn, true);
+        return;
+    }
+    bool running = (conn == currentJob);
+    mutex.unlock();
+
+    // stop the interpreter - this takes the GIL, so not with the queue locked. The worker
+    // reports back when the script has unwound
+    if (running) {
+        conn->interruptGeneration();
+    }
+}
+
+void pythonGeneratorQueue::cancelAll()
+{
+    mutex.lock();
+    QQueue <pythonscript_connection *> removed = jobs;
+    jobs.clear();
+    pythonscript_connection * running = currentJob;
+    mutex.unlock();
+
+    if (running) {
+        running->interruptGeneration();
+    }
+
+    for (int i = 0; i < removed.size(); ++i) {
+        emit jobFinished(removed[i], true);
+    }
+}
+
+/*!
+ * \brief pythonGeneratorQueue::workerFinished
+ * A script has finished on the worker thread - pass its connections on here, on the GUI thread
+ */
+void pythonGeneratorQueue::workerFinished(pythonscript_connection * conn, bool cancelled)
+{
+    if (!cancelled) {
+        conn->finishGeneration();
+    }
+    emit jobFinished(conn, cancelled);
+}
+
+bool pythonGeneratorQueue::isPending(pythonscript_connection * conn)
+{
+    QMutexLocker locker(&mutex);
+    return conn == currentJob || jobs.contains(conn);
+}
+
+int pythonGeneratorQueue::numPending()
+{
+    QMutexLocker locker(&mutex);
+    return jobs.size() + (currentJob ? 1 : 0);
+}
+
+pythonscript_connection * pythonGeneratorQueue::takeNext()
+{
+    QMutexLocker locker(&mutex);
+    if (jobs.isEmpty()) {
+        currentJob = NULL;
+    } else {
+        currentJob = jobs.dequeue();
+    }
+    return currentJob;
+}
+
+void pythonGeneratorQueue::jobDone(pythonscript_connection * conn)
+{
+    QMutexLocker locker(&mutex);
+    if (currentJob == conn) {
+        currentJob = NULL;
+    }
+}
@@ -0,0 +1,104 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef PYTHONGENERATORQUEUE_H
+#define PYTHONGENERATORQUEUE_H
+
+#include "globalHeader.h"
+#include <QQueue>
+
+class pythonGeneratorQueue;
+
+/*!
+ * \brief The pythonGeneratorWorker class
+ * Lives on the queue's worker thread and runs the queued connection scripts one after
+ * another. The GIL is taken by the script connection itself, so the worker only has to
+ * pull jobs off the queue and report back.
+ */
+class pythonGeneratorWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit pythonGeneratorWorker(pythonGeneratorQueue * queue);
+
+private:
+    pythonGeneratorQueue * queue;
+
+public slots:
+    void processQueue();
+
+signals:
+    void jobStarted(pythonscript_connection *);
+    void jobFinished(pythonscript_connection *, bool);
+    void queueEmpty();
+};
+
+/*!
+ * \brief The pythonGeneratorQueue class
+ * A single queue of Python connectivity scripts that are run on a background thread so that
+ * long scripts do not block the GUI. Scripts for several projections can be queued at once -
+ * they are run in order, as the GIL prevents them running concurrently anyway. A running script
+ * is cancelled by raising a KeyboardInterrupt in the interpreter.
+ *
+ * The layouts a script needs are generated and copied when it is queued, and its connections
+ * handed back when it finishes, both on the GUI thread.
+ */
+class pythonGeneratorQueue : public QObject
+{
+    Q_OBJECT
+public:
+    static pythonGeneratorQueue * instance();
+    static void shutdown();
+
+    void enqueue(pythonscript_connection * conn);
+    void cancel(pythonscript_connection * conn);
+    void cancelAll();
+    bool isPending(pythonscript_connection * conn);
+    int numPending();
+
+    // used by the worker
+    pythonscript_connection * takeNext();
+    void jobDone(pythonscript_connection * conn);
+
+private:
+    pythonGeneratorQueue();
+    ~pythonGeneratorQueue();
+    static pythonGeneratorQueue * queueInstance;
+    QThread workerThread;
+    pythonGeneratorWorker * worker;
+    QMutex mutex;
+    QQueue <pythonscript_connection *> jobs;
+    pythonscript_connection * currentJob;
+
+private slots:
+    void workerFinished(pythonscript_connection * conn, bool cancelled);
+
+signals:
+    void jobStarted(pythonscript_connection *);
+    void jobFinished(pythonscript_connection *, bool cancelled);
+    void queueEmpty();
+    void processRequested();
+};
+
+#endif // PYTHONGENERATORQUEUE_H
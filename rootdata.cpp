@@ -1390,7 +1390,11 @@ void rootData::updatePar()
         // Update the parameter value
         kernel_connection * conn = (kernel_connection *) sender()->property("ptr").value<void *>();
         CHECK_CAST(dynamic_cast<kernel_connection *>(conn))
-        int kernel_size = ((QComboBox *) sender())->currentIndex() * 2 + 3;
+        int kernel_size = ((QSpinBox *) sender())->value();
+        // typed in sizes are kept odd so the kernel has a centre
+        if (kernel_size % 2 == 0) {
+            ++kernel_size;
+        }
         // only add undo if value has changed
         conn->setKernelSize(kernel_size);
         emit updatePanelView2("");
@@ -1406,16 +1410,31 @@ void rootData::updatePar()
         conn->setKernelScale(kernel_scale);
     }
 
-    if (action == "changeConnKernel") {
+    if (action == "changeConnKerType") {
+        // Update the parameter value
+        kernel_connection * conn = (kernel_connection *) sender()->property("ptr").value<void *>();
+        CHECK_CAST(dynamic_cast<kernel_connection *>(conn))
+        int kernel_type = ((QComboBox *) sender())->currentIndex();
+        conn->setKernelType(kernel_type);
+        emit updatePanelView2("");
+    }
+
+    if (action == "changeConnKerPar") {
         // Update the parameter value
         kernel_connection * conn = (kernel_connection *) sender()->property("ptr").value<void *>();
         CHECK_CAST(dynamic_cast<kernel_connection *>(conn))
-        float kernel_value = ((QDoubleSpinBox *) sender())->value();
+        float value = ((QDoubleSpinBox *) sender())->value();
         CHECK_CAST(dynamic_cast<QDoubleSpinBox *>(sender()))
-        int i = sender()->property("i").toInt();
-        int j = sender()->property("j").toInt();
-        // only add undo if value has changed
-        conn->setKernel(i,j,kernel_value);
+        QString par = sender()->property("par").toString();
+        if (par == "amplitude") {
+            conn->setKernelAmplitude(value);
+        } else if (par == "sigma_x") {
+            conn->setKernelSigmaX(value);
+        } else if (par == "sigma_y") {
+            conn->setKernelSigmaY(value);
+        } else if (par == "cutoff") {
+            conn->setKernelCutoff(value);
+        }
     }
 
     if (action == "changePythonScriptPar") {
@@ -251,7 +251,12 @@ QPixmap saveNetworkImageDialog::drawPixMap() {
 
 QPixmap saveNetworkImageDialog::drawPixMapVis() {
 
-    return glConnWidget->renderImage(width, height);
+    // the preview only needs to fill its label - the full size is only rendered on save
+    QSize previewSize = QSize(width, height);
+    previewSize.scale(ui->preview->size(), Qt::KeepAspectRatio);
+    previewSize = previewSize.expandedTo(QSize(1,1));
+
+    return glConnWidget->renderImage(previewSize.width(), previewSize.height());
 
     /*image.save("/home/alex/test.png", "png");
 
@@ -298,15 +303,24 @@ void saveNetworkImageDialog::changeDrawStyle(int index) {
 
 void saveNetworkImageDialog::save() {
 
-    this->fileName = QFileDialog::getSaveFileName(this, tr("Export As Image"), qgetenv("HOME"), tr("Png (*.png)"));
+    this->fileName = QFileDialog::getSaveFileName(this, tr("Export As Image"), qgetenv("HOME"), tr("Png (*.png);;Tiff (*.tif *.tiff)"));
 
     if (this->fileName.isEmpty()) {
         return;
     }
 
+    // large visualisations are streamed to disk as they are drawn rather than built up in memory
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (height > 0 && (suffix == "tif" || suffix == "tiff")) {
+        if (!glConnWidget->saveImage(width, height, fileName)) {
+            QMessageBox::warning(this, "Export As Image", "The image could not be saved to " + fileName);
+        }
+        return;
+    }
+
     QPixmap pix;
     if (height > 0)
-        pix = drawPixMapVis();
+        pix = glConnWidget->renderImage(width, height);
     else
         pix = drawPixMap();
 
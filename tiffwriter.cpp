@@ -0,0 +1,216 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "tiffwriter.h"
+
+// TIFF field types
+#define TIFF_SHORT 3
+#define TIFF_LONG 4
+#define TIFF_RATIONAL 5
+
+static void writeEntry(QDataStream &out, quint16 tag, quint16 type, quint32 count, quint32 value) {
+
+    out << tag << type << count;
+    // single shorts sit in the first half of the value
+    if (type == TIFF_SHORT && count == 1)
+        out << quint16(value) << quint16(0);
+    else
+        out << value;
+
+}
+
+static void align(QFile &file, QDataStream &out) {
+
+    // the spec asks for everything to start on a word boundary
+    if (file.pos() % 2)
+        out << quint8(0);
+
+}
+
+tiffWriter::tiffWriter()
+{
+    width = 0;
+    height = 0;
+    rowsWritten = 0;
+    rowsPerStrip = 0;
+}
+
+tiffWriter::~tiffWriter()
+{
+    // never closed, so the directory was never written
+    if (file.isOpen()) {
+        file.close();
+        file.remove();
+    }
+}
+
+bool tiffWriter::fail(QString message) {
+
+    error = message;
+    qDebug() << "tiffWriter:" << message;
+    // don't leave a truncated image behind - a file we never opened is left alone
+    if (file.isOpen()) {
+        file.close();
+        file.remove();
+    }
+    return false;
+
+}
+
+bool tiffWriter::open(QString fileName, int width, int height) {
+
+    this->width = width;
+    this->height = height;
+    rowsWritten = 0;
+    rowsPerStrip = 0;
+    stripOffsets.clear();
+    stripByteCounts.clear();
+    error.clear();
+
+    if (width < 1 || height < 1)
+        return fail("Image has no size");
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return fail("Could not open " + fileName + " for writing");
+
+    out.setDevice(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    // header - the offset of the directory is filled in on close
+    out << quint8('I') << quint8('I') << quint16(42) << quint32(0);
+
+    return out.status() == QDataStream::Ok;
+
+}
+
+bool tiffWriter::writeRows(const QImage &rows) {
+
+    if (!file.isOpen())
+        return fail("File is not open");
+
+    int numRows = rows.height();
+    if (rows.width() != width || rowsWritten + numRows > height)
+        return fail("Rows do not fit the image");
+
+    if (rowsPerStrip == 0)
+        rowsPerStrip = numRows;
+    // only the last strip can be short
+    if (numRows > rowsPerStrip || rowsWritten % rowsPerStrip != 0)
+        return fail("Rows must come in bands of the same height");
+
+    // unpremultiplied RGBA, 8 bits per sample
+    QImage img = rows.convertToFormat(QImage::Format_ARGB32);
+    QByteArray raw(width*numRows*4, 0);
+    uchar * pixel = (uchar *) raw.data();
+    for (int y = 0; y < numRows; ++y) {
+        const QRgb * line = (const QRgb *) img.constScanLine(y);
+        for (int x = 0; x < width; ++x) {
+            *pixel++ = qRed(line[x]);
+            *pixel++ = qGreen(line[x]);
+            *pixel++ = qBlue(line[x]);
+            *pixel++ = qAlpha(line[x]);
+        }
+    }
+
+    // qCompress gives a zlib stream, which is what TIFF's Deflate is, after the length it prefixes
+    QByteArray packed = qCompress(raw);
+    packed.remove(0, 4);
+    raw.clear();
+
+    align(file, out);
+    if (quint64(file.pos()) + quint64(packed.size()) > Q_UINT64_C(0xFFFF0000))
+        return fail("Image is too large for a TIFF file");
+
+    stripOffsets.push_back(quint32(file.pos()));
+    stripByteCounts.push_back(quint32(packed.size()));
+    out.writeRawData(packed.constData(), packed.size());
+    rowsWritten += numRows;
+
+    if (out.status() != QDataStream::Ok)
+        return fail("Could not write to " + file.fileName());
+
+    return true;
+
+}
+
+bool tiffWriter::close() {
+
+    // keep the reason if an earlier write failed
+    if (!file.isOpen())
+        return fail(error.isEmpty() ? QString("File is not open") : error);
+
+    if (rowsWritten != height)
+        return fail("Image is incomplete");
+
+    int numStrips = stripOffsets.size();
+
+    // values too big to sit in the directory entries
+    align(file, out);
+    quint32 bitsOffset = file.pos();
+    out << quint16(8) << quint16(8) << quint16(8) << quint16(8);
+    quint32 resolutionOffset = file.pos();
+    out << quint32(72) << quint32(1);
+
+    quint32 offsetsOffset = stripOffsets[0];
+    quint32 countsOffset = stripByteCounts[0];
+    if (numStrips > 1) {
+        offsetsOffset = file.pos();
+        for (int i = 0; i < numStrips; ++i)
+            out << stripOffsets[i];
+        countsOffset = file.pos();
+        for (int i = 0; i < numStrips; ++i)
+            out << stripByteCounts[i];
+    }
+
+    // the directory, in tag order
+    align(file, out);
+    quint32 directoryOffset = file.pos();
+    out << quint16(14);
+    writeEntry(out, 256, TIFF_LONG, 1, width); // ImageWidth
+    writeEntry(out, 257, TIFF_LONG, 1, height); // ImageLength
+    writeEntry(out, 258, TIFF_SHORT, 4, bitsOffset); // BitsPerSample
+    writeEntry(out, 259, TIFF_SHORT, 1, 8); // Compression - Deflate
+    writeEntry(out, 262, TIFF_SHORT, 1, 2); // PhotometricInterpretation - RGB
+    writeEntry(out, 273, TIFF_LONG, numStrips, offsetsOffset); // StripOffsets
+    writeEntry(out, 277, TIFF_SHORT, 1, 4); // SamplesPerPixel
+    writeEntry(out, 278, TIFF_LONG, 1, rowsPerStrip); // RowsPerStrip
+    writeEntry(out, 279, TIFF_LONG, numStrips, countsOffset); // StripByteCounts
+    writeEntry(out, 282, TIFF_RATIONAL, 1, resolutionOffset); // XResolution
+    writeEntry(out, 283, TIFF_RATIONAL, 1, resolutionOffset); // YResolution
+    writeEntry(out, 284, TIFF_SHORT, 1, 1); // PlanarConfiguration - interleaved
+    writeEntry(out, 296, TIFF_SHORT, 1, 2); // ResolutionUnit - inches
+    writeEntry(out, 338, TIFF_SHORT, 1, 2); // ExtraSamples - unassociated alpha
+    out << quint32(0);
+
+    file.seek(4);
+    out << directoryOffset;
+
+    if (out.status() != QDataStream::Ok)
+        return fail("Could not write to " + file.fileName());
+
+    file.close();
+    return true;
+
+}
@@ -0,0 +1,61 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef TIFFWRITER_H
+#define TIFFWRITER_H
+
+#include "globalHeader.h"
+
+/*!
+ * \brief The tiffWriter class
+ * Writes an RGBA image to a TIFF file a band of rows at a time, so images much larger than
+ * will fit in memory can be saved. Each band is compressed (Deflate) into its own strip as it
+ * arrives, and the directory describing the strips is written on close().
+ *
+ * All bands must be the same height as the first, except the last which may be shorter.
+ */
+class tiffWriter
+{
+public:
+    tiffWriter();
+    ~tiffWriter();
+    bool open(QString fileName, int width, int height);
+    bool writeRows(const QImage &rows);
+    bool close();
+    QString errorString() const {return error;}
+
+private:
+    bool fail(QString message);
+    QFile file;
+    QDataStream out;
+    int width;
+    int height;
+    int rowsWritten;
+    int rowsPerStrip;
+    QVector <quint32> stripOffsets;
+    QVector <quint32> stripByteCounts;
+    QString error;
+};
+
+#endif // TIFFWRITER_H
@@ -566,20 +566,19 @@ void viewVZLayoutEditHandler::initConnection() {
     connect(this, SIGNAL(showConnection()), connectionComboBox, SLOT(show()));
 
 
-    // SIZE COMBOBOX FOR KERNEL
-    kernelComboBox = new QComboBox;
-    kernelComboBox->setProperty("conn", "true");
-    kernelComboBox->setToolTip("select kernel size");
-    kernelComboBox->setProperty("action","changeConnKerSize");
-    kernelComboBox->setFocusPolicy(Qt::StrongFocus);
-    kernelComboBox->installEventFilter(new FilterOutUndoRedoEvents);
-    for (int i = 0; i < 5; ++i) {
-        qint32 ksize = i *2 + 3;
-        QString kstring = QString::number(ksize) + " x " + QString::number(ksize);
-        kernelComboBox->addItem(kstring);
-    }
-    connect(kernelComboBox, SIGNAL(currentIndexChanged(int)), data, SLOT (updatePar()));
-    connect(this, SIGNAL(hideAll()), kernelComboBox, SLOT(hide()));
+    // SIZE SPINBOX FOR KERNEL
+    kernelSizeSpinBox = new QSpinBox;
+    kernelSizeSpinBox->setProperty("conn", "true");
+    kernelSizeSpinBox->setToolTip("select kernel size");
+    kernelSizeSpinBox->setProperty("action","changeConnKerSize");
+    // kernels have a centre box, so step through the odd sizes
+    kernelSizeSpinBox->setMinimum(3);
+    kernelSizeSpinBox->setMaximum(KERNEL_MAX_SIZE);
+    kernelSizeSpinBox->setSingleStep(2);
+    kernelSizeSpinBox->setFocusPolicy(Qt::StrongFocus);
+    kernelSizeSpinBox->installEventFilter(new FilterOutUndoRedoEvents);
+    connect(kernelSizeSpinBox, SIGNAL(valueChanged(int)), data, SLOT (updatePar()));
+    connect(this, SIGNAL(hideAll()), kernelSizeSpinBox, SLOT(hide()));
 }
 
 void viewVZLayoutEditHandler::updateConnectionList() {
@@ -1295,69 +1294,137 @@ void viewVZLayoutEditHandler::drawDeletables() {
 
         if (currConn->type == Kernel) {
 
-            // draw up kernel size and scale
-            QHBoxLayout * hlay = new QHBoxLayout;
-            connect(this, SIGNAL(deleteProperties()), hlay, SLOT(deleteLater()));
+            kernel_connection * kerConn = (kernel_connection *) currConn;
+
+            // TYPE
+            QHBoxLayout * tlay = new QHBoxLayout;
+            connect(this, SIGNAL(deleteProperties()), tlay, SLOT(deleteLater()));
+            QComboBox * typeWidget = new QComboBox;
+            typeWidget->setProperty("conn", "true");
+            typeWidget->setToolTip("select how the kernel is described");
+            typeWidget->addItem("Table");
+            typeWidget->addItem("Separable Gaussian");
+            typeWidget->addItem("Radial Gaussian");
+            typeWidget->setCurrentIndex(kerConn->kernel_type);
+            typeWidget->setProperty("ptr", qVariantFromValue((void *) currConn));
+            typeWidget->setProperty("action","changeConnKerType");
+            typeWidget->setFocusPolicy(Qt::StrongFocus);
+            typeWidget->installEventFilter(new FilterOutUndoRedoEvents);
+            connect(typeWidget, SIGNAL(currentIndexChanged(int)), data, SLOT (updatePar()));
+            tlay->addWidget(new QLabel("Kernel type: "));
+            connect(this, SIGNAL(deleteProperties()), tlay->itemAt(tlay->count()-1)->widget(), SLOT(deleteLater()));
+            tlay->addWidget(typeWidget);
+            connect(this, SIGNAL(deleteProperties()), typeWidget, SLOT(deleteLater()));
+            panelLayout->insertLayout(panelLayout->count() - 2, tlay,2);
+
+            if (kerConn->kernel_type != KernelTable) {
+
+                // analytic kernels are described by their parameters
+                QGridLayout * alay = new QGridLayout;
+                connect(this, SIGNAL(deleteProperties()), alay, SLOT(deleteLater()));
+                QStringList parNames;
+                QStringList parLabels;
+                QVector <float> parValues;
+                parNames << "amplitude";
+                parLabels << "Peak probability: ";
+                parValues << kerConn->kernel_amplitude;
+                parNames << "sigma_x";
+                parLabels << (kerConn->kernel_type == KernelSeparable ? "Sigma x: " : "Sigma: ");
+                parValues << kerConn->kernel_sigma_x;
+                if (kerConn->kernel_type == KernelSeparable) {
+                    parNames << "sigma_y";
+                    parLabels << "Sigma y: ";
+                    parValues << kerConn->kernel_sigma_y;
+                }
+                parNames << "cutoff";
+                parLabels << "Cutoff (sigmas): ";
+                parValues << kerConn->kernel_cutoff;
+
+                for (int i = 0; i < parNames.size(); ++i) {
+                    QLabel * label = new QLabel(parLabels[i]);
+                    connect(this, SIGNAL(deleteProperties()), label, SLOT(deleteLater()));
+                    alay->addWidget(label,i,0,1,1);
+                    QDoubleSpinBox * parWidget = new QDoubleSpinBox;
+                    parWidget->setProperty("conn", "true");
+                    parWidget->setDecimals(3);
+                    parWidget->setMinimum(parNames[i] == "amplitude" ? 0.0 : 0.001);
+                    parWidget->setMaximum(parNames[i] == "amplitude" ? 1.0 : 100000.0);
+                    parWidget->setSingleStep(parNames[i] == "amplitude" ? 0.05 : 1.0);
+                    parWidget->setValue(parValues[i]);
+                    parWidget->setProperty("ptr", qVariantFromValue((void *) currConn));
+                    parWidget->setProperty("par", parNames[i]);
+                    parWidget->setProperty("action","changeConnKerPar");
+                    parWidget->setFocusPolicy(Qt::StrongFocus);
+                    parWidget->installEventFilter(new FilterOutUndoRedoEvents);
+                    connect(parWidget, SIGNAL(valueChanged(double)), data, SLOT (updatePar()));
+                    connect(this, SIGNAL(deleteProperties()), parWidget, SLOT(deleteLater()));
+                    alay->addWidget(parWidget,i,1,1,1);
+                }
+                panelLayout->insertLayout(panelLayout->count() - 2, alay,2);
 
-            // SIZE CONFIGURATION
-            kernelComboBox->setProperty("ptr", qVariantFromValue((void *) currConn));
-            int index = (((kernel_connection *) currConn)->kernel_size - 3)/2;
-            kernelComboBox->setCurrentIndex(index);
-            kernelComboBox->show();
-
-            // SCALE
-            QDoubleSpinBox *scaleWidget = new QDoubleSpinBox;
-            scaleWidget->setProperty("conn", "true");
-            scaleWidget->setToolTip("select kernel scale");
-            scaleWidget->setMinimum(0.1);
-            scaleWidget->setMaximum(100.0);
-            scaleWidget->setValue(((kernel_connection *) currConn)->kernel_scale);
-            scaleWidget->setProperty("ptr", qVariantFromValue((void *) currConn));
-            scaleWidget->setProperty("action","changeConnKerScale");
-            scaleWidget->setFocusPolicy(Qt::StrongFocus);
-            scaleWidget->installEventFilter(new FilterOutUndoRedoEvents);
-            connect(scaleWidget, SIGNAL(valueChanged(double)), data, SLOT (updatePar()));
-            //
-
-            hlay->addWidget(new QLabel("Kernel size: "));
-            connect(this, SIGNAL(deleteProperties()), hlay->itemAt(hlay->count()-1)->widget(), SLOT(deleteLater()));
-            hlay->addWidget(kernelComboBox);
-            hlay->addWidget(new QLabel("Kernel scale: "));
-            connect(this, SIGNAL(deleteProperties()), hlay->itemAt(hlay->count()-1)->widget(), SLOT(deleteLater()));
-            hlay->addWidget(scaleWidget);
-            connect(this, SIGNAL(deleteProperties()), scaleWidget, SLOT(deleteLater()));
+            } else {
 
-            panelLayout->insertLayout(panelLayout->count() - 2, hlay,2);
+                // draw up kernel size and scale
+                QHBoxLayout * hlay = new QHBoxLayout;
+                connect(this, SIGNAL(deleteProperties()), hlay, SLOT(deleteLater()));
+
+                // SIZE CONFIGURATION
+                // don't resize the kernel while showing it
+                int kernel_size = ((kernel_connection *) currConn)->kernel_size;
+                kernelSizeSpinBox->blockSignals(true);
+                kernelSizeSpinBox->setMaximum(qMax(KERNEL_MAX_SIZE, kernel_size));
+                kernelSizeSpinBox->setValue(kernel_size);
+                kernelSizeSpinBox->blockSignals(false);
+                kernelSizeSpinBox->setProperty("ptr", qVariantFromValue((void *) currConn));
+                kernelSizeSpinBox->show();
+
+                // SCALE
+                QDoubleSpinBox *scaleWidget = new QDoubleSpinBox;
+                scaleWidget->setProperty("conn", "true");
+                scaleWidget->setToolTip("select kernel scale");
+                scaleWidget->setMinimum(0.1);
+                scaleWidget->setMaximum(100.0);
+                scaleWidget->setValue(((kernel_connection *) currConn)->kernel_scale);
+                scaleWidget->setProperty("ptr", qVariantFromValue((void *) currConn));
+                scaleWidget->setProperty("action","changeConnKerScale");
+                scaleWidget->setFocusPolicy(Qt::StrongFocus);
+                scaleWidget->installEventFilter(new FilterOutUndoRedoEvents);
+                connect(scaleWidget, SIGNAL(valueChanged(double)), data, SLOT (updatePar()));
+                //
+
+                hlay->addWidget(new QLabel("Kernel size: "));
+                connect(this, SIGNAL(deleteProperties()), hlay->itemAt(hlay->count()-1)->widget(), SLOT(deleteLater()));
+                hlay->addWidget(kernelSizeSpinBox);
+                hlay->addWidget(new QLabel("Kernel scale: "));
+                connect(this, SIGNAL(deleteProperties()), hlay->itemAt(hlay->count()-1)->widget(), SLOT(deleteLater()));
+                hlay->addWidget(scaleWidget);
+                connect(this, SIGNAL(deleteProperties()), scaleWidget, SLOT(deleteLater()));
+
+                panelLayout->insertLayout(panelLayout->count() - 2, hlay,2);
+
+                QHBoxLayout *glay = new QHBoxLayout;
+                connect(this, SIGNAL(deleteProperties()), glay, SLOT(deleteLater()));
+                glay->setContentsMargins(0,0,0,0);
+                QLabel * kernBoxLabel = new QLabel("Kernel: ");
+                glay->addWidget(kernBoxLabel, 0, Qt::AlignTop);
+                connect(this, SIGNAL(deleteProperties()), kernBoxLabel, SLOT(deleteLater()));
+
+                // one view of the table rather than a widget per box, so large kernels stay usable
+                QTableView * kernelView = new QTableView;
+                kernelView->setModel(new kernel_connectionModel((kernel_connection *) currConn, kernelView));
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+                kernelView->horizontalHeader()->setResizeMode(QHeaderView::ResizeToContents);
+#else
+                kernelView->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+#endif
+                kernelView->setMinimumHeight(150);
+                kernelView->installEventFilter(new FilterOutUndoRedoEvents);
+                connect(this, SIGNAL(deleteProperties()), kernelView, SLOT(deleteLater()));
+                glay->addWidget(kernelView);
 
-            QGridLayout *glay = new QGridLayout;
-            connect(this, SIGNAL(deleteProperties()), glay, SLOT(deleteLater()));
-            glay->setContentsMargins(0,0,0,0);
-            glay->setSpacing(0);
-            QLabel * kernBoxLabel = new QLabel("Kernel: ");
-            glay->addWidget(kernBoxLabel,0,0,1,1);
-            connect(this, SIGNAL(deleteProperties()), kernBoxLabel, SLOT(deleteLater()));
-            QDoubleSpinBox * kernel;
-            // add kernel
-            for (int i = 0; i < ((kernel_connection *) currConn)->kernel_size; ++i) {
-                for (int j = 0; j < ((kernel_connection *) currConn)->kernel_size; ++j) {
-                    kernel = new QDoubleSpinBox;
-                    kernel->setMinimum(0);
-                    kernel->setMaximum(1.0);
-                    kernel->setProperty("i",i);
-                    kernel->setProperty("j",j);
-                    kernel->setFocusPolicy(Qt::StrongFocus);
-                    kernel->installEventFilter(new FilterOutUndoRedoEvents);
-                    kernel->setProperty("ptr", qVariantFromValue((void *) currConn));
-                    kernel->setProperty("action","changeConnKernel");
-                    kernel->setValue(((kernel_connection *) currConn)->kernel[i][j]);
-                    connect(kernel, SIGNAL(valueChanged(double)), data, SLOT (updatePar()));
-                    connect(this, SIGNAL(deleteProperties()), kernel, SLOT(deleteLater()));
-                    glay->addWidget(kernel,i,j+1,1,1);
-                }
+                panelLayout->insertLayout(panelLayout->count() - 2, glay,2);
             }
 
-            panelLayout->insertLayout(panelLayout->count() - 2, glay,2);
-
             QCheckBox * convert = new QCheckBox("Output as explicit list");
             connect(this, SIGNAL(deleteProperties()), convert, SLOT(deleteLater()));
             convert->setChecked(((kernel_connection *)currConn)->isList());
@@ -92,7 +92,7 @@ private:
     QSpinBox * zSpin;
 
     // kernel
-    QComboBox * kernelComboBox;
+    QSpinBox * kernelSizeSpinBox;
 
 
 signals: